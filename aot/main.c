@@ -0,0 +1,535 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pvm_map.h"
+
+/// \brief The cost classes of the instructions by their weights, see `PVM_CYCLES`.
+enum aot_class {
+	AOT_LITERAL,
+	AOT_ALU,
+	AOT_MUL,
+	AOT_DIV,
+	AOT_PWR,
+	AOT_MEMORY,
+	AOT_BRANCH,
+	AOT_CALL,
+	AOT_RET,
+	AOT_SLP,
+	AOT_CLASSES
+};
+
+static const char *const aot_weights[AOT_CLASSES] = {
+	"PVM_CYCLES_LITERAL", "PVM_CYCLES_ALU", "PVM_CYCLES_MUL", "PVM_CYCLES_DIV", "PVM_CYCLES_PWR",
+	"PVM_CYCLES_MEMORY", "PVM_CYCLES_BRANCH", "PVM_CYCLES_CALL", "PVM_CYCLES_RET", "PVM_CYCLES_SLP"
+};
+
+static const char *const aot_mnemonics[] = {
+	"BZE", "BNZ", "BEQ", "BNE", "BGT", "BLT", "BGE", "BLE", "ADD", "SUB", "MUL", "DIV", "PWR", "AND", "IOR", "XOR",
+	"SKZ", "SNZ", "SKN", "SNN", "SLP", "RET", "LDC", "JMB", "NEG", "INV", "INC", "DEC", "POP", "POP", "POP", "POP"
+};
+
+/// \brief Represents the executable being translated along with its verification results.
+typedef struct aot {
+	FILE *out;
+	const char *name;
+	pvm_image_t image;
+	const pvm_verify_state_t *states;
+	const uint8_t *frames;
+	/// \brief The flags of the instructions starting a native block.
+	uint8_t *leaders;
+	/// \brief The number of the slots the native code of the current function keeps in its locals.
+	unsigned slots;
+} aot_t;
+
+/// \brief Looks up the cost class of an opcode the same way the interpreter weights it.
+static enum aot_class aot_class(const pvm_op_t op) {
+	if (op < PVM_OP_BZE) return AOT_LITERAL;
+	if (op < PVM_OP_ADD) return AOT_BRANCH;
+	switch (op) {
+		case PVM_OP_MUL: return AOT_MUL;
+		case PVM_OP_DIV: return AOT_DIV;
+		case PVM_OP_PWR: return AOT_PWR;
+		case PVM_OP_SLP: return AOT_SLP;
+		case PVM_OP_RET: return AOT_RET;
+		case PVM_OP_LDC: return AOT_MEMORY;
+		case PVM_OP_SKZ:
+		case PVM_OP_SNZ:
+		case PVM_OP_SKN:
+		case PVM_OP_SNN:
+		case PVM_OP_JMB: return AOT_BRANCH;
+		default: break;
+	}
+	if (op < PVM_OP_JMP) return AOT_ALU;
+	switch (op & 0xF0) {
+		case PVM_OP_JMP: return AOT_BRANCH;
+		case PVM_OP_CAL: return AOT_CALL;
+		default: return AOT_MEMORY;
+	}
+}
+
+/// \brief Checks if an instruction ends a native block, it transfers control or calls a function.
+static int aot_terminator(const pvm_op_t op) {
+	if (op >= PVM_OP_BZE && op < PVM_OP_ADD) return 1;
+	if (op >= PVM_OP_SKZ && op <= PVM_OP_RET) return 1;
+	return op == PVM_OP_JMB || (op & 0xF0) == PVM_OP_JMP || (op & 0xF0) == PVM_OP_CAL;
+}
+
+/// \brief Checks if an instruction is left to the interpreter: SLP and the RET of main().
+static int aot_interpreted(const aot_t *aot, const pvm_address_t pc) {
+	const pvm_op_t op = aot->image.code[pc];
+	return op == PVM_OP_SLP || (op == PVM_OP_RET && !aot->states[pc].owner);
+}
+
+/// \brief Takes the integral operand of JMP, CAL, LDV and STV, the verifier has proven those on the stack known.
+///
+/// \param[in] aot The translator.
+/// \param[in] pc The address of the instruction.
+/// \param[out] depth The depth of the data stack once the operand is taken.
+///
+/// \return The operand.
+static int32_t aot_param(const aot_t *aot, const pvm_address_t pc, unsigned *depth) {
+	const pvm_verify_state_t *const s = &aot->states[pc];
+	int32_t param = aot->image.code[pc] & 0x0F;
+	*depth = s->depth;
+	if (param == 0x0F) {
+		param = s->value[0];
+		--*depth;
+		if (param > 0) param += 0x0F;
+	}
+	return param;
+}
+
+/// \brief Calculates the target of a jump or a branch the same way the engines do.
+static pvm_address_t aot_target(const pvm_address_t pc, const int32_t offset) {
+	return (pvm_address_t)(pc + 1u + (uint32_t)offset + 1u);
+}
+
+/// \brief Marks an address as the start of a native block.
+static void aot_lead(aot_t *aot, const uint32_t pc) {
+	if (pc < aot->image.code_size) aot->leaders[pc] = 1;
+}
+
+/// \brief Finds the starts of the native blocks: function entries, targets, the instructions following the ends of
+/// blocks, and the calls and the instructions left to the interpreter, which form blocks of their own.
+static void aot_leaders(aot_t *aot) {
+	aot_lead(aot, 0);
+	for (uint16_t i = 0; i < aot->image.functions_count; ++i) {
+		if (!aot->image.functions[i].is_built_in) aot_lead(aot, aot->image.functions[i].address);
+	}
+	for (pvm_address_t pc = 0; pc < aot->image.code_size; ++pc) {
+		if (!(aot->states[pc].flags & PVM_VERIFY_VISITED)) continue;
+		const pvm_op_t op = aot->image.code[pc];
+		unsigned depth;
+		if (!aot_terminator(op)) continue;
+		aot_lead(aot, pc + 1u);
+		if (op < PVM_OP_ADD) aot_lead(aot, aot_target(pc, aot->states[pc].value[0]));
+		else if (op < PVM_OP_SLP) aot_lead(aot, pc + 2u);
+		else if (op == PVM_OP_SLP || op == PVM_OP_RET) aot_lead(aot, pc);
+		else if (op == PVM_OP_JMB) {
+			int32_t param = (int32_t)(0u - (uint32_t)aot->states[pc].value[0]);
+			if (param < 0) param -= 2;
+			aot_lead(aot, aot_target(pc, param));
+		}
+		else if ((op & 0xF0) == PVM_OP_JMP) {
+			int32_t param = aot_param(aot, pc, &depth);
+			if (param < 0) param -= 2;
+			aot_lead(aot, aot_target(pc, param));
+		}
+		else aot_lead(aot, pc);
+	}
+}
+
+/// \brief Prints the cost of the native block from an instruction up to the end of its block.
+static void aot_cost(const aot_t *aot, pvm_address_t pc) {
+	unsigned classes[AOT_CLASSES] = { 0 }, instructions = 0;
+	for (;;) {
+		const pvm_op_t op = aot->image.code[pc];
+		++classes[aot_class(op)];
+		++instructions;
+		if (aot_terminator(op) || pc + 1u >= aot->image.code_size || aot->leaders[pc + 1]) break;
+		++pc;
+	}
+	fprintf(aot->out, "PVM_AOT_COST(%u, ", instructions);
+	const char *separator = "";
+	for (int i = 0; i < AOT_CLASSES; ++i) {
+		if (!classes[i]) continue;
+		if (classes[i] == 1) fprintf(aot->out, "%s%s", separator, aot_weights[i]);
+		else fprintf(aot->out, "%s%u * %s", separator, classes[i], aot_weights[i]);
+		separator = " + ";
+	}
+	fputc(')', aot->out);
+}
+
+/// \brief Prints the statement leaving the native code at an instruction to the interpreter.
+///
+/// \param[in,out] aot The translator.
+/// \param[in] pc The address of the instruction.
+/// \param[in] depth The depth of the data stack upon entering the instruction.
+/// \param[in] refund The flag that the budget spent upon entering the block is given back from this instruction on.
+static void aot_leave(aot_t *aot, const pvm_address_t pc, const unsigned depth, const int refund) {
+	fprintf(aot->out, "\t\t");
+	if (refund) {
+		fprintf(aot->out, "budget += ");
+		aot_cost(aot, pc);
+		fprintf(aot->out, ";\n\t\t");
+	}
+	fprintf(aot->out, "pc = %u;\n\t\tdepth = %u;\n\t\tgoto leave;\n", pc, depth);
+}
+
+/// \brief Prints the statements storing the slots of the frame from the locals.
+///
+/// \details All the slots are stored, not only those below the top of the data stack, as the interpreter leaves the
+/// values popped above the top, where built-in functions and LDV may read them.
+static void aot_store(const aot_t *aot) {
+	for (unsigned i = 0; i < aot->slots; ++i) {
+		fprintf(aot->out, "\tframe[%u] = s%u;\n", i, i);
+	}
+}
+
+/// \brief Prints the statements loading the locals from the slots of the frame, see `aot_store()`.
+static void aot_load(const aot_t *aot) {
+	for (unsigned i = 0; i < aot->slots; ++i) {
+		fprintf(aot->out, "\ts%u = frame[%u];\n", i, i);
+	}
+}
+
+/// \brief Prints the native code of a single instruction.
+///
+/// \param[in,out] aot The translator.
+/// \param[in] pc The address of the instruction.
+static void aot_op(aot_t *aot, const pvm_address_t pc) {
+	FILE *const out = aot->out;
+	const pvm_op_t op = aot->image.code[pc];
+	const pvm_verify_state_t *const s = &aot->states[pc];
+	const unsigned d = s->depth;
+	unsigned depth;
+	int32_t param;
+
+	if (op < PVM_OP_PSC) {
+		fprintf(out, "\t// %u: PSH %u\n\ts%u = %u;\n", pc, op, d, op);
+		return;
+	}
+	if (op < PVM_OP_BZE) {
+		fprintf(out, "\t// %u: PSC %u\n\ts%u = (pvm_data_t)((uint32_t)s%u << 5 | %uu);\n", pc, op & 0x1F, d - 1, d - 1, op & 0x1F);
+		return;
+	}
+	if (op < PVM_OP_JMP) fprintf(out, "\t// %u: %s\n", pc, aot_mnemonics[op - PVM_OP_BZE]);
+
+	if (op < PVM_OP_ADD) {
+		// the offset goes first, BZE and BNZ test a single value while the rest compare two of them
+		const pvm_address_t target = aot_target(pc, s->value[0]);
+		static const char *const tests[] = { "== 0", "!= 0", "== 0", "!= 0", "> 0", "< 0", ">= 0", "<= 0" };
+		if (op < PVM_OP_BEQ) fprintf(out, "\tif (s%u %s) goto b%u;\n", d - 2, tests[op & 7], target);
+		else fprintf(out, "\tif ((pvm_data_t)((uint32_t)s%u - (uint32_t)s%u) %s) goto b%u;\n", d - 2, d - 3, tests[op & 7], target);
+		fprintf(out, "\tgoto b%u;\n", pc + 1u);
+		return;
+	}
+	if (op < PVM_OP_SKZ) {
+		// the top of the data stack is the left operand
+		static const char *const operators[] = { "+", "-", "*" };
+		switch (op) {
+			case PVM_OP_ADD:
+			case PVM_OP_SUB:
+			case PVM_OP_MUL:
+				fprintf(out, "\ts%u = (pvm_data_t)((uint32_t)s%u %s (uint32_t)s%u);\n", d - 2, d - 1, operators[op - PVM_OP_ADD], d - 2);
+				break;
+			case PVM_OP_DIV:
+				// the interpreter raises whatever the division by zero or the overflow of the quotient does
+				fprintf(out, "\tif (s%u == 0 || (s%u == INT32_MIN && s%u == -1)) {\n", d - 2, d - 1, d - 2);
+				aot_leave(aot, pc, d, 1);
+				fprintf(out, "\t}\n\ts%u = (pvm_data_t)((int32_t)s%u / (int32_t)s%u);\n", d - 2, d - 1, d - 2);
+				break;
+			case PVM_OP_PWR:
+				fprintf(out, "\ts%u = pvm_aot_power(s%u, s%u);\n", d - 2, d - 1, d - 2);
+				break;
+			default:
+				fprintf(out, "\ts%u = s%u %s s%u;\n", d - 2, d - 1, op == PVM_OP_AND ? "&" : op == PVM_OP_IOR ? "|" : "^", d - 2);
+				break;
+		}
+		return;
+	}
+	if (op < PVM_OP_SLP) {
+		static const char *const tests[] = { "== 0", "!= 0", "< 0", ">= 0" };
+		fprintf(out, "\tif (s%u %s) goto b%u;\n\tgoto b%u;\n", d - 1, tests[op & 3], pc + 2u, pc + 1u);
+		return;
+	}
+	if (op < PVM_OP_JMP) {
+		const char *unary = NULL;
+		switch (op) {
+			case PVM_OP_RET: {
+				const pvm_function_t *const fun = &aot->image.functions[s->owner - 1];
+				aot_store(aot);
+				for (unsigned i = 0; i < fun->returns_count; ++i) {
+					fprintf(out, "\tframe[%u] = s%u;\n", i, d - fun->returns_count + i);
+				}
+				fprintf(out, "\tvm->pc = vm->call_stack[--vm->call_top].return_address;\n");
+				fprintf(out, "\tvm->data_top = start + %u;\n", fun->returns_count);
+				if (fun->returns_count) fprintf(out, "\tpvm_aot_charge(budget, %u);\n", fun->returns_count);
+				fprintf(out, "\t*left = budget;\n\treturn PVM_AOT_RETURN;\n");
+				return;
+			}
+			case PVM_OP_LDC: {
+				// the constants are signed, so they are extended to 32 bits as they are
+				const int32_t constant = aot->image.constants[s->value[0]];
+				fprintf(out, "\ts%u = (pvm_data_t)%ld;\n", d - 1, (long)constant);
+				return;
+			}
+			case PVM_OP_JMB:
+				param = (int32_t)(0u - (uint32_t)s->value[0]);
+				if (param < 0) param -= 2;
+				fprintf(out, "\tgoto b%u;\n", aot_target(pc, param));
+				return;
+			case PVM_OP_NEG: unary = "(pvm_data_t)(0u - (uint32_t)s%u)"; break;
+			case PVM_OP_INV: unary = "~s%u"; break;
+			case PVM_OP_INC: unary = "(pvm_data_t)((uint32_t)s%u + 1u)"; break;
+			case PVM_OP_DEC: unary = "(pvm_data_t)((uint32_t)s%u - 1u)"; break;
+			default:
+				// POP only drops the slots
+				return;
+		}
+		fprintf(out, "\ts%u = ", d - 1);
+		fprintf(out, unary, d - 1);
+		fprintf(out, ";\n");
+		return;
+	}
+
+	param = aot_param(aot, pc, &depth);
+	switch (op & 0xF0) {
+		case PVM_OP_JMP:
+			fprintf(out, "\t// %u: JMP %ld\n", pc, (long)param);
+			if (param < 0) param -= 2;
+			fprintf(out, "\tgoto b%u;\n", aot_target(pc, param));
+			return;
+		case PVM_OP_LDV:
+			fprintf(out, "\t// %u: LDV %ld\n\ts%u = s%ld;\n", pc, (long)param, depth, (long)param);
+			return;
+		case PVM_OP_STV:
+			fprintf(out, "\t// %u: STV %ld\n\ts%ld = s%u;\n", pc, (long)param, (long)param, depth - 1);
+			return;
+		default:
+			break;
+	}
+
+	// CAL, the depth following it tells the number of the arguments taken, the variadic ones included
+	const pvm_function_t *const fun = &aot->image.functions[param];
+	const unsigned base = aot->states[pc + 1].depth - fun->returns_count;
+	fprintf(out, "\t// %u: CAL %ld\n", pc, (long)param);
+	if (fun->is_built_in) {
+		aot_store(aot);
+		fprintf(out, "\tvm->pc = %u;\n\tvm->data_top = start + %u;\n", pc + 1u, depth);
+		fprintf(out, "\tif (pvm_aot_builtin(vm, %ld, &budget)) {\n", (long)param);
+		aot_leave(aot, pc, d, 1);
+		fprintf(out, "\t}\n");
+	}
+	else {
+		const unsigned frame = aot->frames[param];
+		fprintf(out, "\tif (vm->call_top >= pvm_call_stack_size(vm) || start + %u > pvm_data_stack_size(vm)) {\n", base + frame);
+		aot_leave(aot, pc, d, 1);
+		fprintf(out, "\t}\n");
+		aot_store(aot);
+		fprintf(out, "\t{\n\t\tstruct pvm_call_stack *const call = &vm->call_stack[vm->call_top++];\n");
+		fprintf(out, "\t\tcall->function = &vm->persist.image->functions[%ld];\n", (long)param);
+		fprintf(out, "\t\tcall->return_address = %u;\n", pc + 1u);
+		fprintf(out, "\t\tcall->variables_start = start + %u;\n", base);
+		fprintf(out, "\t\tcall->arguments_count = %u;\n", fun->arguments_count);
+		fprintf(out, "\t\tcall->function_index = %ld;\n\t}\n", (long)param);
+		for (unsigned i = 0; i < fun->variables_count; ++i) {
+			fprintf(out, "\tframe[%u] = 0;\n", depth + i);
+		}
+		fprintf(out, "\tvm->pc = %u;\n\tvm->data_top = start + %u;\n", fun->address, depth + fun->variables_count);
+		if (fun->variables_count) fprintf(out, "\tpvm_aot_charge(budget, %u);\n", fun->variables_count);
+		fprintf(out, "\t*left = budget;\n");
+		fprintf(out, "\t{\n\t\tconst enum pvm_aot_exit result = %s_%ld(vm, left);\n", aot->name, (long)param);
+		fprintf(out, "\t\tif (result != PVM_AOT_RETURN) return result;\n\t}\n\tbudget = *left;\n");
+	}
+	// the function may have written any slot above its arguments, not only its return values
+	aot_load(aot);
+	if (fun->is_built_in) {
+		fprintf(out, "\tif (vm->waiting || vm->timer) {\n\t\t*left = budget;\n\t\treturn PVM_AOT_YIELD;\n\t}\n");
+	}
+	fprintf(out, "\tgoto b%u;\n", pc + 1u);
+}
+
+/// \brief Prints the native code of main() or of a user function.
+///
+/// \param[in,out] aot The translator.
+/// \param[in] owner The index of the function plus one or zero for main().
+static void aot_function(aot_t *aot, const uint32_t owner) {
+	FILE *const out = aot->out;
+	unsigned slots = 0;
+	for (pvm_address_t pc = 0; pc < aot->image.code_size; ++pc) {
+		const pvm_verify_state_t *const s = &aot->states[pc];
+		if ((s->flags & PVM_VERIFY_VISITED) && s->owner == owner && s->depth > slots) slots = s->depth;
+	}
+	aot->slots = slots;
+	if (owner) fprintf(out, "\n/// \\brief The native code of function %u.\n", owner - 1u);
+	else fprintf(out, "\n/// \\brief The native code of main().\n");
+	if (owner) fprintf(out, "static enum pvm_aot_exit %s_%u(pvm_t *vm, uint32_t *const left) {\n", aot->name, owner - 1u);
+	else fprintf(out, "static enum pvm_aot_exit %s_main(pvm_t *vm, uint32_t *const left) {\n", aot->name);
+	fprintf(out, "\tconst pvm_data_stack_t start = vm->call_top ? vm->call_stack[vm->call_top - 1].variables_start : 0;\n");
+	fprintf(out, "\tpvm_data_t *const frame = vm->data_stack + start;\n");
+	fprintf(out, "\tuint32_t budget = *left;\n");
+	fprintf(out, "\tpvm_address_t pc;\n");
+	fprintf(out, "\tpvm_data_stack_t depth = vm->data_top - start;\n");
+	fprintf(out, "\t// the native code does not check the frame, so it must fit into the data stack\n");
+	fprintf(out, "\tif (vm->data_top < start || depth > %u || start + %u > pvm_data_stack_size(vm)) return PVM_AOT_INTERPRET;\n", slots, slots);
+	// the slots above the top are loaded as well, the native code leaves them as it finds them unless it pushes there
+	if (slots) {
+		fprintf(out, "\tpvm_data_t s0 = frame[0]");
+		for (unsigned i = 1; i < slots; ++i) {
+			fprintf(out, ", s%u = frame[%u]", i, i);
+		}
+		fprintf(out, ";\n");
+	}
+	// resume at the start of a block, instructions within one are stepped by the interpreter up to the next one
+	fprintf(out, "\tswitch (vm->pc) {\n");
+	for (pvm_address_t pc = 0; pc < aot->image.code_size; ++pc) {
+		const pvm_verify_state_t *const s = &aot->states[pc];
+		if (!(s->flags & PVM_VERIFY_VISITED) || s->owner != owner) continue;
+		if (aot->leaders[pc]) fprintf(out, "\t\tcase %u: if (depth == %u) goto b%u; break;\n", pc, s->depth, pc);
+		else fprintf(out, "\t\tcase %u: return PVM_AOT_STEP;\n", pc);
+	}
+	fprintf(out, "\t\tdefault: break;\n\t}\n\treturn PVM_AOT_INTERPRET;\n");
+
+	for (pvm_address_t pc = 0; pc < aot->image.code_size; ++pc) {
+		const pvm_verify_state_t *const s = &aot->states[pc];
+		if (!(s->flags & PVM_VERIFY_VISITED) || s->owner != owner) continue;
+		if (aot->leaders[pc]) {
+			fprintf(out, "b%u:\n", pc);
+			if (aot_interpreted(aot, pc)) {
+				fprintf(out, "\t// %u: %s, left to the interpreter\n\t{\n", pc, aot->image.code[pc] == PVM_OP_SLP ? "SLP" : "RET");
+				aot_leave(aot, pc, s->depth, 0);
+				fprintf(out, "\t}\n");
+				continue;
+			}
+			fprintf(out, "\tif (budget < ");
+			aot_cost(aot, pc);
+			fprintf(out, ") {\n");
+			aot_leave(aot, pc, s->depth, 0);
+			fprintf(out, "\t}\n\tbudget -= ");
+			aot_cost(aot, pc);
+			fprintf(out, ";\n");
+		}
+		aot_op(aot, pc);
+	}
+
+	// every block checks its budget, so the native code always has a way to leave
+	fprintf(out, "leave:\n");
+	aot_store(aot);
+	fprintf(out, "\tvm->pc = pc;\n\tvm->data_top = start + depth;\n\t*left = budget;\n\treturn PVM_AOT_INTERPRET;\n}\n");
+}
+
+/// \brief Prints the native code of the whole executable.
+static void aot_translate(aot_t *aot, const char *source) {
+	FILE *const out = aot->out;
+	const uint16_t functions_count = aot->image.functions_count;
+	fprintf(out, "// The native code of %s generated by pvm-aot, do not edit.\n\n", source);
+	fprintf(out, "#include \"pvm_aot.h\"\n\n");
+	fprintf(out, "#if PVM_DATA_STACK_SIZE != %d || PVM_CALL_STACK_SIZE != %d || PVM_DATA_WIDTH != %d\n", PVM_DATA_STACK_SIZE, PVM_CALL_STACK_SIZE, PVM_DATA_WIDTH);
+	fprintf(out, "#error \"The native code was verified with other stack sizes or data width\"\n#endif\n");
+	fprintf(out, "\nstatic pvm_aot_f %s_main", aot->name);
+	for (uint16_t i = 0; i < functions_count; ++i) {
+		if (!aot->image.functions[i].is_built_in) fprintf(out, ", %s_%u", aot->name, i);
+	}
+	fprintf(out, ";\n");
+
+	aot_function(aot, 0);
+	for (uint16_t i = 0; i < functions_count; ++i) {
+		if (!aot->image.functions[i].is_built_in) aot_function(aot, i + 1);
+	}
+
+	fprintf(out, "\nstatic pvm_aot_f *const %s_functions[] = {\n\t%s_main,\n", aot->name, aot->name);
+	for (uint16_t i = 0; i < functions_count; ++i) {
+		if (aot->image.functions[i].is_built_in) fprintf(out, "\tNULL,\n");
+		else fprintf(out, "\t%s_%u,\n", aot->name, i);
+	}
+	fprintf(out, "};\n\nconst pvm_aot_t %s = { 0x%08lXu, %s_functions, %u };\n", aot->name,
+		(unsigned long)pvm_exe_hash(aot->image.exe), aot->name, functions_count + 1u);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-n name] [-o output] <filename>\n", name);
+}
+
+/// \brief Derives the identifier of the native code from the name of the executable file.
+static char *default_name(const char *filename) {
+	const char *base = strrchr(filename, '/');
+	base = base ? base + 1 : filename;
+	const size_t length = strcspn(base, ".");
+	char *name = malloc(sizeof("pvm_aot_") + length);
+	if (!name) return NULL;
+	strcpy(name, "pvm_aot_");
+	for (size_t i = 0; i < length; ++i) {
+		name[sizeof("pvm_aot_") - 1 + i] = isalnum((unsigned char)base[i]) ? base[i] : '_';
+	}
+	name[sizeof("pvm_aot_") - 1 + length] = '\0';
+	return name;
+}
+
+int main(const int argc, char *const argv[]) {
+	const char *output = NULL;
+	char *name = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "n:o:")) != -1) {
+		switch (option) {
+			case 'n': name = optarg; break;
+			case 'o': output = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	const char *const filename = argv[optind];
+	char *const derived = name ? NULL : default_name(filename);
+	if (!name) name = derived;
+
+	pvm_exe_map_t map;
+	const enum pvm_exe_check_result check = pvm_exe_map_file(&map, filename);
+	if (check) {
+		fprintf(stderr, check == PVM_EXE_IO ? "Failed to map file\n" : "Invalid exe\n");
+		return 1;
+	}
+
+	// only verified code is translated, the native code relies on the static stack depths and operands
+	pvm_image_t image;
+	pvm_image_init(&image, map.image);
+	const size_t scratch_size = pvm_exe_verify_size(map.image);
+	void *const scratch = malloc(scratch_size);
+	pvm_verify_state_t *const states = malloc(image.code_size * sizeof(pvm_verify_state_t) + 1);
+	uint8_t *const frames = malloc(image.functions_count + 1u);
+	uint8_t *const leaders = calloc(image.code_size + 1u, 1);
+	if (!name || !scratch || !states || !frames || !leaders) {
+		perror("Failed to allocate");
+		return 1;
+	}
+	pvm_verify_t verify = { .frames = frames, .states = states };
+	const enum pvm_exe_check_result result = pvm_exe_map_verify(&map, scratch, scratch_size, &verify);
+	free(scratch);
+	if (result) {
+		fprintf(stderr, "Exe not verified (%d)\n", result);
+		return 1;
+	}
+
+	aot_t aot = { .out = stdout, .name = name, .image = image, .states = states, .frames = frames, .leaders = leaders };
+	if (output && !(aot.out = fopen(output, "w"))) {
+		perror("Failed to open output");
+		return 1;
+	}
+	aot_leaders(&aot);
+	aot_translate(&aot, filename);
+	const int failed = ferror(aot.out) | (output ? fclose(aot.out) : fflush(aot.out));
+	if (failed) fprintf(stderr, "Failed to write output\n");
+
+	free(leaders);
+	free(frames);
+	free(states);
+	free(derived);
+	pvm_exe_unmap(&map);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pvm.h"
+
+// the engine this binary is built with, see bench/CMakeLists.txt
+#if defined(PVM_PREPARE)
+#define BENCH_ENGINE "prepared"
+#elif defined(PVM_DISPATCH_THREADED)
+#define BENCH_ENGINE "threaded"
+#else
+#define BENCH_ENGINE "tree"
+#endif
+
+// opcodes used by the corpus
+#define PSH(n) (n)
+#define PSC(n) (0x80 | (n))
+#define ADD 0xA8
+#define SUB 0xA9
+#define XOR 0xAF
+#define PWR 0xAC
+#define BZE 0xA0
+#define RET 0xB5
+#define LDC 0xB6
+#define JMB 0xB7
+#define DEC 0xBB
+#define POP 0xBC
+#define CAL(i) (0xD0 | (i))
+#define LDV(i) (0xE0 | (i))
+#define STV(i) (0xF0 | (i))
+
+// every benchmark counts variable 0 down from constant 0 around its body which makes variable 1 available to it
+#define LOOP_BEGIN PSH(0), LDC, STV(0)
+// leave when the counter reaches zero, otherwise jump back by the body size plus the seven bytes preceding JMB
+#define LOOP_END(body_size) LDV(0), DEC, STV(0), LDV(0), PSH(1), BZE, PSH((body_size) + 7), JMB, RET
+
+// recursion depth keeping the frames within both stacks, main() occupies two slots for its variables
+#define RECURSION_DEPTH (PVM_CALL_STACK_SIZE - 1 < PVM_DATA_STACK_SIZE - 3 ? PVM_CALL_STACK_SIZE - 1 : PVM_DATA_STACK_SIZE - 3)
+
+uint32_t now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/// \brief The last argument taken by `bench_sink()`, volatile so the calls are not optimized away.
+static volatile pvm_data_t bench_sunk;
+
+static void bench_sink(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+	(void)vm;
+	for (int i = 0; i < args_size; ++i) {
+		bench_sunk = arguments[i];
+	}
+}
+
+const packed_struct pvm_builtins pvm_builtins[] = {
+{ bench_sink },
+};
+
+const size_t pvm_builtins_size = sizeof(pvm_builtins) / sizeof(pvm_builtins[0]);
+
+/// \brief Describes a benchmark of the corpus.
+typedef struct bench {
+	const char *name;
+	/// \brief Function descriptors as laid out in the executable, 5 bytes each.
+	const uint8_t *functions;
+	uint8_t functions_count;
+	/// \brief Constants, the first one is the number of loop iterations.
+	const int32_t *constants;
+	uint8_t constants_count;
+	const uint8_t *code;
+	size_t code_size;
+} bench_t;
+
+static const uint8_t arith_code[] = {
+	LOOP_BEGIN,
+	// v1 = (v1 + v0) ^ 7
+	LDV(1), LDV(0), ADD, PSH(7), XOR, STV(1),
+	LOOP_END(6)
+};
+static const int32_t arith_constants[] = { 1000000 };
+
+static const uint8_t pwr_code[] = {
+	LOOP_BEGIN,
+	// v1 = 3 ** 19
+	PSH(19), PSH(3), PWR, STV(1),
+	LOOP_END(4)
+};
+static const int32_t pwr_constants[] = { 1000000 };
+
+static const uint8_t recursion_code[] = {
+	LOOP_BEGIN,
+	PSH(RECURSION_DEPTH), CAL(0),
+	LOOP_END(2),
+	// f(n) { if (n) f(n - 1); } at address 14
+	LDV(0), PSH(2), BZE, LDV(0), DEC, CAL(0), RET
+};
+static const uint8_t recursion_functions[] = { 14, 0, 1, 0, 0x00 };
+static const int32_t recursion_constants[] = { 100000 };
+
+static const uint8_t variadic_code[] = {
+	LOOP_BEGIN,
+	// sink(v0, 1, 2)
+	LDV(0), PSH(1), PSH(2), PSH(3), CAL(0),
+	LOOP_END(5)
+};
+// built-in variadic function 0
+static const uint8_t variadic_functions[] = { 0, 0, 0, 0, 0xC0 };
+static const int32_t variadic_constants[] = { 1000000 };
+
+static const uint8_t constants_code[] = {
+	LOOP_BEGIN,
+	// v1 = (c1 + c2 + c3) ^ c4
+	PSH(1), LDC, PSH(2), LDC, ADD, PSH(3), LDC, ADD, PSH(4), LDC, XOR, STV(1),
+	LOOP_END(12)
+};
+static const int32_t constants_constants[] = { 1000000, 100000, -200000, 300000, 0x5A5A5A };
+
+static const uint8_t literals_code[] = {
+	LOOP_BEGIN,
+	// v1 = 0xFFFF ^ 0x433A56D built by PSH and PSC chains
+	PSH(1), PSC(31), PSC(31), PSC(31), PSH(2), PSC(3), PSC(7), PSC(9), PSC(11), PSC(13), XOR, STV(1),
+	LOOP_END(12)
+};
+static const int32_t literals_constants[] = { 1000000 };
+
+#define BENCH(name, functions, functions_count) \
+	{ #name, functions, functions_count, name##_constants, sizeof(name##_constants) / sizeof(int32_t), name##_code, sizeof(name##_code) }
+
+static const bench_t corpus[] = {
+	BENCH(arith, NULL, 0),
+	BENCH(pwr, NULL, 0),
+	BENCH(recursion, recursion_functions, 1),
+	BENCH(variadic, variadic_functions, 1),
+	BENCH(constants, NULL, 0),
+	BENCH(literals, NULL, 0),
+};
+
+/// \brief Assembles the executable of a benchmark with the given iteration scale.
+///
+/// \return The size of the executable or zero if it does not fit into the buffer.
+static size_t bench_assemble(const bench_t *bench, const uint32_t scale, uint8_t *buffer, const size_t size) {
+	const size_t total = 6 + bench->functions_count * 5u + bench->constants_count * sizeof(int32_t) + bench->code_size;
+	if (total > size || total - 6 > 0xFFFF) return 0;
+	uint8_t *p = buffer;
+	*p++ = PVM_EXE_V1;
+	*p++ = (total - 6) & 0xFF;
+	*p++ = (total - 6) >> 8;
+	*p++ = bench->functions_count;
+	*p++ = bench->constants_count;
+	// the loop counter and the accumulator
+	*p++ = 2;
+	memcpy(p, bench->functions, bench->functions_count * 5u);
+	p += bench->functions_count * 5u;
+	for (int i = 0; i < bench->constants_count; ++i) {
+		const int32_t constant = i ? bench->constants[i] : bench->constants[i] * (int32_t)scale;
+		for (int b = 0; b < 4; ++b) {
+			*p++ = (uint8_t)((uint32_t)constant >> (8 * b));
+		}
+	}
+	memcpy(p, bench->code, bench->code_size);
+	return total;
+}
+
+/// \brief Runs the program loaded into an instance until it stops.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[out] err The error the program stops with.
+///
+/// \return The budget spent, a unit per instruction dispatched.
+static uint64_t bench_run(pvm_t *vm, pvm_errno_t *err) {
+	uint64_t spent = 0;
+	do {
+		uint32_t budget = 1u << 20;
+		*err = pvm_run_budget(vm, &budget);
+		spent += (1u << 20) - budget;
+	} while (!*err);
+	return spent;
+}
+
+static uint64_t bench_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int main(const int argc, const char *argv[]) {
+	int json = 0;
+	uint32_t scale = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--json")) json = 1;
+		else if (!strcmp(argv[i], "--scale") && i + 1 < argc) scale = strtoul(argv[++i], NULL, 0);
+		else {
+			fprintf(stderr, "Usage: %s [--json] [--scale n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!scale) scale = 1;
+
+	static uint8_t exe[1024];
+	#ifdef PVM_PREPARE
+	static uint8_t arena[65536];
+	#endif
+	static pvm_t vm;
+	pvm_image_t image;
+	int failed = 0;
+
+	if (json) printf("[\n");
+	for (size_t b = 0; b < sizeof(corpus) / sizeof(corpus[0]); ++b) {
+		const bench_t *const bench = &corpus[b];
+		const size_t size = bench_assemble(bench, scale, exe, sizeof(exe));
+		if (!size || pvm_exe_check((const pvm_exe_t *)exe, size)) {
+			fprintf(stderr, "%s: invalid executable\n", bench->name);
+			return 1;
+		}
+		memset(&vm, 0, sizeof(vm));
+		pvm_image_init(&image, (const pvm_exe_t *)exe);
+		vm.persist.image = &image;
+		int verified = 0;
+		#ifdef PVM_PREPARE
+		vm.persist.prepared = pvm_prepare(image.exe, arena, sizeof(arena));
+		uint8_t scratch[4096];
+		verified = pvm_exe_verify(image.exe, scratch, sizeof(scratch), NULL) == PVM_EXE_OK;
+		#endif
+		pvm_reset(&vm);
+
+		pvm_errno_t err;
+		const uint64_t start = bench_now_ns();
+		const uint64_t dispatched = bench_run(&vm, &err);
+		const uint64_t ns = bench_now_ns() - start;
+		if (err != PVM_MAIN_RETURN) failed = 1;
+
+		// the prepared engine dispatches a fused instruction for a whole sequence, so the opcodes retired are counted by
+		// a run without the prepared code, which keeps the time per opcode comparable across the engines
+		uint64_t retired = dispatched;
+		#ifdef PVM_PREPARE
+		pvm_errno_t counted;
+		memset(&vm, 0, sizeof(vm));
+		vm.persist.image = &image;
+		pvm_reset(&vm);
+		retired = bench_run(&vm, &counted);
+		#endif
+
+		const double ns_per_op = retired ? (double)ns / retired : 0;
+		const double ops_per_sec = ns ? retired * 1e9 / ns : 0;
+		if (json) {
+			printf("  {\"benchmark\": \"%s\", \"engine\": \"%s\", \"verified\": %s, \"data_stack\": %d, \"call_stack\": %d, "
+				"\"instructions\": %llu, \"dispatches\": %llu, \"ns\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, "
+				"\"error\": %d}%s\n",
+				bench->name, BENCH_ENGINE, verified ? "true" : "false", PVM_DATA_STACK_SIZE, PVM_CALL_STACK_SIZE,
+				(unsigned long long)retired, (unsigned long long)dispatched, (unsigned long long)ns, ns_per_op, ops_per_sec, err,
+				b + 1 < sizeof(corpus) / sizeof(corpus[0]) ? "," : "");
+		}
+		else {
+			printf("%-10s %-8s %12llu ops %12llu dispatches %8.3f ns/op %12.0f ops/sec%s\n", bench->name, BENCH_ENGINE,
+				(unsigned long long)retired, (unsigned long long)dispatched, ns_per_op, ops_per_sec,
+				err == PVM_MAIN_RETURN ? "" : " FAILED");
+		}
+	}
+	if (json) printf("]\n");
+	return failed;
+}
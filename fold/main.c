@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pvm.h"
+
+/// \brief The longest folded stack: the instance, main(), the truncation mark and the functions.
+#define FOLD_STACK_SIZE (sizeof("vm255;main;...") + PVM_SAMPLE_DEPTH * sizeof(";f65535"))
+
+/// \brief Represents the folded stack of a sample.
+typedef struct fold {
+	char stack[FOLD_STACK_SIZE];
+} fold_t;
+
+static int compare(const void *a, const void *b) {
+	return strcmp(((const fold_t *)a)->stack, ((const fold_t *)b)->stack);
+}
+
+/// \brief Folds a sample into its stack, the instance first and the innermost function last.
+///
+/// \param[out] stack The folded stack.
+/// \param[in] record The sample drained by `pvm_sampler_drain()`.
+static void fold_record(char *stack, const uint8_t record[PVM_SAMPLE_RECORD_SIZE]) {
+	const unsigned depth = record[1];
+	const unsigned frames = depth < PVM_SAMPLE_DEPTH ? depth : PVM_SAMPLE_DEPTH;
+	int length = sprintf(stack, "vm%u;main", record[0]);
+	// the outer frames of the deeper stacks are not sampled
+	if (depth > frames) length += sprintf(stack + length, ";...");
+	for (unsigned i = 0; i < frames; ++i) {
+		length += sprintf(stack + length, ";f%u", record[4 + 2 * i] | record[5 + 2 * i] << 8);
+	}
+}
+
+int main(const int argc, const char *argv[]) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <samples>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *const file = fopen(argv[1], "rb");
+	if (!file) {
+		perror("Failed to open samples");
+		return 1;
+	}
+
+	// every sample is folded on its own, the identical stacks are merged once sorted
+	fold_t *folds = NULL;
+	size_t count = 0, capacity = 0;
+	uint8_t record[PVM_SAMPLE_RECORD_SIZE];
+	while (fread(record, sizeof(record), 1, file) == 1) {
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 1024;
+			fold_t *const grown = realloc(folds, capacity * sizeof(fold_t));
+			if (!grown) {
+				perror("Failed to allocate");
+				fclose(file);
+				free(folds);
+				return 1;
+			}
+			folds = grown;
+		}
+		fold_record(folds[count++].stack, record);
+	}
+	const int failed = ferror(file);
+	if (failed) perror("Failed to read samples");
+	fclose(file);
+
+	if (count) qsort(folds, count, sizeof(fold_t), compare);
+	for (size_t i = 0; i < count;) {
+		size_t same = i + 1;
+		while (same < count && !strcmp(folds[same].stack, folds[i].stack)) ++same;
+		printf("%s %lu\n", folds[i].stack, (unsigned long)(same - i));
+		i = same;
+	}
+
+	free(folds);
+	return failed ? 1 : 0;
+}
@@ -1,4 +1,8 @@
-#include "pvm.h"
+#include "pvm_internal.h"
+
+#ifdef PVM_NATURAL_LAYOUT
+#include <string.h>
+#endif
 
 // ReSharper disable CppRedundantInlineSpecifier
 
@@ -22,16 +26,6 @@
 #define p_slp(value)
 #endif
 
-#define PVM_INTEGRAL_OP_MASK 0x0F
-
-#ifndef section_pvm_core
-#if defined(__GNUC__) || defined(__clang__)
-#define section_pvm_core __attribute__((section(".pvm_core")))
-#else
-#define section_pvm_core
-#endif
-#endif
-
 /// \brief Validates the given function index against the size of executable's function table.
 ///
 /// \param[in] vm The PVM instance.
@@ -42,97 +36,215 @@
 /// \details This function checks if the provided function index is within the valid range of the executable's functions table.
 /// It returns an error if the index is negative or greater than or equal to the number of functions in the executable.
 static inline section_pvm_core pvm_errno_t pvm_validate_function_index(const pvm_t *vm, const int32_t index) {
-	if (index < 0 || index >= vm->persist.exe->functions_count) return PVM_EXE_NO_FUNCTION;
+	if (index < 0 || index >= vm->persist.image->functions_count) return PVM_EXE_NO_FUNCTION;
 	return PVM_NO_ERROR;
 }
 
-/// \brief Retrieves the pointer to the constants section of the PVM executable.
+#ifdef PVM_PREPARE
+// only the verified engine addresses the variables from the start of the frame directly
+/// \brief Retrieves the starting index of the current function's variables in the PVM data stack.
 ///
-/// \param[in] exe The PVM executable.
+/// \param[in] vm The PVM instance.
 ///
-/// \return A pointer to the constants section of the executable.
+/// \return The starting index of the current function's variables in the data stack.
 ///
-/// \details This function calculates and returns the address of the constants section in the PVM executable.
-/// The constants section follows the functions section in the executable.
-static inline pvm_const_t section_pvm_core *pvm_constants(const pvm_exe_t *exe) {
-	return (pvm_const_t *)&exe->functions[exe->functions_count];
+/// \details This function returns the starting index of the variables for the currently executing function in the PVM data stack.
+/// If the call stack is empty, it indicates that the main program is executing, and the function returns 0.
+static pvm_data_stack_t section_pvm_core pvm_current_variables_start(const pvm_t *vm) {
+	// main variables start from the beginning of the data stack
+	pvm_data_stack_t offset = 0;
+	pvm_call_stack_t top;
+	if ((top = vm->call_top)) {
+		offset = vm->call_stack[top - 1].variables_start;
+	}
+	return offset;
 }
+#endif
 
-/// \brief Retrieves the pointer to the code section of the PVM executable.
-///
-/// \param[in] exe The PVM executable.
+#ifndef PVM_DISPATCH_THREADED
+// the threaded engine pushes onto its cached top of the data stack instead
+/// \brief Pushes a value onto the PVM data stack.
 ///
-/// \return A pointer to the code section of the executable.
+/// \param[in,out] vm The PVM instance.
+/// \param[in,out] top The cached data stack top of the running instance.
+/// \param[in] data The value to push.
 ///
-/// \details This function calculates and returns the address of the code section in the PVM executable.
-/// The code section follows the constants section in the executable.
-static inline pvm_op_t section_pvm_core *pvm_code(const pvm_exe_t *exe) {
-	return (pvm_op_t *)&pvm_constants(exe)[exe->constants_count];
+/// \return PVM_DATA_STACK_OVERFLOW if the stack is full, otherwise PVM_NO_ERROR.
+static section_pvm_core pvm_errno_t pvm_data_stack_push(pvm_t *vm, pvm_data_stack_t *top, const pvm_data_t data) {
+	if (*top >= pvm_data_stack_size(vm)) return PVM_DATA_STACK_OVERFLOW;
+	vm->data_stack[(*top)++] = data;
+	return PVM_NO_ERROR;
 }
+#endif
 
-/// \brief Retrieves the size of the code section in the PVM executable.
-///
-/// \param[in] exe The PVM executable.
+/// \brief Pops a value from the PVM data stack expanding its sign.
 ///
-/// \return The size of the code section in bytes.
+/// \param[in,out] vm The PVM instance.
+/// \param[in,out] top The cached data stack top of the running instance.
+/// \param[out] data The popped value.
 ///
-/// \details This function calculates and returns the size of the code section in the PVM executable.
-/// The code section size is determined by subtracting the size of the constants section from the total size of the executable.
-static inline size_t section_pvm_core pvm_code_size(const pvm_exe_t *exe) {
-	return exe->size - ((uint8_t *)&pvm_constants(exe)[exe->constants_count] - (uint8_t *)&exe->functions[0]);
+/// \return PVM_DATA_STACK_UNDERFLOW if the stack is empty, otherwise PVM_NO_ERROR.
+static section_pvm_core pvm_errno_t pvm_data_stack_pop(pvm_t *vm, pvm_data_stack_t *top, int32_t *data) {
+	if (*top == 0) return PVM_DATA_STACK_UNDERFLOW;
+	*data = pvm_data_expand(vm->data_stack[--*top]);
+	return PVM_NO_ERROR;
 }
 
-/// \brief Retrieves the index of the currently executing function in the PVM.
+/// \brief Resolves an index of the current function's variable into the position in the PVM data stack.
 ///
 /// \param[in] vm The PVM instance.
+/// \param[in,out] param The variable index to be replaced with its data stack position.
 ///
-/// \return The index of the currently executing function, or -1 for main().
-///
-/// \details This function returns the index of the function that is currently being executed by the PVM.
-/// If the call stack is empty, it indicates that the main() is executing, and the function returns -1.
-static int section_pvm_core pvm_current_function(const pvm_t *vm) {
+/// \return PVM_NO_VARIABLE if the index is out of the current scope, PVM_VAR_OUT_OF_STACK if the variable lays beyond
+/// the data stack, otherwise PVM_NO_ERROR.
+static section_pvm_core pvm_errno_t pvm_variable(const pvm_t *vm, int32_t *param) {
+	uint_fast8_t stack_size = vm->persist.image->main_variables_count;
 	// main variables start from the beginning of the data stack
-	pvm_call_stack_t top;
-	if (((top = vm->call_top)) && top <= PVM_CALL_STACK_SIZE) {
-		return vm->call_stack[top - 1].function_index;
+	pvm_data_stack_t start = 0;
+	if (vm->call_top) {
+		// the frame tells the scope of the current function at once
+		const struct pvm_call_stack *const call = &vm->call_stack[vm->call_top - 1];
+		stack_size = call->function->arguments_count + call->function->variables_count;
+		start = call->variables_start;
 	}
-	return -1;
+	if (*param < 0 || *param >= stack_size) return PVM_NO_VARIABLE;
+	if ((*param += start) >= pvm_data_stack_size(vm)) return PVM_VAR_OUT_OF_STACK;
+	return PVM_NO_ERROR;
 }
 
-/// \brief Retrieves the starting index of the current function's variables in the PVM data stack.
+/// \brief Loads a constant from the constants section of the PVM executable.
 ///
 /// \param[in] vm The PVM instance.
+/// \param[in,out] value The constant index to be replaced with the constant value.
 ///
-/// \return The starting index of the current function's variables in the data stack.
+/// \return PVM_NO_CONSTANT if the index is out of bounds, otherwise PVM_NO_ERROR.
+static section_pvm_core pvm_errno_t pvm_constant(const pvm_t *vm, int32_t *value) {
+	if (*value < 0 || *value >= vm->persist.image->constants_count) return PVM_NO_CONSTANT;
+	p_ld("LDC", *value, vm->persist.image->constants[*value]);
+	*value = pvm_constant_at(vm->persist.image->constants, *value);
+	return PVM_NO_ERROR;
+}
+
+/// \brief Calls a function of the PVM executable by its descriptor.
 ///
-/// \details This function returns the starting index of the variables for the currently executing function in the PVM data stack.
-/// If the call stack is empty, it indicates that the main program is executing, and the function returns 0.
-static pvm_data_stack_t section_pvm_core pvm_current_variables_start(const pvm_t *vm) {
-	// main variables start from the beginning of the data stack
-	pvm_data_stack_t offset = 0;
-	pvm_call_stack_t top;
-	if ((top = vm->call_top)) {
-		offset = vm->call_stack[top - 1].variables_start;
+/// \param[in,out] vm The PVM instance.
+/// \param[in] index The validated index of the function to call.
+/// \param[in] fun The descriptor of the function to call.
+///
+/// \return PVM_NO_ERROR if the function was called successfully, otherwise an error code.
+///
+/// \details Built-in functions are executed at once, for user functions a new call stack frame is created, local
+/// variables are initialized with zeros and the program counter is set to the function address. The running engine must
+/// spill its cached registers before the call, see pvm_spill(), and reload them afterwards, see pvm_fill().
+static section_pvm_core pvm_errno_t pvm_call_function(pvm_t *vm, const int32_t index, const pvm_function_t *const fun) {
+	pvm_errno_t errno;
+	pvm_data_stack_t top = vm->data_top;
+	if (vm->call_top >= pvm_call_stack_size(vm)) return PVM_CALL_STACK_OVERFLOW;
+	// get function arguments size
+	size_t args_size = fun->arguments_count;
+	// for variadic functions, get number of variadic arguments from the stack
+	if (fun->is_variadic) {
+		int32_t variadic_size;
+		if ((errno = pvm_data_stack_pop(vm, &top, &variadic_size))) return errno;
+		vm->data_top = top;
+		if (variadic_size < 0 || (args_size += variadic_size) > 0xFF) return PVM_VARIADIC_SIZE;
 	}
-	return offset;
+	p_cal(fun, args_size);
+	// check if all arguments are in the stack
+	if (top < args_size) return PVM_ARG_OUT_OF_STACK;
+	// arguments are already pushed into the stack, check for stack overflow upon function call
+	const pvm_data_stack_t stack_rest = pvm_data_stack_size(vm) - top;
+	if (stack_rest < fun->variables_count) return PVM_VAR_OUT_OF_STACK;
+	if (stack_rest < fun->returns_count) return PVM_RETURN_OUT_OF_STACK;
+	// calculate function stack start
+	const pvm_data_stack_t call_stack_start = top - args_size;
+	// call the function
+	const pvm_address_t address = fun->address;
+	#ifdef PVM_PROFILE
+	pvm_profile_function_t *const counters = pvm_profile_function(vm, index);
+	if (counters) ++counters->calls;
+	#endif
+	if (fun->is_built_in) {
+		if (address >= pvm_vm_builtins_size(vm)) return PVM_BUILTIN_NO_FUNCTION;
+		#ifdef PVM_PROFILE
+		uint32_t (*const clock)(void) = counters ? vm->persist.profile->clock : NULL;
+		const uint32_t start = clock ? clock() : 0;
+		#endif
+		// for built-in functions, parameters and return values occupy common space
+		pvm_builtin_call(vm, address, vm->data_stack + call_stack_start, args_size, fun->returns_count);
+		// the results of a suspended call are completed later into the very same slots
+		if (vm->waiting) vm->waiting = PVM_WAITING | fun->returns_count;
+		#ifdef PVM_PROFILE
+		if (clock) counters->time += clock() - start;
+		#endif
+		// as no RET instruction was executed, emulate it setting the stack pointer to the number of returns
+		vm->data_top = call_stack_start + fun->returns_count;
+	}
+	else {
+		struct pvm_call_stack *call = &vm->call_stack[vm->call_top++];
+		call->function = fun;
+		call->function_index = index;
+		call->variables_start = call_stack_start;
+		call->arguments_count = args_size;
+		// initialize local variables with zeros at once, their room is already checked against the stack rest
+		for (uint_fast8_t i = 0; i < fun->variables_count; ++i) {
+			vm->data_stack[top + i] = 0;
+		}
+		top += fun->variables_count;
+		#ifdef PVM_CYCLES
+		pvm_charge(vm, fun->variables_count * PVM_CYCLES_SLOT);
+		#endif
+		vm->data_top = top;
+		call->return_address = vm->pc;
+		vm->pc = address;
+	}
+	return PVM_NO_ERROR;
 }
 
-static section_pvm_core pvm_errno_t pvm_data_stack_push(pvm_t *vm, const pvm_data_t data) {
-	if (vm->data_top >= PVM_DATA_STACK_SIZE) return PVM_DATA_STACK_OVERFLOW;
-	vm->data_stack[vm->data_top++] = data;
-	return PVM_NO_ERROR;
+/// \brief Calls a function of the PVM executable.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] index The index of the function to call.
+///
+/// \return PVM_EXE_NO_FUNCTION if the index is out of bounds, otherwise the result of pvm_call_function().
+static inline section_pvm_core pvm_errno_t pvm_call(pvm_t *vm, const int32_t index) {
+	pvm_errno_t errno;
+	if ((errno = pvm_validate_function_index(vm, index))) return errno;
+	return pvm_call_function(vm, index, &vm->persist.image->functions[index]);
 }
 
-static section_pvm_core pvm_errno_t pvm_data_stack_pop(pvm_t *vm, int32_t *data) {
-	if (vm->data_top == 0) return PVM_DATA_STACK_UNDERFLOW;
-	int32_t value = vm->data_stack[--vm->data_top];
-	// expand sign for shorter stack types
-	#if PVM_DATA_SIGN > 0x80000000
-	if (value & PVM_DATA_SIGN) {
-		value |= (int32_t)PVM_DATA_SIGN;
-	}
+/// \brief Returns from the current function of the PVM executable.
+///
+/// \param[in,out] vm The PVM instance.
+///
+/// \return PVM_MAIN_RETURN if main() has returned, PVM_DATA_STACK_SMASHED if the function stack is inconsistent,
+/// otherwise PVM_NO_ERROR.
+///
+/// \details Return values are moved to the beginning of the function stack, then the call stack frame is dropped and the
+/// program counter is set to the return address. The frame holds the descriptor of the function, so nothing is looked
+/// up. Like pvm_call_function(), it operates on the spilled registers.
+static section_pvm_core pvm_errno_t pvm_return(pvm_t *vm) {
+	if (!vm->call_top || vm->call_top > pvm_call_stack_size(vm)) return PVM_MAIN_RETURN;
+	struct pvm_call_stack *const call = &vm->call_stack[--vm->call_top];
+	const pvm_function_t *const fun = call->function;
+	// cleanup stack
+	pvm_data_stack_t stack_start = call->variables_start;
+	uint8_t returns_size = fun->returns_count;
+	pvm_data_stack_t returns_start = vm->data_top - returns_size;
+	// check for smashed stack
+	if (stack_start + call->arguments_count + fun->variables_count != returns_start) return PVM_DATA_STACK_SMASHED;
+	#ifdef PVM_CYCLES
+	pvm_charge(vm, returns_size * PVM_CYCLES_SLOT);
 	#endif
-	*data = value;
+	// move return values to the beginning of the function stack, unless the frame held nothing else
+	if (returns_start != stack_start) {
+		while (returns_size--) {
+			vm->data_stack[stack_start++] = vm->data_stack[returns_start++];
+		}
+	}
+	vm->data_top = call->variables_start + fun->returns_count;
+	vm->pc = call->return_address;
+	p_ret(vm->pc, fun, call->arguments_count);
 	return PVM_NO_ERROR;
 }
 
@@ -141,18 +253,47 @@ static section_pvm_core pvm_errno_t pvm_data_stack_pop(pvm_t *vm, int32_t *data)
 /// \param[in] exe The PVM executable to check.
 /// \param[in] size The size of the executable in bytes.
 ///
-/// \return PVM_EXE_SIZE if the size does not match, PVM_EXE_VERSION if the minimum VM version does not match, otherwise PVM_EXE_OK.
+/// \return PVM_EXE_VERSION if the format of the executable is not supported or it is compiled for other data or constant
+/// widths, PVM_EXE_SIZE if the size does not match or the sections do not fit into it, otherwise PVM_EXE_OK.
 ///
-/// \details This function verifies the size and minimum VM version of the given PVM executable.
-/// It returns an error if the size of the executable does not match the expected size or if the minimum VM version does not match the current version.
+/// \details This function verifies the format and size of the given PVM executable. Both `PVM_EXE_V1` and `PVM_EXE_V2`
+/// executables are accepted, the format is told by the low bits of the `vm_version` field and the widths by the high
+/// ones, see `PVM_EXE_WIDTHS`.
 ///
 /// \note The size parameter should include the size of the executable header.
 enum pvm_exe_check_result section_pvm_core pvm_exe_check(const pvm_exe_t *exe, const size_t size) {
-	if (exe->size != size - sizeof(exe->vm_version) - sizeof(exe->size) - sizeof(exe->functions_count) - sizeof(exe->constants_count) - sizeof(exe->main_variables_count)) return PVM_EXE_SIZE;
-	if (exe->vm_version != PVM_VERSION) return PVM_EXE_VERSION;
+	if (!size) return PVM_EXE_SIZE;
+	const uint8_t format = exe->vm_version & PVM_EXE_FORMAT;
+	if (format != PVM_EXE_V1 && format != PVM_EXE_V2) return PVM_EXE_VERSION;
+	// the constants section and the values are laid out for the widths the executable is compiled for
+	if ((exe->vm_version & ~PVM_EXE_FORMAT) != PVM_EXE_WIDTHS) return PVM_EXE_VERSION;
+	const size_t header = pvm_exe_header_size(exe);
+	if (size < header || pvm_exe_size(exe) != size - header) return PVM_EXE_SIZE;
+	// the function and constant tables must leave room for the code
+	const size_t tables = pvm_functions_count(exe) * sizeof(pvm_function_t) + pvm_constants_count(exe) * sizeof(pvm_const_t);
+	if (tables > pvm_exe_size(exe)) return PVM_EXE_SIZE;
+	// the code is addressed by pvm_address_t in either format
+	if (pvm_exe_size(exe) - tables > (pvm_address_t)-1) return PVM_EXE_SIZE;
 	return PVM_EXE_OK;
 }
 
+/// \brief Loads a PVM executable into an image locating its sections.
+///
+/// \param[out] image The image to initialize.
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first and outlive the image.
+///
+/// \details The image refers to the executable rather than copying it, so executables mapped in place stay there.
+void section_pvm_core pvm_image_init(pvm_image_t *image, const pvm_exe_t *exe) {
+	image->exe = exe;
+	image->functions = pvm_functions(exe);
+	image->constants = pvm_constants(exe);
+	image->code = pvm_code(exe);
+	image->code_size = pvm_code_size(exe);
+	image->functions_count = pvm_functions_count(exe);
+	image->constants_count = pvm_constants_count(exe);
+	image->main_variables_count = pvm_main_variables_count(exe);
+}
+
 /// \brief Resets the PVM instance to its initial state.
 ///
 /// \param[in,out] vm The PVM instance to reset.
@@ -161,392 +302,926 @@ enum pvm_exe_check_result section_pvm_core pvm_exe_check(const pvm_exe_t *exe, c
 /// After resetting, the data stack top is set to the number of main variables defined in the executable.
 ///
 /// \note This function does not modify the executable or the persistent data.
+///
+/// \note With `PVM_ARENA` the instance must be initialized by `pvm_init()` first, the stacks are kept.
 void section_pvm_core pvm_reset(pvm_t *vm) {
-	for (int i = 0; i < sizeof(pvm_t) - sizeof(vm->persist); ++i) {
+	#ifdef PVM_ARENA
+	// the stacks in the arena stay assigned, only their contents are cleared
+	const size_t runtime_size = offsetof(pvm_t, data_stack);
+	for (pvm_data_stack_t i = 0; i < vm->data_size; ++i) {
+		vm->data_stack[i] = 0;
+	}
+	#else
+	const size_t runtime_size = offsetof(pvm_t, persist);
+	#endif
+	#ifdef PVM_NATURAL_LAYOUT
+	// the aligned runtime data is cleared word-wide
+	memset(vm, 0, runtime_size);
+	#else
+	for (size_t i = 0; i < runtime_size; ++i) {
 		((uint8_t *)vm)[i] = 0;
 	}
-	vm->data_top = vm->persist.exe->main_variables_count;
+	#endif
+	vm->data_top = vm->persist.image->main_variables_count;
 }
 
-/// \brief Executes the next instruction in the PVM.
+#ifdef PVM_ARENA
+/// \brief Tells the size of the stacks of an instance running a verified executable.
+static section_pvm_core void pvm_arena_stacks(const pvm_verify_t *verify, pvm_data_stack_t *data_size, pvm_call_stack_t *call_size) {
+	*data_size = !verify || verify->stack_depth > PVM_DATA_STACK_SIZE ? PVM_DATA_STACK_SIZE : verify->stack_depth;
+	*call_size = !verify || verify->call_depth > PVM_CALL_STACK_SIZE ? PVM_CALL_STACK_SIZE : verify->call_depth;
+}
+
+/// \brief Calculates the size of the arena holding the stacks of a PVM instance.
+///
+/// \param[in] verify The results of `pvm_exe_verify()` for the executable the instance runs, or NULL for the stacks of
+/// `PVM_DATA_STACK_SIZE` values and `PVM_CALL_STACK_SIZE` frames.
+///
+/// \return The size of the arena in bytes, including the room to align the stacks wherever the arena starts.
+///
+/// \details Arenas of many instances may be laid out back to back, every one taking this size.
+size_t section_pvm_core pvm_arena_size(const pvm_verify_t *verify) {
+	pvm_data_stack_t data_size;
+	pvm_call_stack_t call_size;
+	pvm_arena_stacks(verify, &data_size, &call_size);
+	return data_size * sizeof(pvm_data_t) + _Alignof(pvm_data_t) - 1 + call_size * sizeof(struct pvm_call_stack) + _Alignof(struct pvm_call_stack) - 1;
+}
+
+/// \brief Initializes a PVM instance carving its stacks from an arena.
+///
+/// \param[out] vm The PVM instance, its persistent data other than the image is kept.
+/// \param[in] image The executable image the instance runs.
+/// \param[in] verify The results of `pvm_exe_verify()` for the executable, or NULL for the stacks of the maximum sizes.
+/// \param[in] arena The memory holding the stacks for the life of the instance.
+/// \param[in] arena_size The size of the arena in bytes, see `pvm_arena_size()`.
+///
+/// \return PVM_NO_ERROR if the instance is initialized and reset, PVM_DATA_STACK_OVERFLOW or PVM_CALL_STACK_OVERFLOW
+/// if the arena cannot hold the stacks.
+///
+/// \details The verifier proves the deepest data and call stacks main() reaches, so every instance reserves what its
+/// executable needs rather than the worst case of all of them. Both sizes are capped by `PVM_DATA_STACK_SIZE` and
+/// `PVM_CALL_STACK_SIZE`, which bound the verification as well.
+pvm_errno_t section_pvm_core pvm_init(pvm_t *vm, const pvm_image_t *image, const pvm_verify_t *verify, void *arena, size_t arena_size) {
+	pvm_data_stack_t data_size;
+	pvm_call_stack_t call_size;
+	pvm_arena_stacks(verify, &data_size, &call_size);
+	// the data stack comes first, the call stack follows it, each one aligned for its type
+	const uintptr_t start = (uintptr_t)arena, end = start + arena_size;
+	const uintptr_t data = (start + _Alignof(pvm_data_t) - 1) & ~(uintptr_t)(_Alignof(pvm_data_t) - 1);
+	if (data > end || (end - data) / sizeof(pvm_data_t) < data_size) return PVM_DATA_STACK_OVERFLOW;
+	const uintptr_t data_end = data + data_size * sizeof(pvm_data_t);
+	const uintptr_t call = (data_end + _Alignof(struct pvm_call_stack) - 1) & ~(uintptr_t)(_Alignof(struct pvm_call_stack) - 1);
+	if (call > end || (end - call) / sizeof(struct pvm_call_stack) < call_size) return PVM_CALL_STACK_OVERFLOW;
+	vm->data_stack = (pvm_data_t *)data;
+	vm->call_stack = (struct pvm_call_stack *)call;
+	vm->data_size = data_size;
+	vm->call_size = call_size;
+	vm->persist.image = image;
+	pvm_reset(vm);
+	return PVM_NO_ERROR;
+}
+#endif
+
+/// \brief Suspends the PVM instance from within a built-in function until an event completes the call.
+///
+/// \param[in,out] vm The PVM instance running the built-in function.
+///
+/// \details The built-in function returns at once, the PVM stops after the call and stays suspended by `pvm_run()`
+/// until the host calls `pvm_complete()` with the results of the call. Unlike polling with `SLP`, the waiting instance
+/// costs nothing until then, the scheduler parks it out of its queues.
+void section_pvm_core pvm_wait(pvm_t *vm) {
+	// the number of returns is added once the built-in function returns, see pvm_call_function()
+	vm->waiting = PVM_WAITING;
+}
+
+/// \brief Completes the call of the built-in function the PVM instance waits for.
+///
+/// \param[in,out] vm The waiting PVM instance.
+/// \param[in] results The values the built-in function returns, NULL to keep those it has stored itself.
+/// \param[in] count The number of the values, at most the number of returns of the function is taken.
+///
+/// \details The results replace the return values on the data stack the way the built-in function would have stored
+/// them into its arguments. The instance continues with the next `pvm_run()`, a scheduled one should also be given back
+/// by `pvm_scheduler_resume()`. Instances which do not wait are left intact.
+void section_pvm_core pvm_complete(pvm_t *vm, const pvm_data_t results[], pvm_data_stack_t count) {
+	if (!vm->waiting) return;
+	const pvm_data_stack_t returns = vm->waiting & ~PVM_WAITING;
+	// the return values are on the top of the data stack since the call
+	if (results && vm->data_top >= returns && vm->data_top <= pvm_data_stack_size(vm)) {
+		if (count > returns) count = returns;
+		for (pvm_data_stack_t i = 0; i < count; ++i) {
+			vm->data_stack[vm->data_top - returns + i] = results[i];
+		}
+	}
+	vm->waiting = 0;
+}
+
+/// \brief Writes the cached registers of the running engine back to the PVM instance.
+#define pvm_spill(vm) ((vm)->pc = pc, (vm)->data_top = top)
+
+/// \brief Reloads the cached registers of the running engine from the PVM instance.
+///
+/// \details The registers are only passed by value to the helpers, so the compiler may keep them out of memory.
+#define pvm_fill(vm) (pc = (vm)->pc, top = (vm)->data_top)
+
+/// \brief Moves the PVM instance to the image published by its swap at a safe point of the running engine.
+///
+/// \details The engine leaves right after, as its cached code belongs to the previous image, see pvm_swap_due().
+#define pvm_swap_spill(vm) (pvm_spill(vm), pvm_swap_take(vm), pvm_fill(vm))
+
+#ifndef PVM_DISPATCH_THREADED
+
+/// \brief Executes instructions in the PVM while the budget lasts.
 ///
 /// \param[in,out] vm The PVM instance.
+/// \param[in,out] budget The maximum number of instructions to execute, receives the unspent part of it.
 ///
-/// \return PVM_NO_ERROR if the instruction was executed successfully, otherwise an error code.
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
 ///
-/// \details This function fetches and executes the next instruction from the PVM's program counter.
-/// It handles various operations including arithmetic, logical, stack, and control flow instructions.
-/// The function also manages the PVM's data stack and call stack.
-pvm_errno_t section_pvm_core pvm_op(pvm_t *vm) {
-	register pvm_errno_t errno;
+/// \details This function fetches and executes instructions from the PVM's program counter in a single dispatch loop.
+/// The program counter, the code pointer and the data stack top are kept in locals for the whole run and written back
+/// into the instance upon return. The run stops early when an error occurs or an `SLP` instruction puts the PVM asleep.
+pvm_errno_t section_pvm_core pvm_run_budget(pvm_t *vm, uint32_t *const budget) {
+	register pvm_errno_t errno = PVM_NO_ERROR;
 	int32_t value;
 
+	// a suspended built-in function has not completed yet
+	if (vm->waiting) return PVM_NO_ERROR;
 	// check SLP timeout
 	if (vm->timer) {
-		const uint32_t d = now_ms() - vm->timer;
+		const uint32_t d = pvm_now(vm) - vm->timer;
 		if (d < vm->timeout) return PVM_NO_ERROR;
 		vm->timer = 0;
 	}
 
-	// check pc
-	if (vm->pc >= pvm_code_size(vm->persist.exe)) return PVM_PC_OVERRUN;
-
-	p_begin(vm);
-
-	// fetch next instruction
-	const pvm_op_t op = pvm_code(vm->persist.exe)[vm->pc++];
-
-	// process instruction
-	if (op & 0x80) {
-		int32_t param;
-		if (op & 0x40) {
-			param = op & PVM_INTEGRAL_OP_MASK;
-			// check for parameter overflow
-			if (param == PVM_INTEGRAL_OP_MASK) {
-				// get parameter from stack when overflowed
-				if ((errno = pvm_data_stack_pop(vm, &param))) return errno;
-				// complete positive values
-				if (param > 0) {
-					param += PVM_INTEGRAL_OP_MASK;
-				}
-			}
-			if (op & 0x20) {
-				uint_fast8_t stack_size;
-				const int function = pvm_current_function(vm);
-				if (function < 0) {
-					stack_size = vm->persist.exe->main_variables_count;
-				}
-				else {
-					if ((errno = pvm_validate_function_index(vm, function))) return errno;
-					const pvm_function_t *const pvm_function = &vm->persist.exe->functions[function];
-					stack_size = pvm_function->arguments_count + pvm_function->variables_count;
+	// decode executable header once per run
+	const pvm_op_t *const code = vm->persist.image->code;
+	const size_t code_size = vm->persist.image->code_size;
+	pvm_address_t pc = vm->pc;
+	pvm_data_stack_t top = vm->data_top;
+	uint32_t left = *budget;
+
+	while (left) {
+		--left;
+		// check pc
+		if (pc >= code_size) {
+			errno = PVM_PC_OVERRUN;
+			break;
+		}
+
+		#ifdef PVM_DEBUG
+		pvm_spill(vm);
+		#endif
+		p_begin(vm);
+		pvm_profile_op(vm, pc);
+		pvm_trace_op(vm, pc, top ? vm->data_stack[top - 1] : 0);
+
+		// fetch next instruction
+		const pvm_op_t op = code[pc++];
+		pvm_spend_op(left, op);
+
+		// process instruction
+		if (op & 0x80) {
+			int32_t param;
+			if (op & 0x40) {
+				param = op & PVM_INTEGRAL_OP_MASK;
+				// check for parameter overflow
+				if (param == PVM_INTEGRAL_OP_MASK) {
+					// get parameter from stack when overflowed
+					if ((errno = pvm_data_stack_pop(vm, &top, &param))) break;
+					// complete positive values
+					if (param > 0) {
+						param += PVM_INTEGRAL_OP_MASK;
+					}
 				}
-				if (param < 0 || param >= stack_size) return PVM_NO_VARIABLE;
-				if ((param += pvm_current_variables_start(vm)) >= PVM_DATA_STACK_SIZE) return PVM_VAR_OUT_OF_STACK;
-				if (op & 0x10) {
-					// STV	1	1	1	1
-					if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-					p_stv(param, value);
-					vm->data_stack[param] = value;
+				if (op & 0x20) {
+					if ((errno = pvm_variable(vm, &param))) break;
+					if (op & 0x10) {
+						// STV	1	1	1	1
+						if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+						p_stv(param, value);
+						vm->data_stack[param] = value;
+					}
+					else {
+						// LDV	1	1	1	0
+						p_ld("LDV", param, vm->data_stack[param]);
+						if ((errno = pvm_data_stack_push(vm, &top, vm->data_stack[param]))) break;
+					}
 				}
 				else {
-					// LDV	1	1	1	0
-					p_ld("LDV", param, vm->data_stack[param]);
-					if ((errno = pvm_data_stack_push(vm, vm->data_stack[param]))) return errno;
-				}
-			}
-			else {
-				if (op & 0x10) {
-					// CAL	1	1	0	1
-					if ((errno = pvm_validate_function_index(vm, param))) return errno;
-					if (vm->call_top >= PVM_CALL_STACK_SIZE) return PVM_CALL_STACK_OVERFLOW;
-					const pvm_function_t *const fun = &vm->persist.exe->functions[param];
-					// get function arguments size
-					size_t args_size = fun->arguments_count;
-					// for variadic functions, get number of variadic arguments from the stack
-					if (fun->is_variadic) {
-						pvm_data_t variadic_size;
-						if ((errno = pvm_data_stack_pop(vm, &variadic_size))) return errno;
-						if (variadic_size < 0 || (args_size += variadic_size) > 0xFF) return PVM_VARIADIC_SIZE;
-					}
-					p_cal(fun, args_size);
-					// check if all arguments are in the stack
-					if (vm->data_top < args_size) return PVM_ARG_OUT_OF_STACK;
-					// arguments are already pushed into the stack, check for stack overflow upon function call
-					const pvm_data_stack_t stack_rest = PVM_DATA_STACK_SIZE - vm->data_top;
-					if (stack_rest < fun->variables_count) return PVM_VAR_OUT_OF_STACK;
-					if (stack_rest < fun->returns_count) return PVM_RETURN_OUT_OF_STACK;
-					// calculate function stack start
-					const pvm_data_stack_t call_stack_start = vm->data_top - args_size;
-					// call the function
-					const pvm_address_t address = fun->address;
-					if (fun->is_built_in) {
-						if (address >= pvm_builtins_size) return PVM_BUILTIN_NO_FUNCTION;
-						// for built-in functions, parameters and return values occupy common space
-						pvm_builtins[address].func(vm, vm->data_stack + call_stack_start, args_size);
-						// as no RET instruction was executed, emulate it setting the stack pointer to the number of returns
-						vm->data_top = call_stack_start + fun->returns_count;
+					if (op & 0x10) {
+						// CAL	1	1	0	1
+						pvm_spill(vm);
+						errno = pvm_call(vm, param);
+						pvm_fill(vm);
+						pvm_spend_charge(vm, left);
+						if (errno) break;
 					}
 					else {
-						struct pvm_call_stack *call = &vm->call_stack[vm->call_top++];
-						call->function_index = param;
-						call->variables_start = call_stack_start;
-						call->arguments_count = args_size;
-						// initialize local variables with zeros and set proper stack top at once
-						for (int i = 0; i < fun->variables_count; ++i) {
-							if ((errno = pvm_data_stack_push(vm, 0))) return errno;
+						p_s("JMP");
+						// JMP	1	1	0	0
+						jump:
+						if (param < 0) param -= 2;
+						pc += param + 1;
+						p_pc(pc);
+						// a backward jump within main() is a safe point to swap the image
+						if (param < 0 && pvm_swap_due(vm, top)) {
+							pvm_swap_spill(vm);
+							break;
 						}
-						call->return_address = vm->pc;
-						vm->pc = address;
 					}
 				}
-				else {
-					p_s("JMP");
-					// JMP	1	1	0	0
-					jump:
-					if (param < 0) param -= 2;
-					vm->pc += param + 1;
-					p_pc(vm->pc);
-				}
 			}
-		}
-		else {
-			if (op & 0x20) {
-				if (op & 0x10) {
-					if (op & 0x08) {
-						// NEG, INV, INC, DEC, POP
-						if (op & 0x04) {
-							p_pop(op & 3);
-							// POP
-							for (int i = (op & 3) + 1; i; i--) {
-								if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-							}
-						}
-						else {
-							// NEG, INV, INC, DEC
-							if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-							if (op & 0x02) {
-								if (op & 0x01) {
-									p_s("DEC");
-									// DEC
-									--value;
-								}
-								else {
-									p_s("INC");
-									// INC
-									++value;
+			else {
+				if (op & 0x20) {
+					if (op & 0x10) {
+						if (op & 0x08) {
+							// NEG, INV, INC, DEC, POP
+							if (op & 0x04) {
+								p_pop(op & 3);
+								// POP
+								for (int i = (op & 3) + 1; i; i--) {
+									if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
 								}
+								if (errno) break;
 							}
 							else {
-								if (op & 0x01) {
-									p_s("INV");
-									// INV
-									value = ~value;
+								// NEG, INV, INC, DEC
+								if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+								if (op & 0x02) {
+									if (op & 0x01) {
+										p_s("DEC");
+										// DEC
+										--value;
+									}
+									else {
+										p_s("INC");
+										// INC
+										++value;
+									}
 								}
 								else {
-									p_s("NEG");
-									// NEG
-									value = -value;
+									if (op & 0x01) {
+										p_s("INV");
+										// INV
+										value = ~value;
+									}
+									else {
+										p_s("NEG");
+										// NEG
+										value = -value;
+									}
 								}
+								goto push_value;
 							}
-							goto push_value;
 						}
-					}
-					else {
-						// SKZ, SNZ, SKN, SNN, SLP, RET, LDC, JMB
-						if (op & 0x04) {
-							// SLP, RET, LDC, JMB
-							if (op & 0x02) {
-								//  LDC, JMB
-								if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-								if (op & 0x01) {
-									p_s("JMB");
-									// JMB is the same as NEG followed JMP
-									param = -value;
-									goto jump;
+						else {
+							// SKZ, SNZ, SKN, SNN, SLP, RET, LDC, JMB
+							if (op & 0x04) {
+								// SLP, RET, LDC, JMB
+								if (op & 0x02) {
+									//  LDC, JMB
+									if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+									if (op & 0x01) {
+										p_s("JMB");
+										// JMB is the same as NEG followed JMP
+										param = -value;
+										goto jump;
+									}
+									// LDC
+									if ((errno = pvm_constant(vm, &value))) break;
+									goto push_value;
 								}
-								// LDC
-								if (value < 0 || value >= vm->persist.exe->constants_count) return PVM_NO_CONSTANT;
-								p_ld("LDC", value, pvm_constants(vm->persist.exe)[value]);
-								value = pvm_constants(vm->persist.exe)[value];
-								// expand sign for shorter stack types
-								#if PVM_CONST_SIGN > 0x80000000
-								if (value & PVM_CONST_SIGN) {
-									value |= (int32_t)PVM_CONST_SIGN;
+								// SLP, RET
+								if (op & 0x01) {
+									// RET
+									p_s("RET");
+									pvm_spill(vm);
+									errno = pvm_return(vm);
+									pvm_fill(vm);
+									pvm_spend_charge(vm, left);
+									if (errno) break;
+									// so is a return into main()
+									if (pvm_swap_due(vm, top)) {
+										pvm_swap_spill(vm);
+										break;
+									}
 								}
-								#endif
-								goto push_value;
-							}
-							// SLP, RET
-							if (op & 0x01) {
-								// RET
-								p_s("RET");
-								int function = pvm_current_function(vm);
-								if (pvm_validate_function_index(vm, function)) return PVM_MAIN_RETURN;
-								// cleanup stack
-								pvm_data_stack_t stack_start = pvm_current_variables_start(vm);
-								const pvm_function_t *const fun = &vm->persist.exe->functions[function];
-								uint8_t returns_size = fun->returns_count;
-								pvm_data_stack_t returns_start = vm->data_top - returns_size;
-								// no need to check vm->call_top < 0 as pvm_current_function() already checked it
-								struct pvm_call_stack *const call = &vm->call_stack[--vm->call_top];
-								// check for smashed stack
-								if (stack_start + call->arguments_count + fun->variables_count != returns_start) return PVM_DATA_STACK_SMASHED;
-								// move return values to the beginning of the function stack
-								while (returns_size--) {
-									vm->data_stack[stack_start++] = vm->data_stack[returns_start++];
+								else {
+									// SLP
+									// pseudo function with one parameter
+									if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+									vm->timer = pvm_now(vm);
+									vm->timeout = value;
+									p_slp(value);
 								}
-								vm->data_top = stack_start;
-								// stack is guaranteed not to be empty by the 'function < 0' check
-								vm->pc = call->return_address;
-								p_ret(vm->pc, fun, call->arguments_count);
 							}
 							else {
-								// SLP
-								// pseudo function with one parameter
-								if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-								vm->timer = now_ms();
-								vm->timeout = value;
-								p_slp(value);
+								// SKZ, SNZ, SKN, SNN
+								if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+								p_s("SK*");
+								if (pvm_skip(op, value)) {
+									++pc;
+									p_pc(pc);
+								}
 							}
 						}
-						else {
-							// SKZ, SNZ, SKN, SNN
-						}
 					}
-				}
-				else {
-					int32_t second;
-					uint_fast8_t branch = 0;
-					if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-					if ((errno = pvm_data_stack_pop(vm, &second))) return errno;
-					if (op & 0x08) {
-						// ADD, SUB, MUL, DIV, PWR, AND, IOR, XOR
-						if (op & 0x04) {
-							// PWR, AND, IOR, XOR
-							if (op & 0x02) {
-								// IOR, XOR
-								if (op & 0x01) {
-									p_s("XOR");
-									// XOR
-									value ^= second;
+					else {
+						int32_t second;
+						uint_fast8_t branch = 0;
+						if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+						if ((errno = pvm_data_stack_pop(vm, &top, &second))) break;
+						if (op & 0x08) {
+							// ADD, SUB, MUL, DIV, PWR, AND, IOR, XOR
+							if (op & 0x04) {
+								// PWR, AND, IOR, XOR
+								if (op & 0x02) {
+									// IOR, XOR
+									if (op & 0x01) {
+										p_s("XOR");
+										// XOR
+										value ^= second;
+									}
+									else {
+										p_s("IOR");
+										// IOR
+										value |= second;
+									}
 								}
 								else {
-									p_s("IOR");
-									// IOR
-									value |= second;
+									// PWR, AND
+									if (op & 0x01) {
+										p_s("AND");
+										// AND
+										value &= second;
+									}
+									else {
+										p_s("PWR");
+										// PWR
+										value = pvm_power(value, second);
+									}
 								}
 							}
 							else {
-								// PWR, AND
-								if (op & 0x01) {
-									p_s("AND");
-									// AND
-									value &= second;
+								// ADD, SUB, MUL, DIV
+								if (op & 0x02) {
+									// MUL, DIV
+									if (op & 0x01) {
+										p_s("DIV");
+										// DIV
+										value /= second;
+									}
+									else {
+										p_s("MUL");
+										// MUL
+										value *= second;
+									}
 								}
 								else {
-									p_s("PWR");
-									// PWR
-									if (second <= 0) {
-										value = 1;
+									// ADD, SUB
+									if (op & 0x01) {
+										p_s("SUB");
+										// SUB
+										value -= second;
 									}
 									else {
-										const int32_t v = value;
-										while (--second) {
-											value *= v;
-										}
+										p_s("ADD");
+										// ADD
+										value += second;
 									}
 								}
 							}
+							goto push_value;
 						}
-						else {
-							// ADD, SUB, MUL, DIV
+						// BZE, BNZ, BEQ, BNE, BGT, BLT, BGE, BLE
+						if ((op & 7) > 1) {
+							// BEQ, BNE, BGT, BLT, BGE, BLE
+							int32_t third;
+							if ((errno = pvm_data_stack_pop(vm, &top, &third))) break;
+							second = pvm_difference(second, third);
+						}
+						if (op & 0x04) {
+							// BGT, BLT, BGE, BLE
 							if (op & 0x02) {
-								// MUL, DIV
+								// BGE, BLE
 								if (op & 0x01) {
-									p_s("DIV");
-									// DIV
-									value /= second;
+									p_s("BLE");
+									// BLE
+									if (second <= 0) branch |= 1;
 								}
 								else {
-									p_s("MUL");
-									// MUL
-									value *= second;
+									p_s("BGE");
+									// BGE
+									if (second >= 0) branch |= 1;
 								}
 							}
 							else {
-								// ADD, SUB
+								// BGT, BLT
 								if (op & 0x01) {
-									p_s("SUB");
-									// SUB
-									value -= second;
+									p_s("BLT");
+									// BLT
+									if (second < 0) branch |= 1;
 								}
 								else {
-									p_s("ADD");
-									// ADD
-									value += second;
+									p_s("BGT");
+									// BGT
+									if (second > 0) branch |= 1;
 								}
 							}
 						}
-						goto push_value;
-					}
-					// BZE, BNZ, BEQ, BNE, BGT, BLT, BGE, BLE
-					if ((op & 7) > 1) {
-						// BEQ, BNE, BGT, BLT, BGE, BLE
-						int32_t third;
-						if ((errno = pvm_data_stack_pop(vm, &third))) return errno;
-						second -= third;
-					}
-					if (op & 0x04) {
-						// BGT, BLT, BGE, BLE
-						if (op & 0x02) {
-							// BGE, BLE
-							if (op & 0x01) {
-								p_s("BLE");
-								// BLE
-								if (second <= 0) branch |= 1;
-							}
-							else {
-								p_s("BGE");
-								// BGE
-								if (second >= 0) branch |= 1;
-							}
-						}
 						else {
-							// BGT, BLT
+							// BZE, BNZ, BEQ, BNE
 							if (op & 0x01) {
-								p_s("BLT");
-								// BLT
-								if (second < 0) branch |= 1;
+								// BNE, BNZ
+								p_s("BN*");
+								if (second) branch |= 1;
 							}
 							else {
-								p_s("BGT");
-								// BGT
-								if (second > 0) branch |= 1;
+								// BEQ, BZE
+								p_s("BZ*");
+								if (second == 0) branch |= 1;
 							}
 						}
-					}
-					else {
-						// BZE, BNZ, BEQ, BNE
-						if (op & 0x01) {
-							// BNE, BNZ
-							p_s("BN*");
-							if (second) branch |= 1;
+						if (branch & 1) {
+							pc += value + 1;
+							p_pc(pc);
+							// and a backward branch
+							if (value < 0 && pvm_swap_due(vm, top)) {
+								pvm_swap_spill(vm);
+								break;
+							}
 						}
 						else {
-							// BEQ, BZE
-							p_s("BZ*");
-							if (second == 0) branch |= 1;
+							p(" x");
 						}
 					}
-					if (branch & 1) {
-						vm->pc += value + 1;
-						p_pc(vm->pc);
+				}
+				else {
+					// PSC
+					p_s("PSC");
+					if ((errno = pvm_data_stack_pop(vm, &top, &value))) break;
+					value <<= 5;
+					value |= op & 0x1F;
+					goto push_value;
+				}
+			}
+		}
+		else {
+			// PSH
+			value = op & 0x7F;
+			// a full stack fails the PSH itself, before the chain is spent
+			if (top >= pvm_data_stack_size(vm)) {
+				errno = PVM_DATA_STACK_OVERFLOW;
+				break;
+			}
+			pvm_fold_psc(vm, code, code_size, pc, value, left);
+			p_psh(value);
+			push_value:
+			if ((errno = pvm_data_stack_push(vm, &top, value))) break;
+		}
+
+		#ifdef PVM_DEBUG
+		pvm_spill(vm);
+		#endif
+		p_end(vm);
+
+		// a sleeping or waiting PVM yields the rest of the budget
+		if (vm->timer || vm->waiting) break;
+	}
+
+	pvm_spill(vm);
+	*budget = left;
+
+	return errno;
+}
+
+#else
+
+// when computed goto is unavailable the handlers are selected by a dense switch the compiler turns into a jump table
+#if defined(__GNUC__) || defined(__clang__)
+#define PVM_COMPUTED_GOTO
+#endif
+
+// repeat a table entry for opcodes sharing a single handler
+#define PVM_R4(x) x, x, x, x
+#define PVM_R16(x) PVM_R4(x), PVM_R4(x), PVM_R4(x), PVM_R4(x)
+#define PVM_R32(x) PVM_R16(x), PVM_R16(x)
+#define PVM_R128(x) PVM_R32(x), PVM_R32(x), PVM_R32(x), PVM_R32(x)
+
+/// \brief Lists the handlers of all 256 opcodes in the order of their encoding.
+#define PVM_OPCODES(h) \
+	PVM_R128(h(PSH)), PVM_R32(h(PSC)), \
+	h(BZE), h(BNZ), h(BEQ), h(BNE), h(BGT), h(BLT), h(BGE), h(BLE), \
+	h(ADD), h(SUB), h(MUL), h(DIV), h(PWR), h(AND), h(IOR), h(XOR), \
+	h(SKZ), h(SNZ), h(SKN), h(SNN), h(SLP), h(RET), h(LDC), h(JMB), \
+	h(NEG), h(INV), h(INC), h(DEC), PVM_R4(h(POP)), \
+	PVM_R16(h(JMP)), PVM_R16(h(CAL)), PVM_R16(h(LDV)), PVM_R16(h(STV))
+
+#ifdef PVM_PREPARE
+/// \brief Lists the handlers of pre-decoded instructions that have no opcode of their own.
+///
+/// \details `_I` handlers take their operand resolved upon preparation: LIT pushes a whole PSH and PSC chain, JMP_I
+/// jumps to its absolute target, JMB_I and branches consume the preceding literal offset. The rest are superinstructions
+/// fused from whole sequences: `_VV_STV` operate on two variables storing the result into a third one, `_VAR` step a
+/// variable in place and `_LV` compare a variable against a literal and branch.
+#define PVM_PREPARED_HANDLERS(h) \
+	h(LIT), h(JMP_I), h(JMB_I), h(CAL_I), h(LDV_I), h(STV_I), h(LDC_I), \
+	h(BZE_I), h(BNZ_I), h(BEQ_I), h(BNE_I), h(BGT_I), h(BLT_I), h(BGE_I), h(BLE_I), \
+	h(ADD_VV_STV), h(SUB_VV_STV), h(INC_VAR), h(DEC_VAR), \
+	h(BEQ_LV), h(BNE_LV), h(BGT_LV), h(BLT_LV), h(BGE_LV), h(BLE_LV),
+#else
+#define PVM_PREPARED_HANDLERS(h)
+#endif
+
+/// \brief Lists every handler of the threaded engine once.
+#define PVM_HANDLERS(h) \
+	h(PSH), h(PSC), h(BZE), h(BNZ), h(BEQ), h(BNE), h(BGT), h(BLT), h(BGE), h(BLE), \
+	h(ADD), h(SUB), h(MUL), h(DIV), h(PWR), h(AND), h(IOR), h(XOR), \
+	h(SKZ), h(SNZ), h(SKN), h(SNN), h(SLP), h(RET), h(LDC), h(JMB), \
+	h(NEG), h(INV), h(INC), h(DEC), h(POP), h(JMP), h(CAL), h(LDV), h(STV), \
+	PVM_PREPARED_HANDLERS(h)
+
+#define pvm_handler_id(name) PVM_HANDLER_##name
+
+/// \brief Enumerates the handlers of the threaded engine.
+enum pvm_handler {
+	PVM_HANDLERS(pvm_handler_id)
+};
+
+#if !defined(PVM_COMPUTED_GOTO) || defined(PVM_PREPARE)
+/// \brief Maps every opcode to the handler of the threaded engine.
+static const uint8_t pvm_handlers[256] = { PVM_OPCODES(pvm_handler_id) };
+#endif
+
+#ifdef PVM_COMPUTED_GOTO
+#define pvm_handler_label(name) &&op_##name
+#define PVM_TARGET(name) op_##name:
+#else
+#define PVM_TARGET(name) case PVM_HANDLER_##name:
+#endif
+
+#ifdef PVM_PREPARE
+/// \brief Fuses `LDV a; LDV b; ADD; STV c` and the same with SUB into a single superinstruction.
+#define PVM_FUSE_ARITHMETIC 0x01
+/// \brief Fuses `PSH n; LDV x; PSH offset` followed by one of BEQ to BLE into a single superinstruction.
+#define PVM_FUSE_COMPARE 0x02
+/// \brief Fuses `LDV i; INC; STV i` and the same with DEC into a single superinstruction.
+#define PVM_FUSE_STEP 0x04
+
+#ifndef PVM_FUSIONS
+/// \brief The bit mask of superinstructions the pre-decoder fuses.
+///
+/// \details All of them are enabled by default as these are the sequences MPC emits most for loops and counters.
+/// Applications that profile a different mix may narrow the mask upon build with `-DPVM_FUSIONS=...`.
+#define PVM_FUSIONS (PVM_FUSE_ARITHMETIC | PVM_FUSE_COMPARE | PVM_FUSE_STEP)
+#endif
+
+/// \brief Represents a pre-decoded instruction of the prepared code.
+///
+/// \details There is exactly one instruction for every byte of the code section, so the program counter indexes both
+/// the code and the prepared instructions. An instruction fused from a sequence of opcodes continues at `next` while
+/// the instructions it covers stay valid for jumps right into the sequence.
+typedef struct pvm_insn {
+	/// \brief The descriptor of the function called by CAL_I.
+	const pvm_function_t *fun;
+	/// \brief The resolved immediate operand: a literal, a variable, a constant value or a function index.
+	int32_t imm;
+	/// \brief The literal LDV_I and `_LV` consume besides the immediate: the variable index and the branch offset.
+	///
+	/// \details Fused literals are still stored into the slots their PSH takes, as variables and built-in functions may
+	/// read those slots later.
+	int32_t literal;
+	/// \brief The address of the instruction that follows this one.
+	pvm_address_t next;
+	/// \brief The absolute target of jumps and branches.
+	pvm_address_t target;
+	/// \brief The variable indices of superinstructions.
+	uint8_t var[3];
+	/// \brief The handler that executes this instruction.
+	uint8_t handler;
+	/// \brief The original opcode at this address.
+	pvm_op_t op;
+	#ifdef PVM_CYCLES
+	/// \brief The cycles of the whole sequence the instruction executes.
+	uint16_t cycles;
+	#endif
+} pvm_insn_t;
+
+#ifdef PVM_CYCLES
+#define pvm_spend_insn(budget, insn) pvm_spend(budget, (insn)->cycles - 1u)
+#else
+#define pvm_spend_insn(budget, insn)
+#endif
+
+/// \brief Represents the prepared code of a PVM executable.
+struct pvm_prepared {
+	/// \brief The executable this code was prepared from.
+	const pvm_exe_t *exe;
+	/// \brief The frame depths of the user functions found by the verifier.
+	const uint8_t *frames;
+	#ifdef PVM_ARENA
+	/// \brief The deepest data stack main() reaches as found by the verifier, instances with smaller arenas run checked.
+	pvm_data_stack_t stack_depth;
+	#endif
+	/// \brief The flag that the executable passed `pvm_exe_verify()` and runs on the unchecked fast path.
+	uint8_t verified;
+	/// \brief The pre-decoded instructions, one for every byte of the code section.
+	pvm_insn_t insn[];
+};
+
+/// \brief Folds a PSH and PSC chain into a literal.
+///
+/// \param[in] code The code section of the executable.
+/// \param[in] code_size The size of the code section.
+/// \param[in] pc The address of the chain.
+/// \param[out] literal The value of the literal.
+///
+/// \return The address following the chain or zero if there is no PSH at the address.
+static pvm_address_t pvm_prepare_literal(const pvm_op_t *code, size_t code_size, pvm_address_t pc, int32_t *literal) {
+	if (pc >= code_size || pvm_handlers[code[pc]] != PVM_HANDLER_PSH) return 0;
+	uint32_t value = code[pc++] & 0x7F;
+	while (pc < code_size && pvm_handlers[code[pc]] == PVM_HANDLER_PSC) {
+		value = value << 5 | (code[pc++] & 0x1F);
+	}
+	// the chain wraps around the width of the data the same way when it is pushed
+	*literal = pvm_data_wrap((int32_t)value);
+	return pc;
+}
+
+/// \brief Decodes a variable access with the immediate operand.
+///
+/// \param[in] code The code section of the executable.
+/// \param[in] code_size The size of the code section.
+/// \param[in] pc The address of the instruction.
+/// \param[in] handler The handler of the access expected, PVM_HANDLER_LDV or PVM_HANDLER_STV.
+///
+/// \return The variable index or -1 if there is no such access at the address.
+static int pvm_prepare_variable(const pvm_op_t *code, size_t code_size, pvm_address_t pc, uint_fast8_t handler) {
+	if (pc >= code_size || pvm_handlers[code[pc]] != handler) return -1;
+	const int index = code[pc] & PVM_INTEGRAL_OP_MASK;
+	return index == PVM_INTEGRAL_OP_MASK ? -1 : index;
+}
+
+/// \brief Decodes a single instruction at the given address of the code section.
+///
+/// \param[in] exe The PVM executable.
+/// \param[in] code The code section of the executable.
+/// \param[in] code_size The size of the code section.
+/// \param[in] pc The address of the instruction.
+/// \param[out] insn The pre-decoded instruction.
+///
+/// \details Literals built by PSH and PSC chains are folded into a single LIT and, when consumed by the very next
+/// jump, branch, LDC or LDV, fused with it. Immediate operands of JMP, CAL, LDV and STV are resolved in place. Sequences
+/// enabled by PVM_FUSIONS are fused into superinstructions first. Everything that cannot be resolved statically keeps
+/// the handler of its opcode.
+static void pvm_prepare_insn(const pvm_exe_t *exe, const pvm_op_t *code, size_t code_size, pvm_address_t pc, pvm_insn_t *insn) {
+	const pvm_op_t op = code[pc];
+	int32_t param = op & PVM_INTEGRAL_OP_MASK;
+	insn->fun = NULL;
+	insn->imm = 0;
+	insn->literal = 0;
+	insn->next = pc + 1;
+	insn->target = 0;
+	insn->var[0] = insn->var[1] = insn->var[2] = 0;
+	insn->handler = pvm_handlers[op];
+	insn->op = op;
+
+	switch (insn->handler) {
+		case PVM_HANDLER_PSH: {
+			// fold the whole chain of complements into a single literal
+			const pvm_address_t next = pvm_prepare_literal(code, code_size, pc, &insn->imm);
+			insn->handler = PVM_HANDLER_LIT;
+			insn->next = next;
+			if (next >= code_size) break;
+			if (PVM_FUSIONS & PVM_FUSE_COMPARE) {
+				// PSH n; LDV x; PSH offset; B**
+				int32_t offset;
+				const int var = pvm_prepare_variable(code, code_size, next, PVM_HANDLER_LDV);
+				const pvm_address_t branch = var < 0 ? 0 : pvm_prepare_literal(code, code_size, next + 1, &offset);
+				if (branch && branch < code_size && code[branch] >= PVM_OP_BEQ && code[branch] <= PVM_OP_BLE) {
+					insn->handler = PVM_HANDLER_BEQ_LV + (code[branch] - PVM_OP_BEQ);
+					insn->var[0] = var;
+					insn->literal = offset;
+					insn->target = branch + 1 + offset + 1;
+					insn->next = branch + 1;
+					break;
+				}
+			}
+			// fuse with an instruction consuming the literal
+			const pvm_op_t consumer = code[next];
+			const pvm_address_t after = next + 1;
+			switch (pvm_handlers[consumer]) {
+				case PVM_HANDLER_BZE:
+				case PVM_HANDLER_BNZ:
+				case PVM_HANDLER_BEQ:
+				case PVM_HANDLER_BNE:
+				case PVM_HANDLER_BGT:
+				case PVM_HANDLER_BLT:
+				case PVM_HANDLER_BGE:
+				case PVM_HANDLER_BLE:
+					insn->handler = PVM_HANDLER_BZE_I + (consumer & 7);
+					insn->target = after + insn->imm + 1;
+					insn->next = after;
+					break;
+				case PVM_HANDLER_JMB:
+				case PVM_HANDLER_JMP:
+					if (pvm_handlers[consumer] == PVM_HANDLER_JMB) {
+						param = -insn->imm;
 					}
 					else {
-						p(" x");
+						if ((consumer & PVM_INTEGRAL_OP_MASK) != PVM_INTEGRAL_OP_MASK) break;
+						param = insn->imm;
+						if (param > 0) param += PVM_INTEGRAL_OP_MASK;
 					}
+					if (param < 0) param -= 2;
+					insn->handler = PVM_HANDLER_JMB_I;
+					insn->target = after + param + 1;
+					insn->next = after;
+					break;
+				case PVM_HANDLER_LDC:
+					if (insn->imm < 0 || (uint32_t)insn->imm >= pvm_constants_count(exe)) break;
+					insn->handler = PVM_HANDLER_LDC_I;
+					insn->imm = pvm_constant_at(pvm_constants(exe), insn->imm);
+					insn->next = after;
+					break;
+				case PVM_HANDLER_LDV:
+					if ((consumer & PVM_INTEGRAL_OP_MASK) != PVM_INTEGRAL_OP_MASK) break;
+					insn->handler = PVM_HANDLER_LDV_I;
+					insn->literal = insn->imm;
+					if (insn->imm > 0) insn->imm += PVM_INTEGRAL_OP_MASK;
+					insn->next = after;
+					break;
+				default:
+					break;
+			}
+			break;
+		}
+		case PVM_HANDLER_JMP:
+			if (param == PVM_INTEGRAL_OP_MASK) break;
+			insn->handler = PVM_HANDLER_JMP_I;
+			insn->target = pc + 1 + param + 1;
+			break;
+		case PVM_HANDLER_CAL:
+			if (param == PVM_INTEGRAL_OP_MASK || (uint32_t)param >= pvm_functions_count(exe)) break;
+			insn->handler = PVM_HANDLER_CAL_I;
+			insn->imm = param;
+			insn->fun = &pvm_functions(exe)[param];
+			break;
+		case PVM_HANDLER_LDV:
+			if (param == PVM_INTEGRAL_OP_MASK) break;
+			if (PVM_FUSIONS & PVM_FUSE_ARITHMETIC) {
+				// LDV a; LDV b; ADD or SUB; STV c
+				const int var = pvm_prepare_variable(code, code_size, pc + 1, PVM_HANDLER_LDV);
+				const int result = pvm_prepare_variable(code, code_size, pc + 3, PVM_HANDLER_STV);
+				if (var >= 0 && result >= 0 && (code[pc + 2] == PVM_OP_ADD || code[pc + 2] == PVM_OP_SUB)) {
+					insn->handler = code[pc + 2] == PVM_OP_ADD ? PVM_HANDLER_ADD_VV_STV : PVM_HANDLER_SUB_VV_STV;
+					insn->var[0] = param;
+					insn->var[1] = var;
+					insn->var[2] = result;
+					insn->next = pc + 4;
+					break;
 				}
 			}
-			else {
-				// PSC
-				p_s("PSC");
-				if ((errno = pvm_data_stack_pop(vm, &value))) return errno;
-				value <<= 5;
-				value |= op & 0x1F;
-				goto push_value;
+			if (PVM_FUSIONS & PVM_FUSE_STEP) {
+				// LDV i; INC or DEC; STV i
+				if (pc + 1u < code_size && (code[pc + 1] == PVM_OP_INC || code[pc + 1] == PVM_OP_DEC) && pvm_prepare_variable(code, code_size, pc + 2, PVM_HANDLER_STV) == param) {
+					insn->handler = code[pc + 1] == PVM_OP_INC ? PVM_HANDLER_INC_VAR : PVM_HANDLER_DEC_VAR;
+					insn->var[0] = param;
+					insn->next = pc + 3;
+					break;
+				}
 			}
-		}
+			// fall through
+		case PVM_HANDLER_STV:
+			if (param == PVM_INTEGRAL_OP_MASK) break;
+			insn->handler = insn->handler == PVM_HANDLER_LDV ? PVM_HANDLER_LDV_I : PVM_HANDLER_STV_I;
+			insn->imm = param;
+			break;
+		default:
+			break;
 	}
-	else {
-		// PSH
-		value = op & 0x7F;
-		p_psh(value);
-		push_value:
-		if ((errno = pvm_data_stack_push(vm, value))) return errno;
+
+	#ifdef PVM_CYCLES
+	// a fused instruction spends the same cycles as its sequence does unfused
+	uint32_t cycles = 0;
+	for (size_t i = pc; i < insn->next; ++i) {
+		cycles += pvm_op_cycles(code[i]);
 	}
+	insn->cycles = cycles > UINT16_MAX ? UINT16_MAX : (uint16_t)cycles;
+	#endif
+}
 
-	p_end(vm);
+/// \brief Calculates the size of the arena needed to prepare a PVM executable.
+///
+/// \param[in] exe The PVM executable to prepare.
+///
+/// \return The size of the arena in bytes.
+///
+/// \note The size includes the room to align the arena, so an arena of any alignment may be passed to `pvm_prepare()`.
+size_t pvm_prepare_size(const pvm_exe_t *exe) {
+	// reserve room to align the arena, the frame depths and the scratch of the verifier follow the instructions
+	return sizeof(struct pvm_prepared) + pvm_code_size(exe) * sizeof(pvm_insn_t) + sizeof(void *) - 1 + pvm_functions_count(exe) + pvm_exe_verify_size(exe);
+}
 
-	return 0;
+/// \brief Translates the code section of a PVM executable into the pre-decoded instructions.
+///
+/// \param[in] exe The PVM executable to prepare, it should pass `pvm_exe_check()` first.
+/// \param[out] arena The memory to hold the prepared code.
+/// \param[in] arena_size The size of the arena in bytes.
+///
+/// \return A pointer to the prepared code within the arena or NULL if the arena is too small.
+///
+/// \details Every instruction of the code section is decoded once into a pre-decoded instruction at the same address.
+/// The executable is verified as well and, when it passes, the prepared code runs on the unchecked fast path.
+const pvm_prepared_t *pvm_prepare(const pvm_exe_t *exe, void *arena, size_t arena_size) {
+	if (arena_size < pvm_prepare_size(exe)) return NULL;
+	struct pvm_prepared *prepared = (struct pvm_prepared *)(((uintptr_t)arena + sizeof(void *) - 1) & ~(uintptr_t)(sizeof(void *) - 1));
+	const pvm_op_t *const code = pvm_code(exe);
+	const size_t code_size = pvm_code_size(exe);
+	prepared->exe = exe;
+	for (size_t pc = 0; pc < code_size; ++pc) {
+		pvm_prepare_insn(exe, code, code_size, pc, &prepared->insn[pc]);
+	}
+	// the verifier takes the rest of the arena as its scratch
+	uint8_t *const frames = (uint8_t *)&prepared->insn[code_size];
+	uint8_t *const scratch = frames + pvm_functions_count(exe);
+	pvm_verify_t verify = { .frames = frames };
+	prepared->frames = frames;
+	prepared->verified = pvm_exe_verify(exe, scratch, arena_size - (scratch - (uint8_t *)arena), &verify) == PVM_EXE_OK;
+	#ifdef PVM_ARENA
+	prepared->stack_depth = verify.stack_depth > PVM_DATA_STACK_SIZE ? PVM_DATA_STACK_SIZE : verify.stack_depth;
+	#endif
+	return prepared;
+}
+#endif
+
+#define PVM_ENGINE pvm_run_checked
+#include "pvm_engine.h"
+
+#ifdef PVM_PREPARE
+#define PVM_ENGINE pvm_run_verified
+#define PVM_VERIFIED
+#include "pvm_engine.h"
+#endif
+
+/// \brief Executes instructions in the PVM while the budget lasts.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in,out] budget The maximum number of instructions to execute, receives the unspent part of it.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details This is the threaded engine replacing the bit-tree decoder on hosts. Prepared code of a verified executable
+/// runs on the variant of the engine without the checks the verifier has proven, anything else runs fully checked.
+pvm_errno_t section_pvm_core pvm_run_budget(pvm_t *vm, uint32_t *const budget) {
+	// a suspended built-in function has not completed yet
+	if (vm->waiting) return PVM_NO_ERROR;
+	// check SLP timeout
+	if (vm->timer) {
+		const uint32_t d = pvm_now(vm) - vm->timer;
+		if (d < vm->timeout) return PVM_NO_ERROR;
+		vm->timer = 0;
+	}
+	#ifdef PVM_PREPARE
+	const pvm_prepared_t *const prepared = vm->persist.prepared;
+	#ifdef PVM_ARENA
+	// the pushes of the verified engine go unchecked, so the stack must hold the deepest one
+	if (prepared && prepared->exe == vm->persist.image->exe && prepared->verified && prepared->stack_depth <= vm->data_size) return pvm_run_verified(vm, budget);
+	#else
+	if (prepared && prepared->exe == vm->persist.image->exe && prepared->verified) return pvm_run_verified(vm, budget);
+	#endif
+	#endif
+	return pvm_run_checked(vm, budget);
+}
+
+#endif
+
+/// \brief Executes up to a given number of instructions in the PVM.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] budget The maximum number of instructions to execute.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details This function fetches and executes instructions from the PVM's program counter in a single dispatch loop,
+/// see pvm_run_budget().
+///
+/// \note With `PVM_CYCLES` the budget is counted in cycles. An instruction starts while any cycle is left, so a run
+/// overruns its budget by less than the cycles of the last instruction and the charges of a built-in function it calls.
+pvm_errno_t section_pvm_core pvm_run(pvm_t *vm, uint32_t budget) {
+	return pvm_run_budget(vm, &budget);
+}
+
+/// \brief Executes the next instruction in the PVM.
+///
+/// \param[in,out] vm The PVM instance.
+///
+/// \return PVM_NO_ERROR if the instruction was executed successfully, otherwise an error code.
+///
+/// \details This function fetches and executes the next instruction from the PVM's program counter.
+/// It handles various operations including arithmetic, logical, stack, and control flow instructions.
+/// The function also manages the PVM's data stack and call stack.
+pvm_errno_t section_pvm_core pvm_op(pvm_t *vm) {
+	return pvm_run(vm, 1);
 }
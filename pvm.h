@@ -4,7 +4,12 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define PVM_VERSION 1
+#define PVM_VERSION 2
+
+/// \brief The executable format with 8-bit counts and a 16-bit size, see `pvm_exe_t`.
+#define PVM_EXE_V1 1
+/// \brief The executable format with 16-bit counts and a 32-bit size, see `pvm_exe_v2_t`.
+#define PVM_EXE_V2 2
 
 #ifndef PVM_DATA_STACK_SIZE
 #define PVM_DATA_STACK_SIZE 30
@@ -24,6 +29,16 @@
 #endif
 #endif
 
+/// \brief Declares the runtime structures of a PVM instance.
+///
+/// \details By default the instance is packed to save RAM. Defining `PVM_NATURAL_LAYOUT` keeps the data stack and the call
+/// stack naturally aligned instead, which spares strict-alignment cores byte-wise access to them in every instruction.
+#ifdef PVM_NATURAL_LAYOUT
+#define pvm_layout_struct struct
+#else
+#define pvm_layout_struct packed_struct
+#endif
+
 /// \brief This defines a type pvm_op_t which is an 8-bit unsigned integer.
 ///
 /// \details Represents an operation code (opcode) in the PVM bytecode. Each instruction in the bytecode is encoded as a single byte, so an 8-bit type is sufficient.
@@ -31,6 +46,49 @@
 /// \note This type will not be extended or sprinkled in other versions of virtual machine
 typedef uint8_t pvm_op_t;
 
+/// \brief Enumerates the opcodes of the PVM instruction set.
+///
+/// \details Opcodes with an operand keep it in the low bits: PSH holds a 7-bit literal, PSC a 5-bit literal complement,
+/// POP the number of values to drop less one, JMP, CAL, LDV and STV a 4-bit operand which value 0x0F means the operand
+/// is taken from the data stack.
+typedef enum pvm_opcode {
+	PVM_OP_PSH = 0x00,
+	PVM_OP_PSC = 0x80,
+	PVM_OP_BZE = 0xA0,
+	PVM_OP_BNZ,
+	PVM_OP_BEQ,
+	PVM_OP_BNE,
+	PVM_OP_BGT,
+	PVM_OP_BLT,
+	PVM_OP_BGE,
+	PVM_OP_BLE,
+	PVM_OP_ADD,
+	PVM_OP_SUB,
+	PVM_OP_MUL,
+	PVM_OP_DIV,
+	PVM_OP_PWR,
+	PVM_OP_AND,
+	PVM_OP_IOR,
+	PVM_OP_XOR,
+	PVM_OP_SKZ,
+	PVM_OP_SNZ,
+	PVM_OP_SKN,
+	PVM_OP_SNN,
+	PVM_OP_SLP,
+	PVM_OP_RET,
+	PVM_OP_LDC,
+	PVM_OP_JMB,
+	PVM_OP_NEG,
+	PVM_OP_INV,
+	PVM_OP_INC,
+	PVM_OP_DEC,
+	PVM_OP_POP,
+	PVM_OP_JMP = 0xC0,
+	PVM_OP_CAL = 0xD0,
+	PVM_OP_LDV = 0xE0,
+	PVM_OP_STV = 0xF0
+} pvm_opcode_t;
+
 /// \brief This defines a type pvm_address_t which is a 16-bit unsigned integer.
 ///
 /// \details Represents an address within the PVM executable. This is used to reference locations in the code section,
@@ -41,46 +99,81 @@ typedef uint8_t pvm_op_t;
 /// \note This type may be extended or sprinkled in other versions of virtual machine if needed
 typedef uint16_t pvm_address_t;
 
-/// \brief This defines a default data type pvm_data_t which is a 32-bit signed integer.
+#ifndef PVM_DATA_WIDTH
+/// \brief The width of `pvm_data_t` in bits: 8, 16 or 32.
+///
+/// \details Narrower data halves or quarters the data stack of every instance, which lets RAM-starved MCUs run more of
+/// them. Values wrap around the width, and executables must be compiled for it, see `PVM_EXE_WIDTHS`.
+#define PVM_DATA_WIDTH 32
+#endif
+
+#ifndef PVM_CONST_WIDTH
+/// \brief The width of `pvm_const_t` in bits: 8, 16 or 32, at most `PVM_DATA_WIDTH`.
+#define PVM_CONST_WIDTH PVM_DATA_WIDTH
+#endif
+
+#if PVM_CONST_WIDTH > PVM_DATA_WIDTH
+#error "PVM_CONST_WIDTH must not exceed PVM_DATA_WIDTH"
+#endif
+
+/// \brief This defines a data type pvm_data_t which is a signed integer of `PVM_DATA_WIDTH` bits, 32 by default.
 ///
 /// \details Represents data values that are pushed onto and popped from the data stack. This type holds variables,
 /// loaded constants, and intermediate results of computations.
 ///
-/// \note This type may be extended or sprinkled in other versions of virtual machine if needed
-typedef int32_t pvm_data_t;
-
-/// \brief Sign Extension macro
+/// \note The PVM computes in 32 bits and stores the results wrapped around the width of this type.
 ///
-/// \detailsThe PVM_DATA_SIGN macro (0x80000000ul) is used to handle sign extension when dealing with shorter stack types.
-/// This ensures that negative values are correctly interpreted.
-///
-/// \note Change this walue when changing the size of the `pvm_data_t` type
+/// \brief Sign Extension macro
 ///
-/// \example When data type is 16-bit set to the following values: \code typedef int16_t pvm_data_t;
-/// #define PVM_DATA_SIGN 0xFFFF8000ul
+/// \details The PVM_DATA_SIGN macro holds the bits set by the sign extension of a negative `pvm_data_t` into 32 bits.
+#if PVM_DATA_WIDTH == 32
+typedef int32_t pvm_data_t;
 #define PVM_DATA_SIGN 0x80000000ul
+#elif PVM_DATA_WIDTH == 16
+typedef int16_t pvm_data_t;
+#define PVM_DATA_SIGN 0xFFFF8000ul
+#elif PVM_DATA_WIDTH == 8
+typedef int8_t pvm_data_t;
+#define PVM_DATA_SIGN 0xFFFFFF80ul
+#else
+#error "PVM_DATA_WIDTH must be 8, 16 or 32"
+#endif
 
-/// \brief This defines a default constant type pvm_const_t which is a 32-bit signed integer.
+/// \brief This defines a constant type pvm_const_t which is a signed integer of `PVM_CONST_WIDTH` bits.
 ///
 /// \details Represents constant values within the PVM executable. Constants are stored in a separate section of the
 /// executable and can be loaded onto the data stack using specific instructions.
 ///
-/// \note This type may be extended or sprinkled in other versions of virtual machine if needed
-///
 /// \note No sense to extend this type more than `pvm_data_t`
+///
+/// \brief Sign Extension macro for Constants
+///
+/// \details The PVM_CONST_SIGN macro holds the bits set by the sign extension of a negative `pvm_const_t` into 32 bits.
+#if PVM_CONST_WIDTH == 32
 typedef int32_t pvm_const_t;
+#define PVM_CONST_SIGN 0x80000000ul
+#elif PVM_CONST_WIDTH == 16
+typedef int16_t pvm_const_t;
+#define PVM_CONST_SIGN 0xFFFF8000ul
+#elif PVM_CONST_WIDTH == 8
+typedef int8_t pvm_const_t;
+#define PVM_CONST_SIGN 0xFFFFFF80ul
+#else
+#error "PVM_CONST_WIDTH must be 8, 16 or 32"
+#endif
 
+/// \brief Encodes a width of `pvm_data_t` or `pvm_const_t` into the two bits of `PVM_EXE_WIDTHS`.
+#define PVM_EXE_WIDTH(width) ((width) == 32 ? 0 : (width) == 16 ? 1 : 2)
 
-/// \brief Sign Extension macro for Constants
-///
-/// \detailsThe PVM_DATA_SIGN macro (0x80000000ul) is used to handle sign extension when dealing with shorter stack types.
-/// This ensures that negative values are correctly interpreted.
-///
-/// \note Change this wale when changing the size of the `pvm_data_t` type
+/// \brief The mask of the executable format within `vm_version`, `PVM_EXE_V1` or `PVM_EXE_V2`.
+#define PVM_EXE_FORMAT 0x0F
+
+/// \brief The widths the executable is compiled for, held by the higher bits of `vm_version`.
 ///
-/// \example When data type is 16-bit set to the following values: \code typedef int16_t pvm_const_t;
-/// #define PVM_CONST_SIGN 0xFFFF8000ul
-#define PVM_CONST_SIGN 0x80000000ul
+/// \details Bits 4 and 5 encode the width of the data and bits 6 and 7 that of the constants: 0 for 32 bits, 1 for 16
+/// and 2 for 8, so executables of the 32-bit PVM keep the plain format codes. `pvm_exe_check()` rejects executables
+/// compiled for other widths than the PVM is built with.
+#define PVM_EXE_WIDTHS (PVM_EXE_WIDTH(PVM_DATA_WIDTH) << 4 | PVM_EXE_WIDTH(PVM_CONST_WIDTH) << 6)
 
 /// \brief This defines a type pvm_data_stack_t which is an 8-bit unsigned integer.
 ///
@@ -98,13 +191,13 @@ typedef uint8_t pvm_data_stack_t;
 /// \note This type may be extended in other versions of virtual machine if needed to have a deeper call stack
 typedef uint8_t pvm_call_stack_t;
 
-/// \brief This defines a type pvm_function_index_t which is an 8-bit unsigned integer.
+/// \brief This defines a type pvm_function_index_t which is a 16-bit unsigned integer.
 ///
 /// \details Represents an index into the function table within the PVM executable. Each function in the executable is
 /// identified by a unique index.
 ///
-/// \note This type may be extended in other versions of virtual machine if needed to have more built-in functions
-typedef uint8_t pvm_function_index_t;
+/// \note The index is as wide as `functions_count` of the `pvm_exe_v2_t` executable format.
+typedef uint16_t pvm_function_index_t;
 /// \brief Represents a function in the PVM executable.
 ///
 /// \details This structure defines the attributes of a function within the PVM executable.
@@ -138,7 +231,7 @@ typedef packed_struct pvm_function {
 	uint8_t is_built_in : 1;
 } pvm_function_t;
 
-/// \brief Represents the PVM executable.
+/// \brief Represents the PVM executable of the compact format `PVM_EXE_V1`.
 ///
 /// \details This structure defines the layout of a PVM executable, including its size, minimum VM version, number of
 /// functions, number of constants, and the number of main variables. It also includes an array of function descriptors,
@@ -196,13 +289,121 @@ typedef packed_struct pvm_exe {
 	// uint8_t code[];
 } pvm_exe_t;
 
+/// \brief Represents the PVM executable of the wide format `PVM_EXE_V2`.
+///
+/// \details The layout follows `pvm_exe_t` with wider fields lifting the limits of 256 functions, 256 constants and
+/// 64 KiB of the whole executable, so large scripts keep their constants in the constants section rather than spilling
+/// them into long PSC chains. The function descriptors, the constants and the code are laid out the same way. The code
+/// section itself is still addressed by `pvm_address_t`, so it is limited to 64 KiB.
+///
+/// \note Both formats start with `vm_version`, so the executables are passed around as `pvm_exe_t` and the format is
+/// told by that field.
+typedef packed_struct pvm_exe_v2 {
+	/// \brief The version code of the PVM required running this executable, `PVM_EXE_V2`.
+	uint8_t vm_version;
+	/// \brief The total size of all variable fields in the executable in bytes excluding fixed size fields.
+	uint32_t size;
+	/// \brief The number of functions defined in the executable.
+	uint16_t functions_count;
+	/// \brief The number of constants defined in the executable.
+	uint16_t constants_count;
+	/// \brief The number of main variables used by the executable, they live in the data stack anyway.
+	uint8_t main_variables_count;
+	/// \brief The array of function definitions, see `pvm_exe_t`.
+	pvm_function_t functions[];
+} pvm_exe_v2_t;
+
+/// \brief Represents a PVM executable loaded for execution.
+///
+/// \details The sections of the executable are located once by `pvm_image_init()`, so the running engines never
+/// decode the header again. The image is only read while running, any number of PVM instances may share it.
+typedef struct pvm_image {
+	/// \brief The executable the image is loaded from.
+	const pvm_exe_t *exe;
+	/// \brief The function descriptors of the executable.
+	const pvm_function_t *functions;
+	/// \brief The constants section of the executable.
+	const pvm_const_t *constants;
+	/// \brief The code section of the executable.
+	const uint8_t *code;
+	/// \brief The size of the code section in bytes, which is the address the code ends at.
+	size_t code_size;
+	/// \brief The number of functions, see `pvm_exe_t`.
+	uint16_t functions_count;
+	/// \brief The number of constants, see `pvm_exe_t`.
+	uint16_t constants_count;
+	/// \brief The number of main variables, see `pvm_exe_t`.
+	uint8_t main_variables_count;
+} pvm_image_t;
+
+#ifdef PVM_PREPARE
+/// \brief Represents the code of a PVM executable pre-decoded by `pvm_prepare()`.
+///
+/// \details The layout is internal to the threaded engine. The prepared code lives in the arena passed to
+/// `pvm_prepare()` and may be shared by any number of PVM instances running the same executable.
+typedef struct pvm_prepared pvm_prepared_t;
+#endif
+
+#ifdef PVM_ENV
+/// \brief Represents the environment of PVM instances, see `struct pvm_env` below.
+typedef struct pvm_env pvm_env_t;
+#endif
+
+#ifdef PVM_PROFILE
+/// \brief Represents the execution profile of PVM instances, see `struct pvm_profile` below.
+typedef struct pvm_profile pvm_profile_t;
+#endif
+
+#ifdef PVM_TRACE
+/// \brief Represents the execution trace of a PVM instance, see `struct pvm_trace` below.
+typedef struct pvm_trace pvm_trace_t;
+#endif
+
+#ifdef PVM_SWAP
+/// \brief Represents an image swap of PVM instances, see `struct pvm_swap` below.
+typedef struct pvm_swap pvm_swap_t;
+#endif
+
+/// \brief Represents a frame of the call stack of a PVM instance, see `pvm_t`.
+pvm_layout_struct pvm_call_stack {
+	/// \brief Function Descriptor
+	///
+	/// \details This field points to the descriptor of the function in the executable's function table. Returns and
+	/// variable accesses take the layout of the frame from it directly rather than looking the function up by its
+	/// index and validating it again.
+	const pvm_function_t *function;
+	/// \brief Return Address
+	///
+	/// \details This field stores the address to which the program counter (PC) should return after the current
+	/// function call completes. It is crucial for managing the control flow and ensuring that the execution resumes
+	/// correctly after a function returns.
+	pvm_address_t return_address;
+	/// \brief Variables Start
+	///
+	/// \details This field indicates the starting index of the variables for the current function in the data stack.
+	/// It helps in managing the local variables of the function and ensures that they are correctly accessed and
+	/// modified during the function's execution.
+	pvm_data_stack_t variables_start;
+	/// \brief Actual number of arguments passed
+	///
+	/// \details This field specifies the actual number of the arguments passed to the current function (especially
+	/// variadic ones). It is used to manage the argument stack and ensure that the correct number of arguments is
+	/// pushed onto the stack before a function call and popped off the stack after the function returns.
+	pvm_data_stack_t arguments_count;
+	/// \brief Function Index
+	///
+	/// This field stores the index of the current function in the executable's function table. It is used to identify
+	/// the function being executed. This index is crucial for managing the data call stack using function descriptor.
+	pvm_function_index_t function_index;
+};
+
 /// \brief Represents the PVM instance.
 ///
 /// \details This structure defines the state of a PVM instance, including the timer, timeout, data stack, call stack, program counter, stack tops, and persistent data.
 /// The persistent data section contains the binding and a pointer to the executable.
 ///
-/// \note The structure is packed to ensure efficient memory usage.
-typedef packed_struct pvm {
+/// \note The structure is packed to ensure efficient memory usage, unless `PVM_NATURAL_LAYOUT` is defined.
+typedef pvm_layout_struct pvm {
 	/// \brief Timer
 	///
 	/// \details This field holds the current time in milliseconds. It is used to track the elapsed time for sleep instructions. The
@@ -214,6 +415,12 @@ typedef packed_struct pvm {
 	/// timeout value is set, and the PVM enters a sleep state until the specified duration has elapsed. The combination of the
 	/// timer and timeout fields allows the PVM to handle delays accurately.
 	uint32_t timeout;
+	/// \brief Waiting
+	///
+	/// \details This field is set by `pvm_wait()` when a built-in function suspends the PVM until an event, along with
+	/// the number of the values it returns, see `PVM_WAITING`. The PVM does not run until `pvm_complete()` clears it.
+	uint8_t waiting;
+	#ifndef PVM_ARENA
 	/// \brief Data Stack
 	///
 	/// \details The data stack is a crucial component of the PVM instance, used for storing temporary data during the execution of
@@ -222,38 +429,15 @@ typedef packed_struct pvm {
 	pvm_data_t data_stack[PVM_DATA_STACK_SIZE];
 	/// \brief Call Stack
 	///
-	/// \details The call stack is used to manage function calls and returns. It is implemented as an array of structures, each
-	/// containing the return address, the start of the variables in the data stack, the size of the arguments, and the
-	/// function index. The call stack size is defined by `PVM_CALL_STACK_SIZE` during compile time.
+	/// \details The call stack is used to manage function calls and returns. It is implemented as an array of frames, each
+	/// containing the function descriptor, the return address, the start of the variables in the data stack, the size of
+	/// the arguments, and the function index. The call stack size is defined by `PVM_CALL_STACK_SIZE` during compile time.
 	///
 	/// \details The call stack allows the PVM to keep track of the execution context for each function call, enabling nested
 	/// function calls and proper return handling. The stack top pointer (`call_top`) keeps track of the current position
 	/// in the call stack.
-	packed_struct pvm_call_stack {
-		/// \brief Return Address
-		///
-		/// \details This field stores the address to which the program counter (PC) should return after the current
-		/// function call completes. It is crucial for managing the control flow and ensuring that the execution resumes
-		/// correctly after a function returns.
-		pvm_address_t return_address;
-		/// \brief Variables Start
-		///
-		/// \details This field indicates the starting index of the variables for the current function in the data stack.
-		/// It helps in managing the local variables of the function and ensures that they are correctly accessed and
-		/// modified during the function's execution.
-		pvm_data_stack_t variables_start;
-		/// \brief Actual number of arguments passed
-		///
-		/// \details This field specifies the actual number of the arguments passed to the current function (especially
-		/// variadic ones). It is used to manage the argument stack and ensure that the correct number of arguments is
-		/// pushed onto the stack before a function call and popped off the stack after the function returns.
-		pvm_data_stack_t arguments_count;
-		/// \brief Function Index
-		///
-		/// This field stores the index of the current function in the executable's function table. It is used to identify
-		/// the function being executed. This index is crucial for managing the data call stack using function descriptor.
-		pvm_function_index_t function_index;
-	} call_stack[PVM_CALL_STACK_SIZE];
+	struct pvm_call_stack call_stack[PVM_CALL_STACK_SIZE];
+	#endif
 	/// \brief Program Counter (PC)
 	///
 	/// \details The program counter (PC) is a register that points to the address of the next instruction to be executed. It is
@@ -269,24 +453,92 @@ typedef packed_struct pvm {
 	/// \details This field is a pointer that keeps track of the current position in the call stack. It is incremented when a function
 	/// is called and decremented when a function returns.
 	pvm_call_stack_t call_top;
+	#ifdef PVM_CYCLES
+	/// \brief Pending Charge
+	///
+	/// \details This field accumulates the cycles charged by calls, returns and built-in functions, see `pvm_charge()`.
+	/// The running engine spends them from its budget as soon as the call returns.
+	uint32_t charge;
+	#endif
+	#ifdef PVM_ARENA
+	/// \brief Data Stack
+	///
+	/// \details With `PVM_ARENA` the data stack lives in the arena passed to `pvm_init()` rather than in the instance,
+	/// it holds `data_size` values. The stacks survive `pvm_reset()`, which clears their contents only.
+	pvm_data_t *data_stack;
+	/// \brief Call Stack
+	///
+	/// \details With `PVM_ARENA` the call stack lives in the arena passed to `pvm_init()` as well, it holds `call_size`
+	/// frames.
+	struct pvm_call_stack *call_stack;
+	/// \brief The number of values the data stack holds, at most `PVM_DATA_STACK_SIZE`.
+	pvm_data_stack_t data_size;
+	/// \brief The number of frames the call stack holds, at most `PVM_CALL_STACK_SIZE`.
+	pvm_call_stack_t call_size;
+	#endif
 	/// \brief Data that persists over reset
 	///
 	/// \details The persistent data section ensures that the PVM instance can be reset without losing the executable and binding
-	/// information, allowing for consistent execution across resets.
-	packed_struct {
+	/// information, allowing for consistent execution across resets. It must remain the last field of the instance.
+	pvm_layout_struct {
 		/// \brief Binding
 		///
 		/// \details This field is used to store binding-specific data that persists across resets of the PVM instance. It is a user-defined
 		/// field that can be used to store context-specific information like id of a dedicated output of the MCU this virtual
 		/// machine is tied to.
 		uint8_t binding;
-		/// \brief Executable Pointer
+		/// \brief Image Pointer
+		///
+		/// \details This field is a pointer to the loaded PVM executable, see `pvm_image_init()`.
+		const pvm_image_t *image;
+		#ifdef PVM_ENV
+		/// \brief Environment Pointer
+		///
+		/// \details This optional field points to the environment providing the clock and the built-in functions of the
+		/// instance. It must be set when `PVM_ENV` is defined.
+		pvm_env_t *env;
+		#endif
+		#ifdef PVM_PROFILE
+		/// \brief Profile Pointer
+		///
+		/// \details This optional field points to the profile counting the execution of the instance. Instances running the
+		/// same executable may share a profile.
+		pvm_profile_t *profile;
+		#endif
+		#ifdef PVM_TRACE
+		/// \brief Trace Pointer
 		///
-		//// \details This field is a pointer to the PVM executable structure described above.
-		const pvm_exe_t *exe;
+		/// \details This optional field points to the ring buffer recording the last instructions executed by the instance.
+		/// Unlike profiles, traces are not shared, every instance needs its own one.
+		pvm_trace_t *trace;
+		#endif
+		#ifdef PVM_SWAP
+		/// \brief Swap Pointer
+		///
+		/// \details This optional field points to the swap publishing the new images of the executable. Any number of
+		/// instances may share a swap, so a single `pvm_swap_publish()` updates all of them.
+		pvm_swap_t *swap;
+		#endif
+		#ifdef PVM_PREPARE
+		/// \brief Prepared Code Pointer
+		///
+		/// \details This optional field points to the pre-decoded code of the executable. When it is set and prepared from
+		/// the same executable, the PVM executes the pre-decoded instructions instead of the raw bytecode.
+		const pvm_prepared_t *prepared;
+		#endif
 	} persist;
 } pvm_t;
 
+#ifdef PVM_ARENA
+/// \brief The number of values the data stack of an instance holds.
+#define pvm_data_stack_size(vm) ((vm)->data_size)
+/// \brief The number of frames the call stack of an instance holds.
+#define pvm_call_stack_size(vm) ((vm)->call_size)
+#else
+#define pvm_data_stack_size(vm) PVM_DATA_STACK_SIZE
+#define pvm_call_stack_size(vm) PVM_CALL_STACK_SIZE
+#endif
+
 /// \brief Enumerates the possible error codes returned by PVM functions.
 ///
 /// \details This enumeration defines various error codes that can be returned by PVM functions to indicate different types of errors.
@@ -371,6 +623,46 @@ extern const packed_struct pvm_builtins {
 /// Typically assign in builtins c module as<br>\code (sizeof(pvm_builtins) / sizeof(pvm_builtins[0]))
 extern const size_t pvm_builtins_size;
 
+/// \brief Defines the signature of typed built-in functions of a fixed arity.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] arguments The arguments as many as the function takes.
+///
+/// \return The single value the function returns, the PVM stores it into the first return slot.
+///
+/// \details Typed built-in functions suit getters such as ticks and sensor readings, which return a single value, and
+/// need not mind the number of arguments or the return slots themselves.
+typedef pvm_data_t(pvm_builtin_value_f(pvm_t *vm, const pvm_data_t arguments[]));
+
+/// \brief Generates the enumeration of the built-in functions registered in a list, see `PVM_BUILTINS`.
+///
+/// \param[in] list The X-macro listing the built-in functions in the order of their indices, it takes two macros
+/// applied to every entry: `call(function)` for a `pvm_builtin_f` and `value(function)` for a `pvm_builtin_value_f`.
+///
+/// \details Every function gets its index as `PVM_BUILTIN_<function>`, the enumeration ends with `PVM_BUILTINS_COUNT`.
+#define PVM_BUILTIN_ENUM(list) enum pvm_builtin_index { list(pvm_builtin_enumerator, pvm_builtin_enumerator) PVM_BUILTINS_COUNT };
+#define pvm_builtin_enumerator(function) PVM_BUILTIN_##function,
+
+/// \brief Generates the adapters of the typed built-in functions of a list to the `pvm_builtin_f` signature.
+///
+/// \details The adapters fill the `pvm_builtins[]` table generated by `PVM_BUILTIN_TABLE()`, the PVM built with the
+/// same list calls the typed functions directly instead. The adapters are not told the number of the return slots, so
+/// the result is only stored while its slot lies within the data stack, a call taking no arguments on a full stack has
+/// none.
+#define PVM_BUILTIN_ADAPTERS(list) list(pvm_builtin_no_adapter, pvm_builtin_value_adapter)
+#define pvm_builtin_no_adapter(function)
+#define pvm_builtin_value_adapter(function) \
+	static void function##_adapter(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) { \
+		(void)args_size; \
+		const pvm_data_t result = function(vm, arguments); \
+		if (arguments < vm->data_stack + pvm_data_stack_size(vm)) arguments[0] = result; \
+	}
+
+/// \brief Generates the entries of the `pvm_builtins[]` table from a list of built-in functions.
+#define PVM_BUILTIN_TABLE(list) list(pvm_builtin_call_entry, pvm_builtin_value_entry)
+#define pvm_builtin_call_entry(function) { function },
+#define pvm_builtin_value_entry(function) { function##_adapter },
+
 /// \brief A necessary to implement function that is used for SLP instruction functionality.
 /// It returns the current time in milliseconds since an unspecified starting point, which is not affected by system time changes.
 ///
@@ -379,23 +671,431 @@ extern const size_t pvm_builtins_size;
 /// \note The returned value is not the actual time of day, but rather the time elapsed since an unspecified starting point.
 extern uint32_t now_ms(void);
 
+#ifdef PVM_ENV
+/// \brief Represents the environment of PVM instances: their clock, their built-in functions and the host context.
+///
+/// \details When `PVM_ENV` is defined, the PVM reads the time and dispatches built-in functions through the environment
+/// the instance refers to instead of the global `now_ms()` and `pvm_builtins[]`, so each pool of instances may get its
+/// own clock and built-in table. The PVM reads the time from the cached `tick` only, which the host or the scheduler
+/// refreshes by `pvm_env_update()` once per time slice rather than the PVM calling out for every `SLP`.
+struct pvm_env {
+	/// \brief Optional function returning the current time in milliseconds, see `now_ms()`.
+	uint32_t (*clock)(struct pvm_env *env);
+	/// \brief The cached current time in milliseconds.
+	uint32_t tick;
+	/// \brief The table of built-in functions.
+	const struct pvm_builtins *builtins;
+	/// \brief The number of built-in functions in the table.
+	size_t builtins_size;
+	/// \brief User-defined context, e.g. the device the instances are tied to.
+	void *context;
+};
+
+/// \brief Refreshes the cached time of the environment from its clock.
+///
+/// \param[in,out] env The environment.
+///
+/// \return The current time in milliseconds, the cached one when the environment has no clock.
+static inline uint32_t pvm_env_update(pvm_env_t *env) {
+	if (env->clock) env->tick = env->clock(env);
+	return env->tick;
+}
+#endif
+
+#ifdef PVM_PROFILE
+/// \brief Represents the execution counters of a function.
+typedef struct pvm_profile_function {
+	/// \brief The number of times the function was called.
+	uint32_t calls;
+	/// \brief The number of instructions executed while the function was the current one, its callees excluded.
+	uint32_t instructions;
+	/// \brief The time spent in a built-in function measured by the clock of the profile.
+	uint32_t time;
+} pvm_profile_function_t;
+
+/// \brief Represents the execution profile of PVM instances.
+///
+/// \details When `PVM_PROFILE` is defined, the PVM counts every instruction executed by an instance with a profile
+/// assigned to its `persist.profile`. The counter arrays are provided by the host and are optional, shorter arrays
+/// only count the leading addresses or functions. A superinstruction of prepared code counts as the first instruction
+/// of its sequence.
+struct pvm_profile {
+	/// \brief Optional high resolution clock timing built-in functions, e.g. a cycle counter of the MCU.
+	uint32_t (*clock)(void);
+	/// \brief The total number of executed instructions.
+	uint32_t instructions;
+	/// \brief The number of executions of every opcode.
+	uint32_t opcodes[256];
+	/// \brief The number of executions of the instruction at every address of the code section.
+	uint32_t *pcs;
+	/// \brief The number of entries of `pcs`, instructions at further addresses are not counted by address.
+	size_t pcs_size;
+	/// \brief The counters of main() followed by the counters of every function of the executable by its index.
+	pvm_profile_function_t *functions;
+	/// \brief The number of entries of `functions`, `functions_count + 1` to count all functions.
+	size_t functions_size;
+};
+
+/// \brief Clears all counters of the profile keeping its arrays.
+///
+/// \param[in,out] profile The profile.
+void pvm_profile_reset(pvm_profile_t *profile);
+
+/// \brief Copies the counters of the profile into a snapshot.
+///
+/// \param[in] profile The profile.
+/// \param[in,out] snapshot The snapshot with its own arrays, the counters fitting into them are copied.
+///
+/// \details The snapshot is consistent when taken while no instance counting into the profile is running.
+void pvm_profile_snapshot(const pvm_profile_t *profile, pvm_profile_t *snapshot);
+#endif
+
+#ifdef PVM_TRACE
+/// \brief Represents an instruction recorded by the trace.
+typedef struct pvm_trace_record {
+	/// \brief The value on the top of the data stack upon entering the instruction, 0 if the stack was empty.
+	///
+	/// \details This is the operand taken from the stack of a branch, of LDC, JMB and of the instructions with the
+	/// operand nibble 0xF.
+	pvm_data_t top;
+	/// \brief The address of the instruction.
+	pvm_address_t pc;
+	/// \brief The opcode of the instruction.
+	pvm_op_t op;
+} pvm_trace_record_t;
+
+/// \brief Represents the execution trace of a PVM instance.
+///
+/// \details When `PVM_TRACE` is defined, the PVM records every instruction an instance with a trace assigned to its
+/// `persist.trace` is about to execute into the ring buffer of the trace, overwriting the oldest records once it is
+/// full. A superinstruction of prepared code is recorded as the first instruction of its sequence. The records are
+/// provided by the host, see `pvm_trace_dump()` to take them off the device.
+struct pvm_trace {
+	/// \brief The ring buffer of the records.
+	pvm_trace_record_t *records;
+	/// \brief The number of entries of `records`.
+	size_t size;
+	/// \brief The index of the record written next.
+	size_t head;
+	/// \brief The number of instructions recorded, including those overwritten since.
+	uint32_t count;
+};
+
+/// \brief The size of a record dumped by `pvm_trace_dump()` in bytes.
+#define PVM_TRACE_RECORD_SIZE 7
+
+/// \brief Clears the trace keeping its records.
+///
+/// \param[in,out] trace The trace.
+void pvm_trace_reset(pvm_trace_t *trace);
+
+/// \brief Dumps the records of the trace from the oldest one on.
+///
+/// \param[in] trace The trace.
+/// \param[out] buffer The buffer receiving the records, the most recent ones fitting into it are dumped.
+/// \param[in] size The size of the buffer in bytes.
+///
+/// \return The size of the dump in bytes.
+///
+/// \details Every record takes `PVM_TRACE_RECORD_SIZE` bytes in little-endian order whatever the host: the address
+/// in two bytes, the opcode in one and the value on the top of the data stack in four, so the dump may be sent as it is
+/// to the `pvm-trace` decoder.
+size_t pvm_trace_dump(const pvm_trace_t *trace, uint8_t *buffer, size_t size);
+#endif
+
+#ifdef PVM_SWAP
+/// \brief Represents an image swap of PVM instances.
+///
+/// \details The instances pointing to the swap by `persist.swap` and running the previous image move to the published one
+/// on their own once they reach a safe point: a backward jump or branch, or a return, into main() with nothing but its
+/// variables on the data stack. Only then the state of the instance is as simple as the variables of main(), the first
+/// `keep` of them are kept and main() of the new image resumes at `entry`, so the initialization it may skip is not
+/// executed again. The instance yields the rest of the budget of the run it swaps in. Once the last instance has moved,
+/// `release` is called to free the previous image.
+///
+/// \note The swap is not synchronized, the instances sharing it and the host publishing it should run on one thread.
+struct pvm_swap {
+	/// \brief The published image, initially the one the instances run.
+	const pvm_image_t *image;
+	/// \brief The image the instances move from, NULL when no swap is pending.
+	const pvm_image_t *previous;
+	#ifdef PVM_PREPARE
+	/// \brief The optional prepared code of the published image, the instances take it along with the image when they
+	/// resume main() from the start.
+	const pvm_prepared_t *prepared;
+	#endif
+	/// \brief Optional function called once no instance runs the previous image, which may be freed then.
+	void (*release)(struct pvm_swap *swap, const pvm_image_t *previous);
+	/// \brief The number of instances still running the previous image.
+	uint16_t pending;
+	/// \brief The version of the published image, every publication increments it.
+	uint16_t version;
+	/// \brief The address main() of the published image resumes at.
+	pvm_address_t entry;
+	/// \brief The number of the variables of main() kept, those the layouts of both images share.
+	uint8_t keep;
+};
+
+/// \brief Publishes a new image to the instances sharing a swap.
+///
+/// \param[in,out] swap The swap.
+/// \param[in] image The new image.
+/// \param[in] entry The address main() of the new image resumes at, zero to run it from the start.
+/// \param[in] keep The number of the variables of main() kept, at most the variables of both images are kept.
+/// \param[in] instances The number of the instances running the current image of the swap.
+///
+/// \return Non-zero if the image is published, zero if the instances are still moving to the one published before.
+///
+/// \details The publication is atomic for the instances, each one moves as a whole at its own safe point.
+///
+/// \note The entry is not checked against the new image, it should be an address main() reaches with only its
+/// variables on the data stack. Instances resuming at an entry other than zero drop the prepared code of the swap and
+/// run checked.
+int pvm_swap_publish(pvm_swap_t *swap, const pvm_image_t *image, pvm_address_t entry, uint8_t keep, uint16_t instances);
+
+/// \brief Moves a PVM instance to the image published by its swap at once.
+///
+/// \param[in,out] vm The PVM instance.
+///
+/// \return Non-zero if the instance has moved, zero if it does not run the previous image or the variables of main()
+/// do not fit into its data stack.
+///
+/// \details The running engines move instances at their safe points. The host moves those never reaching one, such
+/// as instances stopped by an error, which then restart main() of the new image at its entry as if reset. Only the
+/// variables of main() kept by the swap are preserved.
+int pvm_swap_take(pvm_t *vm);
+#endif
+
+#ifdef PVM_CYCLES
+/// \brief The cycle weights of the instruction classes.
+///
+/// \details When `PVM_CYCLES` is defined, the budget of `pvm_run()` is counted in cycles rather than instructions and
+/// every instruction spends the weight of its class. The weights are abstract units to calibrate against the target,
+/// each of them may be overridden upon build.
+#ifndef PVM_CYCLES_LITERAL
+/// \brief PSH and PSC.
+#define PVM_CYCLES_LITERAL 1
+#endif
+#ifndef PVM_CYCLES_ALU
+/// \brief ADD, SUB, AND, IOR, XOR, NEG, INV, INC, DEC, POP and the skips.
+#define PVM_CYCLES_ALU 1
+#endif
+#ifndef PVM_CYCLES_MUL
+/// \brief MUL.
+#define PVM_CYCLES_MUL 2
+#endif
+#ifndef PVM_CYCLES_DIV
+/// \brief DIV.
+#define PVM_CYCLES_DIV 8
+#endif
+#ifndef PVM_CYCLES_PWR
+/// \brief PWR, which takes up to 31 squaring steps.
+#define PVM_CYCLES_PWR 32
+#endif
+#ifndef PVM_CYCLES_MEMORY
+/// \brief LDC, LDV and STV.
+#define PVM_CYCLES_MEMORY 2
+#endif
+#ifndef PVM_CYCLES_BRANCH
+/// \brief The branches, JMP and JMB.
+#define PVM_CYCLES_BRANCH 2
+#endif
+#ifndef PVM_CYCLES_CALL
+/// \brief CAL, not including the slots it zeroes and the built-in function it calls.
+#define PVM_CYCLES_CALL 8
+#endif
+#ifndef PVM_CYCLES_RET
+/// \brief RET, not including the slots it moves.
+#define PVM_CYCLES_RET 8
+#endif
+#ifndef PVM_CYCLES_SLP
+/// \brief SLP.
+#define PVM_CYCLES_SLP 2
+#endif
+#ifndef PVM_CYCLES_SLOT
+/// \brief Every variable CAL initializes and every value RET moves.
+#define PVM_CYCLES_SLOT 1
+#endif
+
+/// \brief The worst-case cycles of code which loops or recurses, see `pvm_verify_t`.
+#define PVM_CYCLES_UNBOUNDED UINT32_MAX
+
+/// \brief Charges extra cycles to the budget of the running PVM instance.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] cycles The number of cycles.
+///
+/// \details Built-in functions call it to account for their own cost, e.g. proportional to the work they have done. The
+/// charge is spent from the budget once the built-in function returns and an exhausted budget stops the run there.
+static inline void pvm_charge(pvm_t *vm, const uint32_t cycles) {
+	vm->charge = vm->charge > UINT32_MAX - cycles ? UINT32_MAX : vm->charge + cycles;
+}
+#else
+#define pvm_charge(vm, cycles) ((void)(vm), (void)(cycles))
+#endif
+
 /// \brief Checks the validity of a PVM executable.
 ///
 /// \param[in] exe The PVM executable to check.
 /// \param[in] size The size of the executable in bytes.
 ///
-/// \return PVM_EXE_SIZE if the size does not match, PVM_EXE_VERSION if the minimum VM version does not match, otherwise PVM_EXE_OK.
+/// \return PVM_EXE_VERSION if the format of the executable is not supported or it is compiled for other data or constant
+/// widths, PVM_EXE_SIZE if the size does not match or the sections do not fit into it, otherwise PVM_EXE_OK.
 ///
-/// \details This function verifies the size and minimum VM version of the given PVM executable.
-/// It returns an error if the size of the executable does not match the expected size or if the minimum VM version does not match the current version.
+/// \details This function verifies the format and size of the given PVM executable. Both `PVM_EXE_V1` and `PVM_EXE_V2`
+/// executables are accepted, the format is told by the low bits of the `vm_version` field and the widths by the high
+/// ones, see `PVM_EXE_WIDTHS`.
 ///
 /// \note The size parameter should include the size of the executable header.
 enum pvm_exe_check_result {
+	/// \brief The executable is valid.
 	PVM_EXE_OK = 0,
+	/// \brief The size of the executable does not match its header.
 	PVM_EXE_SIZE,
-	PVM_EXE_VERSION
+	/// \brief The executable requires another version of the PVM.
+	PVM_EXE_VERSION,
+	/// \brief The data stack may underflow, overflow the frame or reach an instruction at different depths, or a
+	/// function may return with the stack smashed.
+	PVM_EXE_STACK,
+	/// \brief A jump, a branch, a function address or the next instruction lays outside the code section, or the code is
+	/// shared by several functions.
+	PVM_EXE_TARGET,
+	/// \brief A function index or a built-in function address is out of bounds, or a variadic call is malformed.
+	PVM_EXE_FUNCTION,
+	/// \brief A variable index is out of the scope of its function.
+	PVM_EXE_VARIABLE,
+	/// \brief A constant index is out of bounds.
+	PVM_EXE_CONSTANT,
+	/// \brief An operand taken from the data stack is not known statically.
+	PVM_EXE_OPERAND,
+	/// \brief The scratch memory is too small to verify the executable.
+	PVM_EXE_SCRATCH,
+	/// \brief The executable cannot be read from its storage, see `pvm_exe_map_file()`.
+	PVM_EXE_IO
 } pvm_exe_check(const pvm_exe_t *exe, size_t size);
 
+/// \brief Loads a PVM executable into an image locating its sections.
+///
+/// \param[out] image The image to initialize.
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first and outlive the image.
+///
+/// \details The image refers to the executable rather than copying it, so executables mapped in place stay there.
+void pvm_image_init(pvm_image_t *image, const pvm_exe_t *exe);
+
+/// \brief The value on the top of the data stack upon entering the instruction is known, see `pvm_verify_state_t`.
+#define PVM_VERIFY_TOP 0x01
+/// \brief The value next to the top of the data stack upon entering the instruction is known.
+#define PVM_VERIFY_SECOND 0x02
+/// \brief The mask of known values.
+#define PVM_VERIFY_KNOWN (PVM_VERIFY_TOP | PVM_VERIFY_SECOND)
+/// \brief The instruction is reachable.
+#define PVM_VERIFY_VISITED 0x04
+
+/// \brief Represents the abstract state of the data stack upon entering an instruction, as proven by the verifier.
+typedef struct pvm_verify_state {
+	/// \brief The values of the top two data stack slots when they are known.
+	int32_t value[2];
+	/// \brief The function owning the instruction: its index plus one or zero for main().
+	uint32_t owner;
+	/// \brief The depth of the data stack relative to the function frame.
+	uint8_t depth;
+	/// \brief The PVM_VERIFY_* flags, the instructions without PVM_VERIFY_VISITED are never executed.
+	uint8_t flags;
+} pvm_verify_state_t;
+
+/// \brief Represents the results of the PVM executable verification.
+typedef struct pvm_verify {
+	/// \brief Optional array of `functions_count` entries receiving the depth of every user function frame.
+	///
+	/// \details The frame depth is the maximum number of data stack slots the function occupies itself, including its
+	/// arguments and variables but not the frames of the functions it calls. Built-in functions get zero.
+	uint8_t *frames;
+	/// \brief The maximum depth of the data stack main() reaches including all nested calls and the room the calls of
+	/// built-in functions check for their returns.
+	///
+	/// \details Recursion is bounded by `PVM_CALL_STACK_SIZE`, deeper calls fail with PVM_CALL_STACK_OVERFLOW anyway.
+	uint16_t stack_depth;
+	/// \brief The maximum depth of the call stack main() reaches, up to `PVM_CALL_STACK_SIZE`.
+	///
+	/// \details Calls of built-in functions take no frame, but they need the room for one, so they count as well.
+	pvm_call_stack_t call_depth;
+	#ifdef PVM_CYCLES
+	/// \brief Optional array of `functions_count` entries receiving the worst-case cycles of a single call of every user
+	/// function including its nested calls.
+	///
+	/// \details Functions which loop or recurse get PVM_CYCLES_UNBOUNDED, their jitter is bounded by the budget instead.
+	/// Charges of built-in functions are not included, built-in functions themselves get zero.
+	uint32_t *cycles;
+	/// \brief The worst-case cycles of the whole execution of main() including all calls.
+	uint32_t main_cycles;
+	/// \brief The worst-case cycles of a single instruction, which is how far a run may overrun its budget.
+	uint32_t op_cycles;
+	#endif
+	/// \brief Optional array of `code_size` entries receiving the abstract state upon entering every instruction.
+	///
+	/// \details Translators of the bytecode take the static stack depths and the operands known statically from it,
+	/// see `pvm_aot_t`.
+	pvm_verify_state_t *states;
+} pvm_verify_t;
+
+/// \brief Calculates the size of the scratch memory needed to verify a PVM executable.
+///
+/// \param[in] exe The PVM executable to verify.
+///
+/// \return The size of the scratch memory in bytes.
+///
+/// \note The size includes the room to align the scratch memory.
+size_t pvm_exe_verify_size(const pvm_exe_t *exe);
+
+/// \brief Verifies the code of a PVM executable.
+///
+/// \param[in] exe The PVM executable to verify, it should pass `pvm_exe_check()` first.
+/// \param[in] scratch The memory used by the verifier.
+/// \param[in] scratch_size The size of the scratch memory in bytes.
+/// \param[in,out] verify The optional verification results.
+///
+/// \return PVM_EXE_OK if the code is proven to be safe, otherwise the reason it is not.
+///
+/// \details The verifier interprets the code of main() and of every user function abstractly, tracking the data stack
+/// depth at every reachable instruction and the values of literals on its top. It proves that the data stack never
+/// underflows the function frame, that every jump, branch and call lands inside the code section at a consistent depth,
+/// that every function returns with a balanced stack and that all constant, variable and function indices are in bounds.
+/// Jump offsets and indices taken from the data stack must be literals or constants known statically.
+/// With `PVM_ENV` the addresses of built-in functions are checked upon call, as the built-in table is not known yet.
+/// With `PVM_CYCLES` the verifier also finds the longest path through every function weighted by the instruction cycles.
+///
+/// \note Prepared code of a verified executable runs on the unchecked fast path, see `pvm_prepare()`.
+enum pvm_exe_check_result pvm_exe_verify(const pvm_exe_t *exe, void *scratch, size_t scratch_size, pvm_verify_t *verify);
+
+#ifdef PVM_PREPARE
+/// \brief Calculates the size of the arena needed to prepare a PVM executable.
+///
+/// \param[in] exe The PVM executable to prepare.
+///
+/// \return The size of the arena in bytes.
+///
+/// \note The size includes the room to align the arena, so an arena of any alignment may be passed to `pvm_prepare()`.
+size_t pvm_prepare_size(const pvm_exe_t *exe);
+
+/// \brief Translates the code section of a PVM executable into the pre-decoded instructions.
+///
+/// \param[in] exe The PVM executable to prepare, it should pass `pvm_exe_check()` first.
+/// \param[out] arena The memory to hold the prepared code.
+/// \param[in] arena_size The size of the arena in bytes.
+///
+/// \return A pointer to the prepared code within the arena or NULL if the arena is too small.
+///
+/// \details Every instruction of the code section is decoded once: immediate operands are extracted, PSH and PSC chains
+/// are folded into literals, absolute jump and branch targets are calculated and function descriptors are looked up.
+/// Assign the result to `persist.prepared` of the PVM instances running this executable. The executable itself stays
+/// unchanged and must outlive the prepared code. When the executable passes `pvm_exe_verify()` the prepared code runs
+/// on the unchecked fast path.
+///
+/// \note Instructions fused from a sequence count as a single instruction of the `pvm_run()` budget. With `PVM_CYCLES`
+/// they spend the cycles of the whole sequence.
+const pvm_prepared_t *pvm_prepare(const pvm_exe_t *exe, void *arena, size_t arena_size);
+#endif
+
 /// \brief Resets the PVM instance to its initial state.
 ///
 /// \param[in,out] vm The PVM instance to reset.
@@ -404,8 +1104,213 @@ enum pvm_exe_check_result {
 /// After resetting, the data stack top is set to the number of main variables defined in the executable.
 ///
 /// \note This function does not modify the executable or the persistent data.
+///
+/// \note With `PVM_ARENA` the instance must be initialized by `pvm_init()` first, the stacks are kept.
 void pvm_reset(pvm_t *vm);
 
+#ifdef PVM_ARENA
+/// \brief Calculates the size of the arena holding the stacks of a PVM instance.
+///
+/// \param[in] verify The results of `pvm_exe_verify()` for the executable the instance runs, or NULL for the stacks of
+/// `PVM_DATA_STACK_SIZE` values and `PVM_CALL_STACK_SIZE` frames.
+///
+/// \return The size of the arena in bytes, including the room to align the stacks wherever the arena starts.
+///
+/// \details Arenas of many instances may be laid out back to back, every one taking this size.
+size_t pvm_arena_size(const pvm_verify_t *verify);
+
+/// \brief Initializes a PVM instance carving its stacks from an arena.
+///
+/// \param[out] vm The PVM instance, its persistent data other than the image is kept.
+/// \param[in] image The executable image the instance runs.
+/// \param[in] verify The results of `pvm_exe_verify()` for the executable, or NULL for the stacks of the maximum sizes.
+/// \param[in] arena The memory holding the stacks for the life of the instance.
+/// \param[in] arena_size The size of the arena in bytes, see `pvm_arena_size()`.
+///
+/// \return PVM_NO_ERROR if the instance is initialized and reset, PVM_DATA_STACK_OVERFLOW or PVM_CALL_STACK_OVERFLOW
+/// if the arena cannot hold the stacks.
+///
+/// \details The verifier proves the deepest data and call stacks main() reaches, so every instance reserves what its
+/// executable needs rather than the worst case of all of them. Both sizes are capped by `PVM_DATA_STACK_SIZE` and
+/// `PVM_CALL_STACK_SIZE`, which bound the verification as well.
+pvm_errno_t pvm_init(pvm_t *vm, const pvm_image_t *image, const pvm_verify_t *verify, void *arena, size_t arena_size);
+#endif
+
+/// \brief The flag of the `waiting` field, the low bits hold the number of the values the awaited function returns.
+#define PVM_WAITING 0x80
+
+/// \brief Suspends the PVM instance from within a built-in function until an event completes the call.
+///
+/// \param[in,out] vm The PVM instance running the built-in function.
+///
+/// \details The built-in function returns at once, the PVM stops after the call and stays suspended by `pvm_run()`
+/// until the host calls `pvm_complete()` with the results of the call. Unlike polling with `SLP`, the waiting instance
+/// costs nothing until then, the scheduler parks it out of its queues.
+void pvm_wait(pvm_t *vm);
+
+/// \brief Completes the call of the built-in function the PVM instance waits for.
+///
+/// \param[in,out] vm The waiting PVM instance.
+/// \param[in] results The values the built-in function returns, NULL to keep those it has stored itself.
+/// \param[in] count The number of the values, at most the number of returns of the function is taken.
+///
+/// \details The results replace the return values on the data stack the way the built-in function would have stored
+/// them into its arguments. The instance continues with the next `pvm_run()`, a scheduled one should also be given back
+/// by `pvm_scheduler_resume()`. Instances which do not wait are left intact.
+void pvm_complete(pvm_t *vm, const pvm_data_t results[], pvm_data_stack_t count);
+
+/// \brief The version of the snapshot format written by `pvm_snapshot()`.
+#define PVM_SNAPSHOT_FORMAT 3
+
+/// \brief The maximum size of a snapshot in bytes, enough for any state of a PVM instance.
+#define PVM_SNAPSHOT_MAX_SIZE (21 + 6 * PVM_CALL_STACK_SIZE + 5 * PVM_DATA_STACK_SIZE)
+
+/// \brief Enumerates the results of restoring a PVM instance from a snapshot.
+enum pvm_snapshot_result {
+	/// \brief The instance is restored.
+	PVM_SNAPSHOT_OK = 0,
+	/// \brief The snapshot is truncated or its size does not match its contents.
+	PVM_SNAPSHOT_SIZE,
+	/// \brief The snapshot was written in another format or by another version of the PVM.
+	PVM_SNAPSHOT_VERSION,
+	/// \brief The snapshot was taken from an instance running another executable.
+	PVM_SNAPSHOT_EXE,
+	/// \brief The checksum of the snapshot does not match, e.g. the flash page was torn while writing it.
+	PVM_SNAPSHOT_CORRUPT,
+	/// \brief The state does not fit into the stacks of this instance or into the executable.
+	PVM_SNAPSHOT_STATE
+};
+
+/// \brief Calculates the hash identifying a PVM executable.
+///
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first.
+///
+/// \return The 32-bit FNV-1a hash of the whole executable including its header.
+uint32_t pvm_exe_hash(const pvm_exe_t *exe);
+
+/// \brief Serializes the live state of a PVM instance.
+///
+/// \param[in] vm The PVM instance, not running at the moment.
+/// \param[out] buffer The memory receiving the snapshot.
+/// \param[in] size The size of the memory in bytes, `PVM_SNAPSHOT_MAX_SIZE` is always enough.
+///
+/// \return The size of the snapshot in bytes or zero if it does not fit into the memory.
+///
+/// \details Only the data stack up to `data_top` and the call stack up to `call_top` are written, the values as
+/// variable-length integers, along with the program counter and the time left to sleep. The snapshot is bound to the
+/// hash of the executable and protected by a checksum, so it may be kept in flash across power cycles or sent to another
+/// node running the same executable.
+size_t pvm_snapshot(const pvm_t *vm, void *buffer, size_t size);
+
+/// \brief Restores the state of a PVM instance from a snapshot.
+///
+/// \param[in,out] vm The PVM instance with its persistent data set and the executable assigned.
+/// \param[in] buffer The snapshot written by `pvm_snapshot()`.
+/// \param[in] size The size of the snapshot in bytes.
+///
+/// \return PVM_SNAPSHOT_OK if the instance is restored, otherwise the reason it is not.
+///
+/// \details A sleeping instance keeps sleeping for the time it had left when the snapshot was taken, counted from now.
+/// With `PVM_ENV` the time is taken from the environment of the instance. The restored state is checked against the
+/// stacks of the instance and the executable, but not against the verifier, so a snapshot resumed on the verified fast
+/// path should come from a trusted source.
+///
+/// \note The instance is left reset when the snapshot cannot be restored.
+enum pvm_snapshot_result pvm_restore(pvm_t *vm, const void *buffer, size_t size);
+
+/// \brief The number of the innermost call stack frames a sample holds.
+#define PVM_SAMPLE_DEPTH 8
+
+/// \brief The size of a sample drained by `pvm_sampler_drain()` in bytes.
+#define PVM_SAMPLE_RECORD_SIZE (4 + 2 * PVM_SAMPLE_DEPTH)
+
+/// \brief Represents the state of a PVM instance taken by `pvm_sample()`.
+typedef struct pvm_sample {
+	/// \brief The program counter of the instance as it was last written back, see `pvm_sample()`.
+	pvm_address_t pc;
+	/// \brief The number of the frames of the call stack, those past `PVM_SAMPLE_DEPTH` are left out of the sample.
+	pvm_call_stack_t depth;
+	/// \brief The binding of the instance telling the instances apart.
+	uint8_t binding;
+	/// \brief The indices of the functions of the innermost frames, the outermost one first.
+	pvm_function_index_t functions[PVM_SAMPLE_DEPTH];
+} pvm_sample_t;
+
+/// \brief Represents a lock-free ring buffer of samples filled by a single producer and drained by a single consumer.
+///
+/// \details The producer is typically a timer interrupt of the MCU or a sampling thread of the host calling
+/// `pvm_sample()`, the consumer a task taking the samples off the device with `pvm_sampler_drain()`. The ring holds
+/// up to `size - 1` samples, further ones are counted as dropped until it is drained.
+typedef struct pvm_sampler {
+	/// \brief The ring buffer of the samples.
+	pvm_sample_t *samples;
+	/// \brief The number of entries of `samples`, at least two.
+	uint32_t size;
+	/// \brief The index of the sample written next, written by the producer only.
+	volatile uint32_t head;
+	/// \brief The index of the sample drained next, written by the consumer only.
+	volatile uint32_t tail;
+	/// \brief The number of the samples dropped while the ring was full.
+	volatile uint32_t dropped;
+} pvm_sampler_t;
+
+/// \brief Records the call stack of a PVM instance into a sampler.
+///
+/// \param[in,out] sampler The sampler.
+/// \param[in] vm The PVM instance, possibly running at the moment.
+///
+/// \return Non-zero if the sample is recorded, zero if the ring is full.
+///
+/// \details The function may interrupt the engine at any instruction. It reads the call stack of the instance, which
+/// every engine keeps up to date in memory, so the functions of a sample are exact up to a call or a return executed
+/// meanwhile. The program counter is cached by the running engine, so it is exact for instances outside the engines
+/// only, and tells the address the run, the latest call or return started from otherwise. Lockstep lanes are sampled
+/// as they were upon joining their group.
+int pvm_sample(pvm_sampler_t *sampler, const pvm_t *vm);
+
+/// \brief Takes the recorded samples out of a sampler.
+///
+/// \param[in,out] sampler The sampler.
+/// \param[out] buffer The buffer receiving the samples, the oldest ones fitting into it are drained.
+/// \param[in] size The size of the buffer in bytes.
+///
+/// \return The size of the drained samples in bytes.
+///
+/// \details Every sample takes `PVM_SAMPLE_RECORD_SIZE` bytes in little-endian order whatever the host: the binding
+/// and the depth in a byte each, the program counter in two bytes and the indices of `PVM_SAMPLE_DEPTH` functions in
+/// two bytes each, so the samples may be sent as they are to the `pvm-fold` tool.
+size_t pvm_sampler_drain(pvm_sampler_t *sampler, uint8_t *buffer, size_t size);
+
+/// \brief Executes up to a given number of instructions in the PVM.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] budget The maximum number of instructions to execute.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details This function fetches and executes instructions from the PVM's program counter in a single dispatch loop.
+/// The program counter, the code pointer and the data stack top are kept in locals for the whole run and written back
+/// into the instance upon return. The run stops early when an error occurs or an `SLP` instruction puts the PVM asleep.
+///
+/// \note A sleeping PVM returns PVM_NO_ERROR immediately without executing any instruction.
+///
+/// \note With `PVM_CYCLES` the budget is counted in cycles. An instruction starts while any cycle is left, so a run
+/// overruns its budget by less than the cycles of the last instruction and the charges of a built-in function it calls.
+pvm_errno_t pvm_run(pvm_t *vm, uint32_t budget);
+
+/// \brief Executes instructions in the PVM while the budget lasts.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in,out] budget The maximum number of instructions to execute, receives the unspent part of it.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details This function is `pvm_run()` telling how many instructions were executed. The instruction which stops the
+/// run, either failing or putting the PVM asleep, is spent from the budget as well.
+///
+/// \note A sleeping PVM leaves the budget untouched.
+pvm_errno_t pvm_run_budget(pvm_t *vm, uint32_t *budget);
+
 /// \brief Executes the next instruction in the PVM.
 ///
 /// \param[in,out] vm The PVM instance.
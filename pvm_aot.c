@@ -0,0 +1,125 @@
+#include "pvm_aot.h"
+#include "pvm_internal.h"
+
+#ifndef section_pvm_aot
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_aot __attribute__((section(".pvm_aot")))
+#else
+#define section_pvm_aot
+#endif
+#endif
+
+/// \brief Checks if the native code was translated from a PVM executable.
+///
+/// \param[in] aot The native code.
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first.
+///
+/// \return Non-zero if the native code may run the executable.
+int section_pvm_aot pvm_aot_check(const pvm_aot_t *aot, const pvm_exe_t *exe) {
+	return aot->functions_count == pvm_functions_count(exe) + 1u && aot->hash == pvm_exe_hash(exe);
+}
+
+/// \brief Executes the PVM executable by its native code while the budget lasts.
+///
+/// \param[in,out] vm The PVM instance running the executable the native code was translated from, see `pvm_aot_check()`.
+/// \param[in] aot The native code.
+/// \param[in,out] budget The maximum number of instructions to execute, receives the unspent part of it.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details The native code of the current function continues until it returns, and then that of its caller. What the
+/// native code leaves to the interpreter is executed by `pvm_run_budget()`, either a single instruction spending its own
+/// cost or the rest of the budget, which stops at the instruction failing or putting the PVM asleep.
+pvm_errno_t section_pvm_aot pvm_aot_run(pvm_t *vm, const pvm_aot_t *aot, uint32_t *const budget) {
+	pvm_errno_t errno = PVM_NO_ERROR;
+	#ifdef PVM_PROFILE
+	if (vm->persist.profile) return pvm_run_budget(vm, budget);
+	#endif
+	#ifdef PVM_PREPARE
+	if (vm->persist.prepared) return pvm_run_budget(vm, budget);
+	#endif
+	#ifdef PVM_TRACE
+	if (vm->persist.trace) return pvm_run_budget(vm, budget);
+	#endif
+	#ifdef PVM_SWAP
+	// the native code belongs to a single executable, instances swapping images are interpreted
+	if (vm->persist.swap) return pvm_run_budget(vm, budget);
+	#endif
+
+	// a suspended built-in function has not completed yet
+	if (vm->waiting) return PVM_NO_ERROR;
+	// check SLP timeout, it is not checked again by the interpreter
+	if (vm->timer) {
+		const uint32_t d = pvm_now(vm) - vm->timer;
+		if (d < vm->timeout) return PVM_NO_ERROR;
+		vm->timer = 0;
+	}
+
+	uint32_t left = *budget;
+	while (left) {
+		// main() is the first one, functions follow by their index
+		size_t function = 0;
+		if (vm->call_top) function = vm->call_top > pvm_call_stack_size(vm) ? SIZE_MAX : vm->call_stack[vm->call_top - 1].function_index + 1u;
+		pvm_aot_f *const native = function < aot->functions_count ? aot->functions[function] : NULL;
+		const enum pvm_aot_exit exit = native ? native(vm, &left) : PVM_AOT_INTERPRET;
+		if (exit == PVM_AOT_STEP) {
+			#ifdef PVM_CYCLES
+			const uint32_t cost = vm->pc < vm->persist.image->code_size ? pvm_op_cycles(vm->persist.image->code[vm->pc]) : 1;
+			#else
+			const uint32_t cost = 1;
+			#endif
+			uint32_t step = left < cost ? left : cost;
+			const uint32_t spent = step;
+			errno = pvm_run_budget(vm, &step);
+			left -= spent - step;
+		}
+		else if (exit == PVM_AOT_INTERPRET) {
+			errno = pvm_run_budget(vm, &left);
+		}
+		// a sleeping or waiting PVM yields the rest of the budget
+		if (errno || vm->timer || vm->waiting) break;
+	}
+	*budget = left;
+
+	return errno;
+}
+
+/// \brief Calls a built-in function from native code.
+///
+/// \param[in,out] vm The PVM instance with its state written back, the program counter following the CAL instruction.
+/// \param[in] index The index of the built-in function.
+/// \param[in,out] budget The budget of the run, the charge of the built-in function is spent from it.
+///
+/// \return PVM_NO_ERROR if the function was called, otherwise the error CAL raises, the instance is left intact then.
+///
+/// \details The call follows the call of a built-in function by CAL, including the number of variadic arguments taken
+/// from the data stack, so the native code may leave the failing call to the interpreter.
+pvm_errno_t section_pvm_aot pvm_aot_builtin(pvm_t *vm, const pvm_function_index_t index, uint32_t *const budget) {
+	// the budget is only charged with PVM_CYCLES
+	(void)budget;
+	const pvm_function_t *const fun = &vm->persist.image->functions[index];
+	pvm_data_stack_t top = vm->data_top;
+	if (vm->call_top >= pvm_call_stack_size(vm)) return PVM_CALL_STACK_OVERFLOW;
+	size_t args_size = fun->arguments_count;
+	if (fun->is_variadic) {
+		if (!top) return PVM_DATA_STACK_UNDERFLOW;
+		const int32_t variadic_size = pvm_data_expand(vm->data_stack[--top]);
+		if (variadic_size < 0 || (args_size += variadic_size) > 0xFF) return PVM_VARIADIC_SIZE;
+	}
+	if (top < args_size) return PVM_ARG_OUT_OF_STACK;
+	const pvm_data_stack_t stack_rest = pvm_data_stack_size(vm) - top;
+	if (stack_rest < fun->variables_count) return PVM_VAR_OUT_OF_STACK;
+	if (stack_rest < fun->returns_count) return PVM_RETURN_OUT_OF_STACK;
+	if (fun->address >= pvm_vm_builtins_size(vm)) return PVM_BUILTIN_NO_FUNCTION;
+	const pvm_data_stack_t call_stack_start = top - args_size;
+	pvm_builtin_call(vm, fun->address, vm->data_stack + call_stack_start, args_size, fun->returns_count);
+	if (vm->waiting) vm->waiting = PVM_WAITING | fun->returns_count;
+	vm->data_top = call_stack_start + fun->returns_count;
+	pvm_spend_charge(vm, *budget);
+	return PVM_NO_ERROR;
+}
+
+/// \brief Raises a value to a power for native code, see the PWR instruction.
+pvm_data_t section_pvm_aot pvm_aot_power(const pvm_data_t base, const pvm_data_t exponent) {
+	return pvm_power(base, exponent);
+}
@@ -0,0 +1,95 @@
+#ifndef PVM_PVM_AOT_H
+#define PVM_PVM_AOT_H
+
+#include "pvm.h"
+
+/// \brief Enumerates how the native code of a function hands the execution back, see `pvm_aot_f`.
+enum pvm_aot_exit {
+	/// \brief The function has returned, the native code of its caller continues.
+	PVM_AOT_RETURN = 0,
+	/// \brief A built-in function has suspended the PVM, the run stops.
+	PVM_AOT_YIELD,
+	/// \brief The instruction at the program counter lays within a native block, it is interpreted on its own.
+	PVM_AOT_STEP,
+	/// \brief The instruction at the program counter needs the checks of the interpreter, e.g. it fails or puts the PVM
+	/// asleep, so the rest of the budget is interpreted.
+	PVM_AOT_INTERPRET
+};
+
+/// \brief Defines the signature of the native code of main() or of a user function, see `pvm_aot_t`.
+///
+/// \param[in,out] vm The PVM instance, the function is the current one of its call stack.
+/// \param[in,out] budget The budget of the run, receives the unspent part of it.
+///
+/// \return How the native code has left the function.
+///
+/// \details The native code resumes the function at the program counter of the instance, keeping the data stack of
+/// its frame in locals, and writes them back when it calls a function or leaves. Calls of user functions call their
+/// native code directly, so the nested calls return at once when the callee leaves otherwise than returning.
+typedef enum pvm_aot_exit(pvm_aot_f(pvm_t *vm, uint32_t *budget));
+
+/// \brief Represents the native code translated from a PVM executable by the `pvm-aot` tool.
+///
+/// \details The native code follows the verified bytecode block by block, a block being the straight code between two
+/// jump targets, calls or the instructions which leave the block. A block runs natively only when the budget affords the
+/// whole of it, every other instruction is executed by the interpreter from the very same state of the instance, so
+/// errors, sleeping, waiting, budgets and cycles stay exactly as when the executable is interpreted.
+typedef struct pvm_aot {
+	/// \brief The hash of the executable the native code was translated from, see `pvm_exe_hash()`.
+	uint32_t hash;
+	/// \brief The native code of main() followed by that of every function by its index, NULL for built-in functions.
+	pvm_aot_f *const *functions;
+	/// \brief The number of entries of `functions`.
+	size_t functions_count;
+} pvm_aot_t;
+
+/// \brief Spends the cost of a native block from the budget.
+///
+/// \param[in] instructions The number of the instructions of the block.
+/// \param[in] cycles The cycles of the instructions of the block, see `PVM_CYCLES`.
+#ifdef PVM_CYCLES
+#define PVM_AOT_COST(instructions, cycles) (cycles)
+/// \brief Spends the cycles of the slots a call initializes or a return moves, the budget is exhausted rather than wrapped.
+#define pvm_aot_charge(budget, slots) ((budget) = (budget) > (slots) * PVM_CYCLES_SLOT ? (budget) - (slots) * PVM_CYCLES_SLOT : 0)
+#else
+#define PVM_AOT_COST(instructions, cycles) (instructions)
+#define pvm_aot_charge(budget, slots) ((void)(budget))
+#endif
+
+/// \brief Checks if the native code was translated from a PVM executable.
+///
+/// \param[in] aot The native code.
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first.
+///
+/// \return Non-zero if the native code may run the executable.
+int pvm_aot_check(const pvm_aot_t *aot, const pvm_exe_t *exe);
+
+/// \brief Executes the PVM executable by its native code while the budget lasts.
+///
+/// \param[in,out] vm The PVM instance running the executable the native code was translated from, see `pvm_aot_check()`.
+/// \param[in] aot The native code.
+/// \param[in,out] budget The maximum number of instructions to execute, receives the unspent part of it.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details This function is `pvm_run_budget()` executing the native code of the current function as long as it may,
+/// and the interpreter otherwise. Both share the state of the instance, so it may be snapshotted, restored and run by
+/// `pvm_run()` in between.
+///
+/// \note Instances with a profile, a trace or prepared code assigned are interpreted, as the native code neither counts
+/// nor records its instructions and does not fuse them the way the prepared code does.
+pvm_errno_t pvm_aot_run(pvm_t *vm, const pvm_aot_t *aot, uint32_t *budget);
+
+/// \brief Calls a built-in function from native code.
+///
+/// \param[in,out] vm The PVM instance with its state written back, the program counter following the CAL instruction.
+/// \param[in] index The index of the built-in function.
+/// \param[in,out] budget The budget of the run, the charge of the built-in function is spent from it.
+///
+/// \return PVM_NO_ERROR if the function was called, otherwise the error CAL raises, the instance is left intact then.
+pvm_errno_t pvm_aot_builtin(pvm_t *vm, pvm_function_index_t index, uint32_t *budget);
+
+/// \brief Raises a value to a power for native code, see the PWR instruction.
+pvm_data_t pvm_aot_power(pvm_data_t base, pvm_data_t exponent);
+
+#endif
@@ -0,0 +1,849 @@
+// The body of the threaded engine, this header is not installed. pvm.c includes it once for every engine variant
+// defining PVM_ENGINE as the name of the function and PVM_VERIFIED for the variant running verified prepared code.
+
+/// \brief Executes up to a given number of instructions in the PVM.
+///
+/// \param[in,out] vm The PVM instance which SLP timeout has already elapsed.
+/// \param[in,out] left The maximum number of instructions to execute, receives the unspent part of it.
+///
+/// \return PVM_NO_ERROR if the instructions were executed successfully, otherwise an error code.
+///
+/// \details Every opcode is dispatched through a 256-entry table directly to its handler, either by computed goto or by
+/// a dense switch. The program counter, the code pointer and the data stack top are kept in locals for the whole run and
+/// written back into the instance upon return. The run stops early when an error occurs or an `SLP` instruction puts the
+/// PVM asleep.
+///
+/// \details The verified variant executes prepared code only. The verifier has proven the stack depth of every
+/// instruction within its frame, the jump targets and the variable indices, so pushes, pops and variable accesses go
+/// unchecked and the program counter is checked once per run. Instead, every call checks that the whole frame of the
+/// called function fits into the data stack.
+static pvm_errno_t section_pvm_core PVM_ENGINE(pvm_t *vm, uint32_t *const left) {
+	register pvm_errno_t errno = PVM_NO_ERROR;
+	uint32_t budget = *left;
+	int32_t value, second, third, param;
+	pvm_op_t op;
+
+	// decode executable header once per run
+	#ifndef PVM_VERIFIED
+	const pvm_op_t *const code = vm->persist.image->code;
+	#endif
+	const size_t code_size = vm->persist.image->code_size;
+	pvm_address_t pc = vm->pc;
+	pvm_data_stack_t top = vm->data_top;
+	const pvm_data_stack_t stack_size = pvm_data_stack_size(vm);
+	// the top of the data stack is cached here, the instance holds only the values beneath it until the cache is stored;
+	// popped values are still written back, so the slots above the top hold what op by op execution leaves there for
+	// the variables and the built-in functions which read them
+	pvm_data_t tos = top ? vm->data_stack[top - 1] : 0;
+
+	#define pvm_tos_store() if (top) vm->data_stack[top - 1] = tos
+	#define pvm_tos_load() if (top) tos = vm->data_stack[top - 1]
+	// access a slot of the data stack which may be the cached top
+	#define pvm_load(index) pvm_data_expand((index) == top - 1 ? tos : vm->data_stack[index])
+	#define pvm_store(index, data) \
+		if ((index) == top - 1) tos = (data); \
+		else vm->data_stack[index] = (data)
+	#ifdef PVM_DEBUG
+	#define pvm_debug_spill() pvm_tos_store(); pvm_spill(vm)
+	#else
+	#define pvm_debug_spill()
+	#endif
+	#ifdef PVM_VERIFIED
+	// the frame of the running function, its variables are addressed directly
+	pvm_data_stack_t base = pvm_current_variables_start(vm);
+	#define pvm_pop(data) \
+		(data) = pvm_data_expand(tos); \
+		vm->data_stack[top - 1] = tos; \
+		if (--top) tos = vm->data_stack[top - 1]
+	#define pvm_push(data) \
+		pvm_tos_store(); \
+		tos = (data); \
+		++top
+	// take the two values of a binary operation, the result replaces them in the cached top
+	#define pvm_pop2() \
+		value = pvm_data_expand(tos); \
+		second = pvm_data_expand(vm->data_stack[top - 2]); \
+		vm->data_stack[top - 1] = tos; \
+		--top
+	// take the value of a unary operation, the result replaces it in the cached top
+	#define pvm_peek() value = pvm_data_expand(tos)
+	#define pvm_room()
+	#define pvm_scope(index) ((index) += base)
+	// the frame of a called function must fit into the data stack as the pushes within it are unchecked
+	#define pvm_frame(index) \
+		base = pvm_current_variables_start(vm); \
+		if (base + prepared->frames[index] > stack_size) { \
+			errno = PVM_DATA_STACK_OVERFLOW; \
+			goto leave; \
+		}
+	#define pvm_fused_room(n)
+	#define pvm_fused_var(index) (param = insn->var[index] + base)
+	#define pvm_fetch() \
+		if (!budget) goto leave; \
+		--budget; \
+		pvm_debug_spill(); \
+		p_begin(vm); \
+		pvm_profile_op(vm, pc); \
+		pvm_trace_op(vm, pc, top ? tos : 0)
+	if (pc >= code_size) {
+		errno = PVM_PC_OVERRUN;
+		goto leave;
+	}
+	#else
+	#define pvm_pop(data) \
+		if (!top) { \
+			errno = PVM_DATA_STACK_UNDERFLOW; \
+			goto leave; \
+		} \
+		(data) = pvm_data_expand(tos); \
+		vm->data_stack[top - 1] = tos; \
+		if (--top) tos = vm->data_stack[top - 1]
+	#define pvm_push(data) \
+		if (top >= stack_size) { \
+			errno = PVM_DATA_STACK_OVERFLOW; \
+			goto leave; \
+		} \
+		pvm_tos_store(); \
+		tos = (data); \
+		++top
+	// a missing second value leaves the data stack empty just like two pops in a row
+	#define pvm_pop2() \
+		if (top < 2) { \
+			pvm_tos_store(); \
+			top = 0; \
+			errno = PVM_DATA_STACK_UNDERFLOW; \
+			goto leave; \
+		} \
+		value = pvm_data_expand(tos); \
+		second = pvm_data_expand(vm->data_stack[top - 2]); \
+		vm->data_stack[top - 1] = tos; \
+		--top
+	#define pvm_peek() \
+		if (!top) { \
+			errno = PVM_DATA_STACK_UNDERFLOW; \
+			goto leave; \
+		} \
+		value = pvm_data_expand(tos)
+	#define pvm_room() \
+		if (top >= stack_size) { \
+			errno = PVM_DATA_STACK_OVERFLOW; \
+			goto leave; \
+		}
+	#define pvm_scope(index) if ((errno = pvm_variable(vm, &(index)))) goto leave
+	#define pvm_frame(index)
+	// fused literals and superinstructions fall back to their original sequence to raise its errors exactly where they
+	// occur
+	#define pvm_fused_room(n) if (top > stack_size - (n)) goto unfused
+	#define pvm_fused_var(index) \
+		param = insn->var[index]; \
+		if (pvm_variable(vm, &param)) goto unfused
+	// check for the next instruction leaving when the budget is exhausted
+	#define pvm_fetch() \
+		if (!budget) goto leave; \
+		--budget; \
+		if (pc >= code_size) { \
+			errno = PVM_PC_OVERRUN; \
+			goto leave; \
+		} \
+		pvm_debug_spill(); \
+		p_begin(vm); \
+		pvm_profile_op(vm, pc); \
+		pvm_trace_op(vm, pc, top ? tos : 0)
+	#endif
+	// a backward jump or branch, or a return, into main() is a safe point to swap the image, see pvm_swap_due()
+	#define pvm_swap_point(backward) \
+		if ((backward) && pvm_swap_due(vm, top)) { \
+			pvm_tos_store(); \
+			pvm_swap_spill(vm); \
+			pvm_tos_load(); \
+			goto leave; \
+		}
+	// integral operand of the opcode, overflowed values are taken from the stack
+	#define pvm_param() \
+		param = op & PVM_INTEGRAL_OP_MASK; \
+		if (param == PVM_INTEGRAL_OP_MASK) { \
+			pvm_pop(param); \
+			if (param > 0) param += PVM_INTEGRAL_OP_MASK; \
+		}
+
+	#ifdef PVM_PREPARE
+	// execute pre-decoded instructions when they were prepared from this very executable
+	const pvm_prepared_t *const prepared = vm->persist.prepared;
+	#ifdef PVM_VERIFIED
+	const pvm_insn_t *const insns = prepared->insn;
+	#else
+	const pvm_insn_t *const insns = prepared && prepared->exe == vm->persist.image->exe ? prepared->insn : NULL;
+	#endif
+	const pvm_insn_t *insn = NULL;
+	#endif
+
+	#ifdef PVM_COMPUTED_GOTO
+	#if defined(PVM_VERIFIED)
+	static const void *const handlers[] = { PVM_HANDLERS(pvm_handler_label) };
+	#define pvm_dispatch() \
+		insn = &insns[pc]; \
+		pc = insn->next; \
+		op = insn->op; \
+		pvm_spend_insn(budget, insn); \
+		goto *handlers[insn->handler]
+	#elif defined(PVM_PREPARE)
+	static const void *const dispatch[256] = { PVM_OPCODES(pvm_handler_label) };
+	static const void *const handlers[] = { PVM_HANDLERS(pvm_handler_label) };
+	#define pvm_dispatch() \
+		if (insns) { \
+			insn = &insns[pc]; \
+			pc = insn->next; \
+			op = insn->op; \
+			pvm_spend_insn(budget, insn); \
+			goto *handlers[insn->handler]; \
+		} \
+		op = code[pc++]; \
+		pvm_spend_op(budget, op); \
+		goto *dispatch[op]
+	#else
+	static const void *const dispatch[256] = { PVM_OPCODES(pvm_handler_label) };
+	#define pvm_dispatch() \
+		op = code[pc++]; \
+		pvm_spend_op(budget, op); \
+		goto *dispatch[op]
+	#endif
+	#define pvm_next() \
+		pvm_debug_spill(); \
+		p_end(vm); \
+		pvm_fetch(); \
+		pvm_dispatch()
+
+	pvm_fetch();
+	pvm_dispatch();
+	{
+	#else
+	#define pvm_next() \
+		pvm_debug_spill(); \
+		p_end(vm); \
+		continue
+
+	for (;;) {
+		pvm_fetch();
+		#if defined(PVM_VERIFIED)
+		insn = &insns[pc];
+		pc = insn->next;
+		op = insn->op;
+		pvm_spend_insn(budget, insn);
+		switch (insn->handler) {
+		#elif defined(PVM_PREPARE)
+		uint_fast8_t handler;
+		if (insns) {
+			insn = &insns[pc];
+			pc = insn->next;
+			op = insn->op;
+			pvm_spend_insn(budget, insn);
+			handler = insn->handler;
+		}
+		else {
+			op = code[pc++];
+			pvm_spend_op(budget, op);
+			handler = pvm_handlers[op];
+		}
+	dispatch_handler:
+		switch (handler) {
+		#else
+		op = code[pc++];
+		pvm_spend_op(budget, op);
+		switch (pvm_handlers[op]) {
+		#endif
+	#endif
+
+		PVM_TARGET(PSH)
+			value = op & 0x7F;
+			#ifndef PVM_VERIFIED
+			// verified code has its chains folded upon preparation, a full stack fails the PSH before the chain is spent
+			pvm_room();
+			pvm_fold_psc(vm, code, code_size, pc, value, budget);
+			#endif
+			p_psh(value);
+		push_value:
+			pvm_push(value);
+			pvm_next();
+		set_value:
+			// the result replaces the top of the data stack
+			tos = value;
+			pvm_next();
+
+		PVM_TARGET(PSC)
+			p_s("PSC");
+			pvm_peek();
+			value <<= 5;
+			value |= op & 0x1F;
+			goto set_value;
+
+		PVM_TARGET(BZE)
+			pvm_pop(value);
+			pvm_pop(second);
+			p_s("BZ*");
+			if (second == 0) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BNZ)
+			pvm_pop(value);
+			pvm_pop(second);
+			p_s("BN*");
+			if (second) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BEQ)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BZ*");
+			if (pvm_difference(second, third) == 0) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BNE)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BN*");
+			if (pvm_difference(second, third)) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BGT)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BGT");
+			if (pvm_difference(second, third) > 0) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BLT)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BLT");
+			if (pvm_difference(second, third) < 0) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BGE)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BGE");
+			if (pvm_difference(second, third) >= 0) goto branch;
+			goto no_branch;
+
+		PVM_TARGET(BLE)
+			pvm_pop(value);
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BLE");
+			if (pvm_difference(second, third) <= 0) goto branch;
+		no_branch:
+			p(" x");
+			pvm_next();
+		branch:
+			pc += value + 1;
+			p_pc(pc);
+			pvm_swap_point(value < 0);
+			pvm_next();
+
+		PVM_TARGET(ADD)
+			pvm_pop2();
+			p_s("ADD");
+			value += second;
+			goto set_value;
+
+		PVM_TARGET(SUB)
+			pvm_pop2();
+			p_s("SUB");
+			value -= second;
+			goto set_value;
+
+		PVM_TARGET(MUL)
+			pvm_pop2();
+			p_s("MUL");
+			value *= second;
+			goto set_value;
+
+		PVM_TARGET(DIV)
+			pvm_pop2();
+			p_s("DIV");
+			value /= second;
+			goto set_value;
+
+		PVM_TARGET(PWR)
+			pvm_pop2();
+			p_s("PWR");
+			value = pvm_power(value, second);
+			goto set_value;
+
+		PVM_TARGET(AND)
+			pvm_pop2();
+			p_s("AND");
+			value &= second;
+			goto set_value;
+
+		PVM_TARGET(IOR)
+			pvm_pop2();
+			p_s("IOR");
+			value |= second;
+			goto set_value;
+
+		PVM_TARGET(XOR)
+			pvm_pop2();
+			p_s("XOR");
+			value ^= second;
+			goto set_value;
+
+		PVM_TARGET(SKZ)
+		PVM_TARGET(SNZ)
+		PVM_TARGET(SKN)
+		PVM_TARGET(SNN)
+			pvm_pop(value);
+			p_s("SK*");
+			if (pvm_skip(op, value)) {
+				// every instruction takes a single byte, skips are never fused so the next one follows right away
+				++pc;
+				p_pc(pc);
+			}
+			pvm_next();
+
+		PVM_TARGET(SLP)
+			// pseudo function with one parameter
+			pvm_pop(value);
+			vm->timer = pvm_now(vm);
+			vm->timeout = value;
+			p_slp(value);
+			pvm_debug_spill();
+			p_end(vm);
+			// a sleeping PVM yields the rest of the budget
+			goto leave;
+
+		PVM_TARGET(RET)
+			p_s("RET");
+			pvm_tos_store();
+			pvm_spill(vm);
+			errno = pvm_return(vm);
+			pvm_fill(vm);
+			pvm_spend_charge(vm, budget);
+			pvm_tos_load();
+			if (errno) goto leave;
+			pvm_swap_point(1);
+			#ifdef PVM_VERIFIED
+			base = pvm_current_variables_start(vm);
+			#endif
+			pvm_next();
+
+		PVM_TARGET(LDC)
+			pvm_pop(value);
+			if ((errno = pvm_constant(vm, &value))) goto leave;
+			goto push_value;
+
+		PVM_TARGET(JMB)
+			pvm_pop(value);
+			p_s("JMB");
+			// JMB is the same as NEG followed JMP
+			param = -value;
+			goto jump;
+
+		PVM_TARGET(NEG)
+			pvm_peek();
+			p_s("NEG");
+			value = -value;
+			goto set_value;
+
+		PVM_TARGET(INV)
+			pvm_peek();
+			p_s("INV");
+			value = ~value;
+			goto set_value;
+
+		PVM_TARGET(INC)
+			pvm_peek();
+			p_s("INC");
+			++value;
+			goto set_value;
+
+		PVM_TARGET(DEC)
+			pvm_peek();
+			p_s("DEC");
+			--value;
+			goto set_value;
+
+		PVM_TARGET(POP)
+			p_pop(op & 3);
+			for (int i = (op & 3) + 1; i; i--) {
+				pvm_pop(value);
+			}
+			pvm_next();
+
+		PVM_TARGET(JMP)
+			pvm_param();
+			p_s("JMP");
+		jump:
+			if (param < 0) param -= 2;
+			pc += param + 1;
+			p_pc(pc);
+			pvm_swap_point(param < 0);
+			pvm_next();
+
+		PVM_TARGET(CAL)
+			pvm_param();
+			pvm_tos_store();
+			pvm_spill(vm);
+			errno = pvm_call(vm, param);
+			pvm_fill(vm);
+			pvm_spend_charge(vm, budget);
+			pvm_tos_load();
+			if (errno) goto leave;
+			// a waiting PVM yields the rest of the budget like a sleeping one
+			if (vm->waiting) goto leave;
+			pvm_frame(param);
+			pvm_next();
+
+		PVM_TARGET(LDV)
+			pvm_param();
+			pvm_scope(param);
+			p_ld("LDV", param, pvm_load(param));
+			pvm_push(pvm_load(param));
+			pvm_next();
+
+		PVM_TARGET(STV)
+			pvm_param();
+			pvm_scope(param);
+			pvm_pop(value);
+			p_stv(param, value);
+			pvm_store(param, value);
+			pvm_next();
+
+	#ifdef PVM_PREPARE
+		PVM_TARGET(LIT)
+			pvm_fused_room(1);
+			p_s("LIT");
+			value = insn->imm;
+			goto push_value;
+
+		PVM_TARGET(JMP_I)
+			p_s("JMP");
+			// the target is taken before the swap point, so an instance the swap does not move leaves at it
+			{
+				const int backward = insn->target < pc;
+				pc = insn->target;
+				p_pc(pc);
+				pvm_swap_point(backward);
+			}
+			pvm_next();
+
+		PVM_TARGET(JMB_I)
+			// the fused literal offset is popped at once, but it is still stored into its slot as the sequence does
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			p_s("JMB");
+			{
+				const int backward = insn->target < pc;
+				pc = insn->target;
+				p_pc(pc);
+				pvm_swap_point(backward);
+			}
+			pvm_next();
+
+		PVM_TARGET(CAL_I)
+			pvm_tos_store();
+			pvm_spill(vm);
+			errno = pvm_call_function(vm, insn->imm, insn->fun);
+			pvm_fill(vm);
+			pvm_spend_charge(vm, budget);
+			pvm_tos_load();
+			if (errno) goto leave;
+			// a waiting PVM yields the rest of the budget like a sleeping one
+			if (vm->waiting) goto leave;
+			pvm_frame(insn->imm);
+			pvm_next();
+
+		PVM_TARGET(LDV_I)
+			if (insn->op < PVM_OP_PSC) {
+				// the index fused from a literal is stored into its slot first, the variable may be that very slot
+				pvm_fused_room(1);
+				vm->data_stack[top] = insn->literal;
+			}
+			param = insn->imm;
+			pvm_scope(param);
+			p_ld("LDV", param, pvm_load(param));
+			pvm_push(pvm_load(param));
+			pvm_next();
+
+		PVM_TARGET(STV_I)
+			param = insn->imm;
+			pvm_scope(param);
+			pvm_pop(value);
+			p_stv(param, value);
+			pvm_store(param, value);
+			pvm_next();
+
+		PVM_TARGET(LDC_I)
+			// the constant replaces the fused literal index in its slot
+			pvm_fused_room(1);
+			p_s("LDC");
+			value = insn->imm;
+			goto push_value;
+
+		PVM_TARGET(BZE_I)
+			// the fused literal offset is stored into its slot and popped at once
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			p_s("BZ*");
+			if (second == 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BNZ_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			p_s("BN*");
+			if (second) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BEQ_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BZ*");
+			if (pvm_difference(second, third) == 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BNE_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BN*");
+			if (pvm_difference(second, third)) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BGT_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BGT");
+			if (pvm_difference(second, third) > 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BLT_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BLT");
+			if (pvm_difference(second, third) < 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BGE_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BGE");
+			if (pvm_difference(second, third) >= 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BLE_I)
+			pvm_fused_room(1);
+			vm->data_stack[top] = insn->imm;
+			pvm_pop(second);
+			pvm_pop(third);
+			p_s("BLE");
+			if (pvm_difference(second, third) <= 0) goto branch_insn;
+			goto no_branch;
+		branch_insn:
+			{
+				const int backward = insn->target < pc;
+				pc = insn->target;
+				p_pc(pc);
+				pvm_swap_point(backward);
+			}
+			pvm_next();
+
+		PVM_TARGET(ADD_VV_STV)
+			// every variable is resolved before the sequence falls back, then the values it pushes are stored into their
+			// slots in its order, a variable may be one of them
+			pvm_fused_room(2);
+			pvm_fused_var(2);
+			third = param;
+			pvm_fused_var(1);
+			second = param;
+			pvm_fused_var(0);
+			value = pvm_load(param);
+			vm->data_stack[top] = value;
+			second = pvm_load(second);
+			vm->data_stack[top + 1] = second;
+			value += second;
+			vm->data_stack[top] = value;
+			p_s("ADD");
+			p_stv(third, value);
+			pvm_store(third, value);
+			pvm_next();
+
+		PVM_TARGET(SUB_VV_STV)
+			pvm_fused_room(2);
+			pvm_fused_var(2);
+			third = param;
+			pvm_fused_var(1);
+			value = param;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top] = second;
+			value = pvm_load(value);
+			vm->data_stack[top + 1] = value;
+			value -= second;
+			vm->data_stack[top] = value;
+			p_s("SUB");
+			p_stv(third, value);
+			pvm_store(third, value);
+			pvm_next();
+
+		PVM_TARGET(INC_VAR)
+			pvm_fused_room(1);
+			pvm_fused_var(0);
+			p_s("INC");
+			value = pvm_load(param) + 1;
+			vm->data_stack[top] = value;
+			p_stv(param, value);
+			pvm_store(param, value);
+			pvm_next();
+
+		PVM_TARGET(DEC_VAR)
+			pvm_fused_room(1);
+			pvm_fused_var(0);
+			p_s("DEC");
+			value = pvm_load(param) - 1;
+			vm->data_stack[top] = value;
+			p_stv(param, value);
+			pvm_store(param, value);
+			pvm_next();
+
+		PVM_TARGET(BEQ_LV)
+			// the literal, the variable and the offset are stored into their slots and popped at once
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BZ*");
+			if (pvm_difference(second, third) == 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BNE_LV)
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BN*");
+			if (pvm_difference(second, third)) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BGT_LV)
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BGT");
+			if (pvm_difference(second, third) > 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BLT_LV)
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BLT");
+			if (pvm_difference(second, third) < 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BGE_LV)
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BGE");
+			if (pvm_difference(second, third) >= 0) goto branch_insn;
+			goto no_branch;
+
+		PVM_TARGET(BLE_LV)
+			pvm_fused_room(3);
+			vm->data_stack[top] = insn->imm;
+			pvm_fused_var(0);
+			second = pvm_load(param);
+			vm->data_stack[top + 1] = second;
+			vm->data_stack[top + 2] = insn->literal;
+			third = insn->imm;
+			p_s("BLE");
+			if (pvm_difference(second, third) <= 0) goto branch_insn;
+			goto no_branch;
+
+		#ifndef PVM_VERIFIED
+		unfused:
+			// execute the first opcode of the sequence on its own, the rest follows instruction by instruction
+			pc = insn - insns;
+			op = code[pc++];
+			#ifdef PVM_CYCLES
+			// the whole sequence was spent, only its first opcode runs now
+			budget += insn->cycles - pvm_op_cycles(op);
+			#endif
+			#ifdef PVM_COMPUTED_GOTO
+			goto *dispatch[op];
+			#else
+			handler = pvm_handlers[op];
+			goto dispatch_handler;
+			#endif
+		#endif
+	#endif
+
+	#ifndef PVM_COMPUTED_GOTO
+		}
+	#endif
+	}
+
+	leave:
+	pvm_tos_store();
+	pvm_spill(vm);
+	*left = budget;
+
+	return errno;
+}
+
+#undef pvm_debug_spill
+#undef pvm_tos_store
+#undef pvm_tos_load
+#undef pvm_load
+#undef pvm_store
+#undef pvm_pop
+#undef pvm_push
+#undef pvm_pop2
+#undef pvm_peek
+#undef pvm_room
+#undef pvm_scope
+#undef pvm_frame
+#undef pvm_fused_room
+#undef pvm_fused_var
+#undef pvm_fetch
+#undef pvm_param
+#undef pvm_swap_point
+#undef pvm_dispatch
+#undef pvm_next
+#undef PVM_ENGINE
+#undef PVM_VERIFIED
@@ -0,0 +1,374 @@
+#ifndef PVM_PVM_INTERNAL_H
+#define PVM_PVM_INTERNAL_H
+
+// Internal definitions shared by the modules of the PVM library, this header is not installed.
+
+#include "pvm.h"
+
+#define PVM_INTEGRAL_OP_MASK 0x0F
+
+// the clock and the built-in functions of an instance, either from its environment or the global ones
+#ifdef PVM_ENV
+#define pvm_now(vm) ((vm)->persist.env->tick)
+#define pvm_vm_builtins(vm) ((vm)->persist.env->builtins)
+#define pvm_vm_builtins_size(vm) ((vm)->persist.env->builtins_size)
+#else
+#define pvm_now(vm) now_ms()
+#define pvm_vm_builtins(vm) pvm_builtins
+#define pvm_vm_builtins_size(vm) pvm_builtins_size
+#endif
+
+#ifdef PVM_BUILTINS
+#ifdef PVM_ENV
+#error "PVM_BUILTINS dispatches the built-in functions at build time, so it cannot take them from the environment"
+#endif
+// the header listing the built-in functions known at build time as PVM_BUILTIN_LIST, see PVM_BUILTIN_ENUM()
+#include PVM_BUILTINS
+#endif
+
+#ifndef section_pvm_core
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_core __attribute__((section(".pvm_core")))
+#else
+#define section_pvm_core
+#endif
+#endif
+
+/// \brief Retrieves the wide header of a `PVM_EXE_V2` executable.
+#define pvm_exe_v2(exe) ((const pvm_exe_v2_t *)(exe))
+
+/// \brief Checks if the PVM executable has the wide header of `PVM_EXE_V2`.
+#define pvm_exe_wide(exe) (((exe)->vm_version & PVM_EXE_FORMAT) == PVM_EXE_V2)
+
+/// \brief Retrieves the size of the fixed header of the PVM executable.
+///
+/// \param[in] exe The PVM executable, only its `vm_version` is read.
+///
+/// \return The offset of the functions section, the compact one for unsupported versions.
+static inline size_t section_pvm_core pvm_exe_header_size(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? offsetof(pvm_exe_v2_t, functions) : offsetof(pvm_exe_t, functions);
+}
+
+/// \brief Retrieves the size of the variable fields of the PVM executable stored in its header.
+static inline uint32_t section_pvm_core pvm_exe_size(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? pvm_exe_v2(exe)->size : exe->size;
+}
+
+/// \brief Retrieves the number of functions defined in the PVM executable.
+static inline uint_fast16_t section_pvm_core pvm_functions_count(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? pvm_exe_v2(exe)->functions_count : exe->functions_count;
+}
+
+/// \brief Retrieves the number of constants defined in the PVM executable.
+static inline uint_fast16_t section_pvm_core pvm_constants_count(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? pvm_exe_v2(exe)->constants_count : exe->constants_count;
+}
+
+/// \brief Retrieves the number of main variables used by the PVM executable.
+static inline uint_fast8_t section_pvm_core pvm_main_variables_count(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? pvm_exe_v2(exe)->main_variables_count : exe->main_variables_count;
+}
+
+/// \brief Retrieves the pointer to the functions section of the PVM executable.
+///
+/// \param[in] exe The PVM executable.
+///
+/// \return A pointer to the function descriptors of the executable.
+///
+/// \details The functions section follows the header, whose size depends on the format of the executable.
+static inline const pvm_function_t section_pvm_core *pvm_functions(const pvm_exe_t *exe) {
+	return pvm_exe_wide(exe) ? pvm_exe_v2(exe)->functions : exe->functions;
+}
+
+/// \brief Retrieves the pointer to the constants section of the PVM executable.
+///
+/// \param[in] exe The PVM executable.
+///
+/// \return A pointer to the constants section of the executable.
+///
+/// \details This function calculates and returns the address of the constants section in the PVM executable.
+/// The constants section follows the functions section in the executable.
+static inline pvm_const_t section_pvm_core *pvm_constants(const pvm_exe_t *exe) {
+	return (pvm_const_t *)&pvm_functions(exe)[pvm_functions_count(exe)];
+}
+
+/// \brief Retrieves the pointer to the code section of the PVM executable.
+///
+/// \param[in] exe The PVM executable.
+///
+/// \return A pointer to the code section of the executable.
+///
+/// \details This function calculates and returns the address of the code section in the PVM executable.
+/// The code section follows the constants section in the executable.
+static inline pvm_op_t section_pvm_core *pvm_code(const pvm_exe_t *exe) {
+	return (pvm_op_t *)&pvm_constants(exe)[pvm_constants_count(exe)];
+}
+
+/// \brief Retrieves the size of the code section in the PVM executable.
+///
+/// \param[in] exe The PVM executable.
+///
+/// \return The size of the code section in bytes.
+///
+/// \details This function calculates and returns the size of the code section in the PVM executable.
+/// The code section size is determined by subtracting the size of the constants section from the total size of the executable.
+static inline size_t section_pvm_core pvm_code_size(const pvm_exe_t *exe) {
+	return pvm_exe_size(exe) - ((const uint8_t *)pvm_code(exe) - (const uint8_t *)pvm_functions(exe));
+}
+
+#ifdef PVM_BUILTINS
+#define pvm_builtin_call_case(function) case PVM_BUILTIN_##function: function(vm, arguments, args_size); return;
+#define pvm_builtin_value_case(function) \
+	case PVM_BUILTIN_##function: { \
+		const pvm_data_t result = function(vm, arguments); \
+		if (returns_count) arguments[0] = result; \
+		return; \
+	}
+
+/// \brief Calls a built-in function by its index.
+///
+/// \param[in,out] vm The PVM instance.
+/// \param[in] address The validated index of the built-in function.
+/// \param[in,out] arguments The arguments of the call, which also receive its return values.
+/// \param[in] args_size The number of the arguments.
+/// \param[in] returns_count The number of the return slots of the call.
+///
+/// \details The functions of `PVM_BUILTIN_LIST` are dispatched by a switch, so they are called directly, and inlined
+/// when its header defines them, rather than through the `pvm_builtins[]` table. Typed ones get their single result
+/// stored only when the call has a return slot for it.
+static inline section_pvm_core void pvm_builtin_call(pvm_t *vm, const pvm_address_t address, pvm_data_t arguments[], const pvm_data_stack_t args_size, const uint_fast8_t returns_count) {
+	switch (address) {
+		PVM_BUILTIN_LIST(pvm_builtin_call_case, pvm_builtin_value_case)
+		default: break;
+	}
+	pvm_builtins[address].func(vm, arguments, args_size);
+}
+#else
+#define pvm_builtin_call(vm, address, arguments, args_size, returns_count) \
+	pvm_vm_builtins(vm)[address].func(vm, arguments, args_size)
+#endif
+
+#ifdef PVM_PROFILE
+/// \brief Counts the instruction the PVM instance is about to execute.
+///
+/// \param[in] vm The PVM instance.
+/// \param[in] pc The address of the instruction.
+static inline void section_pvm_core pvm_profile_op(pvm_t *vm, const pvm_address_t pc) {
+	pvm_profile_t *const profile = vm->persist.profile;
+	if (!profile) return;
+	++profile->instructions;
+	++profile->opcodes[vm->persist.image->code[pc]];
+	if (pc < profile->pcs_size) ++profile->pcs[pc];
+	// main() is counted first, functions follow by their index
+	const size_t function = vm->call_top ? vm->call_stack[vm->call_top - 1].function_index + 1u : 0;
+	if (function < profile->functions_size) ++profile->functions[function].instructions;
+}
+
+/// \brief Gets the counters of a function called by the PVM instance.
+///
+/// \param[in] vm The PVM instance.
+/// \param[in] index The index of the function.
+///
+/// \return The counters or NULL if they are not profiled.
+static inline pvm_profile_function_t section_pvm_core *pvm_profile_function(pvm_t *vm, const int32_t index) {
+	pvm_profile_t *const profile = vm->persist.profile;
+	if (!profile || (size_t)index + 1u >= profile->functions_size) return NULL;
+	return &profile->functions[index + 1];
+}
+#else
+#define pvm_profile_op(vm, pc)
+#endif
+
+#ifdef PVM_TRACE
+/// \brief Records an instruction into a trace.
+///
+/// \param[in,out] trace The trace.
+/// \param[in] pc The address of the instruction.
+/// \param[in] op The opcode of the instruction.
+/// \param[in] top The value on the top of the data stack upon entering the instruction.
+static inline void section_pvm_core pvm_trace_record(pvm_trace_t *trace, const pvm_address_t pc, const pvm_op_t op, const pvm_data_t top) {
+	pvm_trace_record_t *const record = &trace->records[trace->head];
+	record->pc = pc;
+	record->op = op;
+	record->top = top;
+	if (++trace->head >= trace->size) trace->head = 0;
+	++trace->count;
+}
+
+/// \brief Records the instruction the PVM instance is about to execute.
+///
+/// \param[in] vm The PVM instance.
+/// \param[in] pc The address of the instruction.
+/// \param[in] top The value on the top of the data stack, the engines cache it in different places.
+static inline void section_pvm_core pvm_trace_op(pvm_t *vm, const pvm_address_t pc, const pvm_data_t top) {
+	pvm_trace_t *const trace = vm->persist.trace;
+	if (trace && trace->size) pvm_trace_record(trace, pc, vm->persist.image->code[pc], top);
+}
+#else
+#define pvm_trace_op(vm, pc, top)
+#endif
+
+#ifdef PVM_SWAP
+/// \brief Checks if the PVM instance is at a safe point to move to the image published by its swap.
+///
+/// \param[in] vm The PVM instance.
+/// \param[in] top The data stack top cached by the running engine.
+///
+/// \return Non-zero if the instance runs the previous image of its swap within main() with nothing but its variables
+/// on the data stack, so a backward jump or a return there may move it.
+static inline int section_pvm_core pvm_swap_due(const pvm_t *vm, const pvm_data_stack_t top) {
+	const pvm_swap_t *const swap = vm->persist.swap;
+	return swap && swap->previous == vm->persist.image && !vm->call_top && top == vm->persist.image->main_variables_count;
+}
+#else
+#define pvm_swap_due(vm, top) 0
+#define pvm_swap_take(vm) ((void)0)
+#endif
+
+#ifdef PVM_CYCLES
+/// \brief Looks up the cycle weight of an opcode.
+///
+/// \param[in] op The opcode.
+///
+/// \return The cycles of the instruction not including the slots charged by CAL and RET, see `PVM_CYCLES_SLOT`.
+static inline uint32_t section_pvm_core pvm_op_cycles(const pvm_op_t op) {
+	if (op < PVM_OP_BZE) return PVM_CYCLES_LITERAL;
+	if (op < PVM_OP_ADD) return PVM_CYCLES_BRANCH;
+	switch (op) {
+		case PVM_OP_MUL: return PVM_CYCLES_MUL;
+		case PVM_OP_DIV: return PVM_CYCLES_DIV;
+		case PVM_OP_PWR: return PVM_CYCLES_PWR;
+		case PVM_OP_SLP: return PVM_CYCLES_SLP;
+		case PVM_OP_RET: return PVM_CYCLES_RET;
+		case PVM_OP_LDC: return PVM_CYCLES_MEMORY;
+		case PVM_OP_SKZ:
+		case PVM_OP_SNZ:
+		case PVM_OP_SKN:
+		case PVM_OP_SNN:
+		case PVM_OP_JMB: return PVM_CYCLES_BRANCH;
+		default: break;
+	}
+	if (op < PVM_OP_JMP) return PVM_CYCLES_ALU;
+	switch (op & 0xF0) {
+		case PVM_OP_JMP: return PVM_CYCLES_BRANCH;
+		case PVM_OP_CAL: return PVM_CYCLES_CALL;
+		default: return PVM_CYCLES_MEMORY;
+	}
+}
+
+// every fetch spends a single cycle of the budget, the rest of the weight is spent once the opcode is known; the budget
+// is exhausted rather than wrapped around by the instruction which overruns it
+#define pvm_spend(budget, cycles) ((budget) = (budget) > (cycles) ? (budget) - (cycles) : 0)
+#define pvm_spend_op(budget, op) pvm_spend(budget, pvm_op_cycles(op) - 1)
+// spend the cycles charged by the call or the return which has just completed
+#define pvm_spend_charge(vm, budget) (pvm_spend(budget, (vm)->charge), (vm)->charge = 0)
+#else
+#define pvm_spend_op(budget, op)
+#define pvm_spend_charge(vm, budget)
+#endif
+
+#ifndef PVM_DEBUG
+/// \brief Folds the PSC chain following a PSH into the literal the PSH is about to push.
+///
+/// \details Every PSC of the chain still retires as an instruction of its own, so budgets, cycles, profiles and the
+/// program counter stay the same as when the chain is dispatched op by op, only the dispatches and the stack checks in
+/// between are saved. The chain stops at the end of the code and when the budget is exhausted, the next run continues it.
+/// The PSH checks the room for the literal before the chain is folded, so a full stack fails it right where the PSH
+/// does op by op.
+#define pvm_fold_psc(vm, code, code_size, pc, value, budget) \
+	while ((budget) && (pc) < (code_size) && ((code)[pc] & 0xE0) == PVM_OP_PSC) { \
+		--(budget); \
+		pvm_profile_op(vm, pc); \
+		pvm_trace_op(vm, pc, value); \
+		pvm_spend_op(budget, PVM_OP_PSC); \
+		(value) = (int32_t)((uint32_t)(value) << 5 | ((code)[(pc)++] & 0x1F)); \
+	}
+#else
+// every PSC is traced on its own
+#define pvm_fold_psc(vm, code, code_size, pc, value, budget)
+#endif
+
+/// \brief Tests the condition of SKZ, SNZ, SKN and SNN.
+///
+/// \param[in] op The skip opcode, bit 1 selects the sign test over the zero one and bit 0 negates the test.
+/// \param[in] value The value popped from the data stack.
+///
+/// \return Non-zero if the next instruction is skipped: SKZ on zero, SNZ on non-zero, SKN on a negative value and SNN
+/// on a non-negative one.
+static inline int section_pvm_core pvm_skip(const pvm_op_t op, const int32_t value) {
+	const int test = op & 0x02 ? value < 0 : value == 0;
+	return test ^ (op & 0x01);
+}
+
+/// \brief Expands the sign of a value taken from the PVM data stack.
+///
+/// \param[in] data The value stored in the data stack.
+///
+/// \return The value expanded to 32 bits.
+static inline section_pvm_core int32_t pvm_data_expand(const pvm_data_t data) {
+	int32_t value = data;
+	// expand sign for shorter stack types
+	#if PVM_DATA_SIGN > 0x80000000
+	if (value & PVM_DATA_SIGN) {
+		value |= (int32_t)PVM_DATA_SIGN;
+	}
+	#endif
+	return value;
+}
+
+/// \brief Wraps a value computed in 32 bits around the width of `pvm_data_t` the way storing it into the data stack does.
+///
+/// \param[in] value The value.
+///
+/// \return The value as it is loaded back from the data stack.
+static inline section_pvm_core int32_t pvm_data_wrap(const int32_t value) {
+	return pvm_data_expand((pvm_data_t)value);
+}
+
+/// \brief Calculates the difference BEQ to BLE test, it wraps around the width of `pvm_data_t` like SUB does.
+#define pvm_difference(second, third) pvm_data_wrap((int32_t)((uint32_t)(second) - (uint32_t)(third)))
+
+/// \brief Loads a constant from the constants section of the PVM executable expanding its sign.
+///
+/// \param[in] constants The constants section of the PVM executable.
+/// \param[in] index The validated constant index.
+///
+/// \return The constant value.
+static inline int32_t section_pvm_core pvm_constant_at(const pvm_const_t *constants, const uint_fast16_t index) {
+	int32_t constant = constants[index];
+	// expand sign for shorter stack types
+	#if PVM_CONST_SIGN > 0x80000000
+	if (constant & PVM_CONST_SIGN) {
+		constant |= (int32_t)PVM_CONST_SIGN;
+	}
+	#endif
+	return constant;
+}
+
+/// \brief Raises a value to a power wrapping around like repeated multiplication, executed by the PWR instruction.
+///
+/// \param[in] base The base.
+/// \param[in] exponent The exponent, non-positive ones yield 1.
+///
+/// \return The power truncated to the data type.
+///
+/// \details Exponentiation by squaring takes at most one step per exponent bit, so the cost of PWR is bounded
+/// regardless of its operands. The bases 0, 1 and -1 take no steps, and so does the rest of the exponent once the
+/// squared base wraps to 0, which happens within five steps to every even base.
+static inline pvm_data_t section_pvm_core pvm_power(const pvm_data_t base, pvm_data_t exponent) {
+	if (exponent <= 0) return 1;
+	if (base == 0 || base == 1) return base;
+	if (base == -1) return exponent & 1 ? -1 : 1;
+	// unsigned arithmetic wraps around as the repeated multiplication did
+	uint32_t result = 1, square = (uint32_t)base;
+	for (;;) {
+		if (exponent & 1) result *= square;
+		exponent >>= 1;
+		if (!exponent) break;
+		square *= square;
+		if (!square) return 0;
+	}
+	return (pvm_data_t)result;
+}
+
+#endif
@@ -0,0 +1,586 @@
+#include "pvm_internal.h"
+#include "pvm_lockstep.h"
+
+#ifndef section_pvm_lockstep
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_lockstep __attribute__((section(".pvm_lockstep")))
+#else
+#define section_pvm_lockstep
+#endif
+#endif
+
+/// \brief Represents a row of the data stack of a lockstep group, a slot of every lane.
+typedef pvm_data_t pvm_lockstep_row_t[PVM_LOCKSTEP_LANES];
+
+/// \brief Checks if a lane is in a mask of lanes.
+#define pvm_lockstep_in(mask, lane) (((mask) >> (lane)) & 1u)
+
+/// \brief Finds the first lane of a mask.
+///
+/// \param[in] mask The mask of lanes, not empty.
+///
+/// \return The index of the lowest lane in the mask.
+static inline section_pvm_lockstep uint_fast8_t pvm_lockstep_lead(uint32_t mask) {
+	uint_fast8_t lane = 0;
+	while (!(mask & 1u)) {
+		mask >>= 1;
+		++lane;
+	}
+	return lane;
+}
+
+/// \brief Checks if all lanes of a mask hold the same value in a row of the data stack.
+///
+/// \param[in] row The row of the data stack.
+/// \param[in] mask The mask of the lanes to compare, not empty.
+/// \param[out] value The value held by the lanes, expanded to 32 bits.
+///
+/// \return Non-zero if the value is the same in all the lanes.
+static inline section_pvm_lockstep int pvm_lockstep_uniform(const pvm_data_t row[], const uint32_t mask, int32_t *value) {
+	const pvm_data_t first = row[pvm_lockstep_lead(mask)];
+	uint32_t differ = 0;
+	// no early exit, so the comparison runs over the whole row at once
+	for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+		differ |= (row[lane] != first) & pvm_lockstep_in(mask, lane);
+	}
+	*value = pvm_data_expand(first);
+	return !differ;
+}
+
+/// \brief Stores a value into all lanes of a row of the data stack.
+static inline section_pvm_lockstep void pvm_lockstep_broadcast(pvm_data_t row[], const int32_t value) {
+	for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+		row[lane] = (pvm_data_t)value;
+	}
+}
+
+/// \brief Tests the condition of BZE, BNZ, BEQ, BNE, BGT, BLT, BGE and BLE the way the engines do.
+///
+/// \param[in] op The branch opcode.
+/// \param[in] second The tested value, the difference of the compared values for BEQ and beyond.
+///
+/// \return Non-zero if the branch is taken.
+static inline section_pvm_lockstep int pvm_lockstep_branch(const pvm_op_t op, const int32_t second) {
+	if (op & 0x04) {
+		if (op & 0x02) return op & 0x01 ? second <= 0 : second >= 0;
+		return op & 0x01 ? second < 0 : second > 0;
+	}
+	return op & 0x01 ? second != 0 : second == 0;
+}
+
+#ifdef PVM_PROFILE
+/// \brief Counts an instruction executed by the group in the profiles of its lanes, see `pvm_profile_op()`.
+///
+/// \param[in] group The lockstep group.
+/// \param[in] code The code section of the executable.
+/// \param[in] pc The address of the instruction.
+/// \param[in] call_top The call stack top the instruction was executed with.
+static section_pvm_lockstep void pvm_lockstep_profile(const pvm_lockstep_t *group, const pvm_op_t *code, const pvm_address_t pc, const pvm_call_stack_t call_top) {
+	// main() is counted first, functions follow by their index
+	const size_t function = call_top ? group->call_stack[call_top - 1].function_index + 1u : 0;
+	for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+		if (!pvm_lockstep_in(group->active, lane)) continue;
+		pvm_profile_t *const profile = group->lanes[lane]->persist.profile;
+		if (!profile) continue;
+		++profile->instructions;
+		++profile->opcodes[code[pc]];
+		if (pc < profile->pcs_size) ++profile->pcs[pc];
+		if (function < profile->functions_size) ++profile->functions[function].instructions;
+	}
+}
+#else
+#define pvm_lockstep_profile(group, code, pc, call_top)
+#endif
+
+#ifdef PVM_TRACE
+/// \brief Records an instruction executed by the group in the traces of its lanes, see `pvm_trace_op()`.
+///
+/// \param[in] group The lockstep group.
+/// \param[in] code The code section of the executable.
+/// \param[in] pc The address of the instruction.
+/// \param[in] row The values on the top of the data stack of the lanes upon entering the instruction, NULL if all lanes
+/// had the same one.
+/// \param[in] value The value on the top of the data stack of all lanes when `row` is NULL.
+static section_pvm_lockstep void pvm_lockstep_trace(const pvm_lockstep_t *group, const pvm_op_t *code, const pvm_address_t pc, const pvm_data_t *row, const pvm_data_t value) {
+	for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+		if (!pvm_lockstep_in(group->active, lane)) continue;
+		pvm_trace_t *const trace = group->lanes[lane]->persist.trace;
+		if (trace && trace->size) pvm_trace_record(trace, pc, code[pc], row ? row[lane] : value);
+	}
+}
+#else
+#define pvm_lockstep_trace(group, code, pc, row, value) ((void)0)
+#endif
+
+/// \brief Writes the state of a lane back into its instance.
+static section_pvm_lockstep void pvm_lockstep_store(const pvm_lockstep_t *group, const uint_fast8_t lane) {
+	pvm_t *const vm = group->lanes[lane];
+	vm->timer = group->timer;
+	vm->timeout = group->timeout;
+	vm->pc = group->pc;
+	vm->data_top = group->data_top;
+	vm->call_top = group->call_top;
+	for (pvm_call_stack_t i = 0; i < group->call_top; ++i) {
+		vm->call_stack[i] = group->call_stack[i];
+	}
+	for (pvm_data_stack_t i = 0; i < group->data_top; ++i) {
+		vm->data_stack[i] = group->data_stack[i][lane];
+	}
+}
+
+/// \brief Reads the data stack of a lane from its instance, the rest of the state is shared by the group.
+static section_pvm_lockstep void pvm_lockstep_load(pvm_lockstep_t *group, const uint_fast8_t lane) {
+	const pvm_t *const vm = group->lanes[lane];
+	for (pvm_data_stack_t i = 0; i < group->data_top; ++i) {
+		group->data_stack[i][lane] = vm->data_stack[i];
+	}
+}
+
+/// \brief Takes the shared state of the group from an instance.
+static section_pvm_lockstep void pvm_lockstep_adopt(pvm_lockstep_t *group, const pvm_t *vm) {
+	group->timer = vm->timer;
+	group->timeout = vm->timeout;
+	group->pc = vm->pc;
+	group->data_top = vm->data_top;
+	group->call_top = vm->call_top;
+	for (pvm_call_stack_t i = 0; i < vm->call_top; ++i) {
+		group->call_stack[i] = vm->call_stack[i];
+	}
+}
+
+/// \brief Checks if two instances are in the same state apart from their data.
+static section_pvm_lockstep int pvm_lockstep_same(const pvm_t *a, const pvm_t *b) {
+	if (a->pc != b->pc || a->data_top != b->data_top || a->call_top != b->call_top) return 0;
+	if (a->timer != b->timer || a->timeout != b->timeout) return 0;
+	for (pvm_call_stack_t i = 0; i < a->call_top; ++i) {
+		const struct pvm_call_stack *const x = &a->call_stack[i], *const y = &b->call_stack[i];
+		if (x->return_address != y->return_address || x->variables_start != y->variables_start) return 0;
+		if (x->arguments_count != y->arguments_count || x->function_index != y->function_index) return 0;
+	}
+	return 1;
+}
+
+#ifdef PVM_SWAP
+/// \brief Checks if an instance is moving to the image published by its swap, which it does on its own.
+#define pvm_lockstep_moving(vm) ((vm)->persist.swap && (vm)->persist.swap->previous == (vm)->persist.image)
+#else
+#define pvm_lockstep_moving(vm) 0
+#endif
+
+/// \brief Checks if an instance is in a state the group can hold.
+static inline section_pvm_lockstep int pvm_lockstep_fits(const pvm_t *vm) {
+	return !pvm_lockstep_moving(vm) && !vm->waiting && vm->data_top <= pvm_data_stack_size(vm) && vm->call_top <= pvm_call_stack_size(vm);
+}
+
+/// \brief Executes the instruction at the program counter of the group by every lane on its own.
+///
+/// \param[in,out] group The lockstep group.
+///
+/// \return The mask of the lanes which left the group.
+///
+/// \details The lanes are written back and stepped by `pvm_op()`, so the instruction behaves exactly as without the
+/// group. The first lane which neither failed nor waits gives the new state of the group, the lanes ending up in the
+/// same state are read back, the others leave the group.
+static section_pvm_lockstep uint32_t pvm_lockstep_scalar(pvm_lockstep_t *group) {
+	const uint32_t active = group->active;
+	const pvm_t *reference = NULL;
+	for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+		if (!pvm_lockstep_in(active, lane)) continue;
+		pvm_t *const vm = group->lanes[lane];
+		pvm_lockstep_store(group, lane);
+		group->errors[lane] = pvm_op(vm);
+		if (!reference && !group->errors[lane] && pvm_lockstep_fits(vm)) reference = vm;
+	}
+	uint32_t stay = 0;
+	if (reference) {
+		pvm_lockstep_adopt(group, reference);
+		for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+			const pvm_t *const vm = group->lanes[lane];
+			if (!pvm_lockstep_in(active, lane) || group->errors[lane] || vm->waiting || !pvm_lockstep_same(vm, reference)) continue;
+			pvm_lockstep_load(group, lane);
+			stay |= 1u << lane;
+		}
+	}
+	group->active = stay;
+	return active & ~stay;
+}
+
+/// \brief Initializes a lockstep group with PVM instances.
+///
+/// \param[out] group The group to initialize.
+/// \param[in] vms The PVM instances, usually freshly reset with the same executable assigned.
+/// \param[in] count The number of PVM instances, at most `PVM_LOCKSTEP_LANES` are taken.
+///
+/// \details The group takes the state of the first instance. Instances in another state, running another image, with
+/// other stack sizes or waiting for a built-in function, are left out of the group and keep running on their own, see
+/// `active`.
+void section_pvm_lockstep pvm_lockstep_init(pvm_lockstep_t *group, pvm_t *const vms[], uint8_t count) {
+	if (count > PVM_LOCKSTEP_LANES) count = PVM_LOCKSTEP_LANES;
+	group->count = count;
+	group->active = 0;
+	const pvm_t *first = NULL;
+	for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+		group->lanes[lane] = lane < count ? vms[lane] : NULL;
+		group->errors[lane] = PVM_NO_ERROR;
+		if (lane >= count || !pvm_lockstep_fits(vms[lane])) continue;
+		if (!first) {
+			first = vms[lane];
+			pvm_lockstep_adopt(group, first);
+		}
+		else if (vms[lane]->persist.image != first->persist.image || !pvm_lockstep_same(vms[lane], first)) continue;
+		// the lanes share the bounds of their stacks as well
+		if (pvm_data_stack_size(vms[lane]) != pvm_data_stack_size(first) || pvm_call_stack_size(vms[lane]) != pvm_call_stack_size(first)) continue;
+		pvm_lockstep_load(group, lane);
+		group->active |= 1u << lane;
+	}
+}
+
+/// \brief Executes instructions in all lanes of the group while the budget lasts.
+///
+/// \param[in,out] group The lockstep group.
+/// \param[in,out] budget The maximum number of instructions, or cycles with `PVM_CYCLES`, to execute by every lane,
+/// receives the unspent part of it.
+///
+/// \return The mask of the lanes which left the group during the run.
+///
+/// \details The run follows `pvm_run_budget()` for every lane, a sleeping group leaves the budget untouched. A lane
+/// leaves the group when it diverges from the others, goes asleep or waits on its own, or stops with an error, which is
+/// stored in `errors`. Its instance holds its current state then, so the host continues it with `pvm_run()` unless it is
+/// stopped.
+uint32_t section_pvm_lockstep pvm_lockstep_run(pvm_lockstep_t *group, uint32_t *const budget) {
+	uint32_t split = 0;
+	if (!group->active) return 0;
+
+	// all lanes share the image and, with an environment, they should share the clock
+	const pvm_t *const lead = group->lanes[pvm_lockstep_lead(group->active)];
+	// the lanes leave the group for an image published meanwhile, they move at their own safe points
+	if (pvm_lockstep_moving(lead)) {
+		split = group->active;
+		pvm_lockstep_split(group, split);
+		return split;
+	}
+	if (group->timer) {
+		const uint32_t d = pvm_now(lead) - group->timer;
+		if (d < group->timeout) return 0;
+		group->timer = 0;
+	}
+
+	const pvm_image_t *const image = lead->persist.image;
+	const pvm_op_t *const code = image->code;
+	const size_t code_size = image->code_size;
+	pvm_lockstep_row_t *const data = group->data_stack;
+	pvm_address_t pc = group->pc;
+	pvm_data_stack_t top = group->data_top;
+	const pvm_data_stack_t data_size = pvm_data_stack_size(lead);
+	const pvm_call_stack_t call_size = pvm_call_stack_size(lead);
+	uint32_t left = *budget;
+
+	while (left) {
+		--left;
+		// the operands are peeked until the instruction is known to run in all lanes alike, then pc and top are
+		// committed, any other outcome runs the instruction by every lane on its own from the untouched state
+		const uint32_t active = group->active;
+		const pvm_call_stack_t call_top = group->call_top;
+		pvm_address_t next = pc + 1;
+		pvm_data_stack_t t = top;
+		int32_t value;
+		if (pc >= code_size) goto scalar;
+
+		const pvm_op_t op = code[pc];
+		pvm_spend_op(left, op);
+		#ifdef PVM_TRACE
+		// the instruction overwrites the operands, so the values it is entered with are taken aside for the trace
+		pvm_data_t entered[PVM_LOCKSTEP_LANES];
+		for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+			entered[lane] = t ? data[t - 1][lane] : 0;
+		}
+		#endif
+
+		if (op < PVM_OP_PSC) {
+			// PSH with the PSC chain following it folded, see pvm_fold_psc()
+			if (t >= data_size) goto scalar;
+			value = op & 0x7F;
+			// the chain is traced after the PSH starting it
+			pvm_lockstep_trace(group, code, pc, entered, 0);
+			while (left && next < code_size && (code[next] & 0xE0) == PVM_OP_PSC) {
+				--left;
+				pvm_lockstep_profile(group, code, next, call_top);
+				pvm_lockstep_trace(group, code, next, NULL, value);
+				pvm_spend_op(left, PVM_OP_PSC);
+				value = (int32_t)((uint32_t)value << 5 | (code[next++] & 0x1F));
+			}
+			pvm_lockstep_broadcast(data[t++], value);
+		}
+		else if (op < PVM_OP_BZE) {
+			// PSC
+			if (!t) goto scalar;
+			pvm_data_t *const row = data[t - 1];
+			for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+				row[lane] = (pvm_data_t)((uint32_t)pvm_data_expand(row[lane]) << 5 | (op & 0x1F));
+			}
+		}
+		else if (op < PVM_OP_ADD) {
+			// BZE, BNZ, BEQ, BNE, BGT, BLT, BGE, BLE branch alike in all lanes by the same offset
+			const uint_fast8_t operands = (op & 7) > 1 ? 3 : 2;
+			if (t < operands || !pvm_lockstep_uniform(data[t - 1], active, &value)) goto scalar;
+			const pvm_data_t *const second = data[t - 2], *const third = data[t - operands];
+			uint32_t taken = 0;
+			for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+				uint32_t test = (uint32_t)pvm_data_expand(second[lane]);
+				if (operands == 3) test -= (uint32_t)pvm_data_expand(third[lane]);
+				taken |= (uint32_t)pvm_lockstep_branch(op, pvm_data_wrap((int32_t)test)) << lane;
+			}
+			taken &= active;
+			if (taken && taken != active) goto scalar;
+			t -= operands;
+			if (taken) next += value + 1;
+		}
+		else if (op < PVM_OP_SKZ) {
+			// ADD, SUB, MUL, DIV, PWR, AND, IOR, XOR pop two values and push the result in their place
+			if (t < 2) goto scalar;
+			const pvm_data_t *const a = data[t - 1];
+			pvm_data_t *const b = data[t - 2];
+			switch (op) {
+				case PVM_OP_ADD:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)((uint32_t)pvm_data_expand(a[lane]) + (uint32_t)pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_SUB:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)((uint32_t)pvm_data_expand(a[lane]) - (uint32_t)pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_MUL:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)((uint32_t)pvm_data_expand(a[lane]) * (uint32_t)pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_DIV:
+					// a division without a result in some lane behaves as it does on its own
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						const int32_t divisor = pvm_data_expand(b[lane]);
+						if (pvm_lockstep_in(active, lane) && (!divisor || (divisor == -1 && pvm_data_expand(a[lane]) == INT32_MIN))) goto scalar;
+					}
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						if (pvm_lockstep_in(active, lane)) b[lane] = (pvm_data_t)(pvm_data_expand(a[lane]) / pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_PWR:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						if (pvm_lockstep_in(active, lane)) b[lane] = pvm_power(pvm_data_expand(a[lane]), pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_AND:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)(pvm_data_expand(a[lane]) & pvm_data_expand(b[lane]));
+					}
+					break;
+				case PVM_OP_IOR:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)(pvm_data_expand(a[lane]) | pvm_data_expand(b[lane]));
+					}
+					break;
+				default:
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						b[lane] = (pvm_data_t)(pvm_data_expand(a[lane]) ^ pvm_data_expand(b[lane]));
+					}
+					break;
+			}
+			--t;
+		}
+		else if (op < PVM_OP_SLP) {
+			// SKZ, SNZ, SKN, SNN skip alike in all lanes
+			if (!t) goto scalar;
+			const pvm_data_t *const row = data[--t];
+			uint32_t skip = 0;
+			for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+				skip |= (uint32_t)pvm_skip(op, pvm_data_expand(row[lane])) << lane;
+			}
+			skip &= active;
+			if (skip && skip != active) goto scalar;
+			if (skip) ++next;
+		}
+		else if (op == PVM_OP_SLP) {
+			// every lane reads the clock and goes asleep on its own, those sleeping alike stay in the group
+			goto scalar;
+		}
+		else if (op == PVM_OP_RET) {
+			// returning from main() and smashed stacks stop the lanes on their own
+			if (!call_top) goto scalar;
+			const struct pvm_call_stack *const call = &group->call_stack[call_top - 1];
+			const pvm_function_t *const fun = call->function;
+			const uint8_t returns_size = fun->returns_count;
+			const pvm_data_stack_t returns_start = t - returns_size;
+			if (call->variables_start + call->arguments_count + fun->variables_count != returns_start) goto scalar;
+			// move return values to the beginning of the function stack, row by row
+			for (uint8_t i = 0; i < returns_size; ++i) {
+				for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+					data[call->variables_start + i][lane] = data[returns_start + i][lane];
+				}
+			}
+			#ifdef PVM_CYCLES
+			pvm_spend(left, returns_size * PVM_CYCLES_SLOT);
+			#endif
+			t = call->variables_start + returns_size;
+			next = call->return_address;
+			--group->call_top;
+		}
+		else if (op == PVM_OP_LDC) {
+			if (!t) goto scalar;
+			pvm_data_t *const row = data[t - 1];
+			for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+				const int32_t index = pvm_data_expand(row[lane]);
+				if (pvm_lockstep_in(active, lane) && (index < 0 || index >= image->constants_count)) goto scalar;
+			}
+			for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+				if (pvm_lockstep_in(active, lane)) row[lane] = (pvm_data_t)pvm_constant_at(image->constants, pvm_data_expand(row[lane]));
+			}
+		}
+		else if (op == PVM_OP_JMB) {
+			// JMB is the same as NEG followed JMP
+			if (!t || !pvm_lockstep_uniform(data[t - 1], active, &value)) goto scalar;
+			--t;
+			value = -value;
+			if (value < 0) value -= 2;
+			next += value + 1;
+		}
+		else if (op < PVM_OP_JMP) {
+			if (op & 0x04) {
+				// POP
+				const uint_fast8_t count = (op & 3) + 1;
+				if (t < count) goto scalar;
+				t -= count;
+			}
+			else {
+				// NEG, INV, INC, DEC
+				if (!t) goto scalar;
+				pvm_data_t *const row = data[t - 1];
+				for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+					const uint32_t x = (uint32_t)pvm_data_expand(row[lane]);
+					switch (op & 3) {
+						case 0: row[lane] = (pvm_data_t)(0u - x); break;
+						case 1: row[lane] = (pvm_data_t)~x; break;
+						case 2: row[lane] = (pvm_data_t)(x + 1u); break;
+						default: row[lane] = (pvm_data_t)(x - 1u); break;
+					}
+				}
+			}
+		}
+		else {
+			// JMP, CAL, LDV, STV take the operand from the data stack when it overflows, the same in all lanes
+			value = op & PVM_INTEGRAL_OP_MASK;
+			if (value == PVM_INTEGRAL_OP_MASK) {
+				if (!t || !pvm_lockstep_uniform(data[t - 1], active, &value)) goto scalar;
+				--t;
+				// complete positive values
+				if (value > 0) value += PVM_INTEGRAL_OP_MASK;
+			}
+			if (op < PVM_OP_CAL) {
+				// JMP
+				if (value < 0) value -= 2;
+				next += value + 1;
+			}
+			else if (op < PVM_OP_LDV) {
+				// CAL of a function of the executable, built-in functions run in every lane on its own
+				if (value < 0 || value >= image->functions_count) goto scalar;
+				const pvm_function_t *const fun = &image->functions[value];
+				if (fun->is_built_in || call_top >= call_size) goto scalar;
+				size_t args_size = fun->arguments_count;
+				if (fun->is_variadic) {
+					int32_t variadic_size;
+					if (!t || !pvm_lockstep_uniform(data[t - 1], active, &variadic_size)) goto scalar;
+					--t;
+					if (variadic_size < 0 || (args_size += variadic_size) > 0xFF) goto scalar;
+				}
+				if (t < args_size) goto scalar;
+				const pvm_data_stack_t stack_rest = data_size - t;
+				if (stack_rest < fun->variables_count || stack_rest < fun->returns_count) goto scalar;
+				#ifdef PVM_PROFILE
+				for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+					if (!pvm_lockstep_in(active, lane)) continue;
+					pvm_profile_function_t *const counters = pvm_profile_function(group->lanes[lane], value);
+					if (counters) ++counters->calls;
+				}
+				#endif
+				struct pvm_call_stack *const call = &group->call_stack[group->call_top++];
+				call->function = fun;
+				call->function_index = value;
+				call->variables_start = t - args_size;
+				call->arguments_count = args_size;
+				call->return_address = next;
+				// initialize local variables with zeros
+				for (uint8_t i = 0; i < fun->variables_count; ++i) {
+					pvm_lockstep_broadcast(data[t++], 0);
+				}
+				#ifdef PVM_CYCLES
+				pvm_spend(left, fun->variables_count * PVM_CYCLES_SLOT);
+				#endif
+				next = fun->address;
+			}
+			else {
+				// LDV, STV resolve the variable in the current scope, see pvm_variable()
+				uint_fast8_t stack_size = image->main_variables_count;
+				pvm_data_stack_t start = 0;
+				if (call_top) {
+					const struct pvm_call_stack *const call = &group->call_stack[call_top - 1];
+					stack_size = call->function->arguments_count + call->function->variables_count;
+					start = call->variables_start;
+				}
+				if (value < 0 || value >= stack_size || (value += start) >= data_size) goto scalar;
+				if (op < PVM_OP_STV) {
+					// LDV
+					if (t >= data_size) goto scalar;
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						data[t][lane] = data[value][lane];
+					}
+					++t;
+				}
+				else {
+					// STV
+					if (!t) goto scalar;
+					--t;
+					for (uint_fast8_t lane = 0; lane < PVM_LOCKSTEP_LANES; ++lane) {
+						data[value][lane] = data[t][lane];
+					}
+				}
+			}
+		}
+
+		// the instruction ran in all lanes alike
+		pvm_lockstep_profile(group, code, pc, call_top);
+		if (op >= PVM_OP_PSC) pvm_lockstep_trace(group, code, pc, entered, 0);
+		pc = next;
+		top = t;
+		continue;
+
+		scalar:
+		group->pc = pc;
+		group->data_top = top;
+		split |= pvm_lockstep_scalar(group);
+		pc = group->pc;
+		top = group->data_top;
+		// a sleeping group yields the rest of the budget
+		if (!group->active || group->timer) break;
+	}
+
+	group->pc = pc;
+	group->data_top = top;
+	*budget = left;
+
+	return split;
+}
+
+/// \brief Writes the state of lanes back into their instances and removes them from the group.
+///
+/// \param[in,out] group The lockstep group, not running at the moment.
+/// \param[in] mask The mask of the lanes to split, lanes already out of the group are ignored.
+///
+/// \details The instances of the split lanes may then be run, snapshotted or dropped on their own.
+void section_pvm_lockstep pvm_lockstep_split(pvm_lockstep_t *group, uint32_t mask) {
+	mask &= group->active;
+	for (uint_fast8_t lane = 0; lane < group->count; ++lane) {
+		if (pvm_lockstep_in(mask, lane)) pvm_lockstep_store(group, lane);
+	}
+	group->active &= ~mask;
+}
@@ -0,0 +1,84 @@
+#ifndef PVM_PVM_LOCKSTEP_H
+#define PVM_PVM_LOCKSTEP_H
+
+#include "pvm.h"
+
+/// \brief The number of PVM instances a lockstep group executes side by side, at most 32.
+#ifndef PVM_LOCKSTEP_LANES
+#define PVM_LOCKSTEP_LANES 8
+#endif
+
+#if PVM_LOCKSTEP_LANES < 1 || PVM_LOCKSTEP_LANES > 32
+#error "PVM_LOCKSTEP_LANES must be within 1 and 32"
+#endif
+
+/// \brief Represents a group of PVM instances running the same executable in lockstep.
+///
+/// \details All instances of the group, its lanes, share the program counter, the stack tops and the call stack, only
+/// their data differs. The data stack is kept as a row of slots per depth with a column per lane, so every instruction
+/// is fetched and decoded once for the whole group and its arithmetic runs over a row at a time, which compilers turn
+/// into vector instructions. As soon as the lanes disagree on the path taken, e.g. a branch goes both ways, the
+/// instruction is executed by `pvm_op()` on every lane, and the lanes which end up in another state than the first one
+/// leave the group to run on their own. Built-in functions, `SLP` and failing instructions are executed the same way.
+///
+/// \note All fields are maintained by the lockstep functions. While a lane is in the group, its instance holds stale
+/// state, `pvm_lockstep_split()` writes it back.
+typedef struct pvm_lockstep {
+	/// \brief The data stack of the group, a row per slot with a column per lane.
+	pvm_data_t data_stack[PVM_DATA_STACK_SIZE][PVM_LOCKSTEP_LANES];
+	/// \brief The call stack shared by the lanes.
+	struct pvm_call_stack call_stack[PVM_CALL_STACK_SIZE];
+	/// \brief The PVM instances of the lanes.
+	pvm_t *lanes[PVM_LOCKSTEP_LANES];
+	/// \brief The error which stopped a lane after it left the group, PVM_NO_ERROR if it has just diverged.
+	pvm_errno_t errors[PVM_LOCKSTEP_LANES];
+	/// \brief The moment the group went asleep, see `pvm_t`.
+	uint32_t timer;
+	/// \brief The time the group sleeps for.
+	uint32_t timeout;
+	/// \brief The mask of the lanes still in the group, bit `i` stands for `lanes[i]`.
+	uint32_t active;
+	/// \brief The program counter of the group.
+	pvm_address_t pc;
+	/// \brief The data stack top of the group.
+	pvm_data_stack_t data_top;
+	/// \brief The call stack top of the group.
+	pvm_call_stack_t call_top;
+	/// \brief The number of lanes.
+	uint8_t count;
+} pvm_lockstep_t;
+
+/// \brief Initializes a lockstep group with PVM instances.
+///
+/// \param[out] group The group to initialize.
+/// \param[in] vms The PVM instances, usually freshly reset with the same executable assigned.
+/// \param[in] count The number of PVM instances, at most `PVM_LOCKSTEP_LANES` are taken.
+///
+/// \details The group takes the state of the first instance. Instances in another state, running another image, with
+/// other stack sizes or waiting for a built-in function, are left out of the group and keep running on their own, see
+/// `active`.
+void pvm_lockstep_init(pvm_lockstep_t *group, pvm_t *const vms[], uint8_t count);
+
+/// \brief Executes instructions in all lanes of the group while the budget lasts.
+///
+/// \param[in,out] group The lockstep group.
+/// \param[in,out] budget The maximum number of instructions, or cycles with `PVM_CYCLES`, to execute by every lane,
+/// receives the unspent part of it.
+///
+/// \return The mask of the lanes which left the group during the run.
+///
+/// \details The run follows `pvm_run_budget()` for every lane, a sleeping group leaves the budget untouched. A lane
+/// leaves the group when it diverges from the others, goes asleep or waits on its own, or stops with an error, which is
+/// stored in `errors`. Its instance holds its current state then, so the host continues it with `pvm_run()` unless it is
+/// stopped.
+uint32_t pvm_lockstep_run(pvm_lockstep_t *group, uint32_t *budget);
+
+/// \brief Writes the state of lanes back into their instances and removes them from the group.
+///
+/// \param[in,out] group The lockstep group, not running at the moment.
+/// \param[in] mask The mask of the lanes to split, lanes already out of the group are ignored.
+///
+/// \details The instances of the split lanes may then be run, snapshotted or dropped on their own.
+void pvm_lockstep_split(pvm_lockstep_t *group, uint32_t mask);
+
+#endif
@@ -0,0 +1,153 @@
+#include "pvm_map.h"
+#include "pvm_internal.h"
+
+#ifdef PVM_MAP_FILE
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif
+
+#ifndef section_pvm_map
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_map __attribute__((section(".pvm_map")))
+#else
+#define section_pvm_map
+#endif
+#endif
+
+/// \brief Maps an executable stored in addressable memory, e.g. a flash partition of the MCU.
+///
+/// \param[out] map The map to initialize.
+/// \param[in] image The first byte of the executable, which must stay in place while the map is used.
+/// \param[in] size The size of the storage in bytes, it may exceed the executable, e.g. a whole partition.
+///
+/// \return PVM_EXE_OK if the header fits the storage, otherwise the reason it does not.
+///
+/// \details The header is checked in place: the version, the size and the sections laid out within the storage. The
+/// executable is not available before `pvm_exe_map_verify()` or `pvm_exe_map_trust()`.
+enum pvm_exe_check_result section_pvm_map pvm_exe_map(pvm_exe_map_t *map, const void *image, const size_t size) {
+	const pvm_exe_t *const exe = (const pvm_exe_t *)image;
+	map->image = NULL;
+	map->size = 0;
+	map->exe = NULL;
+	map->file = 0;
+	if (!size) return PVM_EXE_SIZE;
+	// the header size depends on the format, which pvm_exe_check() validates below
+	const size_t header = pvm_exe_header_size(exe);
+	if (size < header || size - header < pvm_exe_size(exe)) return PVM_EXE_SIZE;
+	// the storage may be larger than the executable, so the executable is checked against its own size
+	const size_t exe_size = header + pvm_exe_size(exe);
+	enum pvm_exe_check_result result;
+	if ((result = pvm_exe_check(exe, exe_size))) return result;
+	map->image = exe;
+	map->size = exe_size;
+	return PVM_EXE_OK;
+}
+
+#ifdef PVM_MAP_FILE
+/// \brief Maps an executable file read-only into memory, `mmap()` on POSIX and a file mapping on Windows.
+///
+/// \param[out] map The map to initialize.
+/// \param[in] path The path of the executable file.
+///
+/// \return PVM_EXE_IO if the file cannot be mapped, otherwise the result of `pvm_exe_map()`.
+///
+/// \details Pages of the image are loaded on demand and shared with every other process mapping the same file.
+enum pvm_exe_check_result section_pvm_map pvm_exe_map_file(pvm_exe_map_t *map, const char *path) {
+	void *image = NULL;
+	size_t size = 0;
+	map->image = map->exe = NULL;
+	map->size = 0;
+	map->file = 0;
+	#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return PVM_EXE_IO;
+	LARGE_INTEGER file_size;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX) {
+		size = (size_t)file_size.QuadPart;
+		// the view keeps the mapping alive once both handles are closed
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping) {
+			image = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+	if (!image) return PVM_EXE_IO;
+	#else
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) return PVM_EXE_IO;
+	struct stat st;
+	if (!fstat(fd, &st) && st.st_size > 0) {
+		size = (size_t)st.st_size;
+		image = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (image == MAP_FAILED) image = NULL;
+	}
+	// the mapping outlives the descriptor
+	close(fd);
+	if (!image) return PVM_EXE_IO;
+	#endif
+	const enum pvm_exe_check_result result = pvm_exe_map(map, image, size);
+	if (result) {
+		#ifdef _WIN32
+		UnmapViewOfFile(image);
+		#else
+		munmap(image, size);
+		#endif
+		return result;
+	}
+	// the whole file is unmapped even if the executable is shorter
+	map->size = size;
+	map->file = 1;
+	return PVM_EXE_OK;
+}
+#endif
+
+/// \brief Verifies the mapped image and makes the executable available when it passes.
+///
+/// \param[in,out] map The map.
+/// \param[in] scratch The memory used by the verifier, see `pvm_exe_verify_size()` of `map->image`.
+/// \param[in] scratch_size The size of the scratch memory in bytes.
+/// \param[in,out] verify The optional verification results.
+///
+/// \return The result of `pvm_exe_verify()`.
+enum pvm_exe_check_result section_pvm_map pvm_exe_map_verify(pvm_exe_map_t *map, void *scratch, const size_t scratch_size, pvm_verify_t *verify) {
+	if (!map->image) return PVM_EXE_SIZE;
+	const enum pvm_exe_check_result result = pvm_exe_verify(map->image, scratch, scratch_size, verify);
+	if (!result) map->exe = map->image;
+	return result;
+}
+
+/// \brief Makes the executable of the mapped image available without verification.
+///
+/// \param[in,out] map The map.
+///
+/// \return The executable, which runs fully checked by the engines.
+///
+/// \details Intended for images the host has authenticated by other means, e.g. a signature of the partition.
+const pvm_exe_t *section_pvm_map pvm_exe_map_trust(pvm_exe_map_t *map) {
+	return map->exe = map->image;
+}
+
+/// \brief Releases the mapped image, PVM instances must not run the executable anymore.
+///
+/// \param[in,out] map The map, which is cleared.
+void section_pvm_map pvm_exe_unmap(pvm_exe_map_t *map) {
+	#ifdef PVM_MAP_FILE
+	if (map->file && map->image) {
+		#ifdef _WIN32
+		UnmapViewOfFile((LPCVOID)map->image);
+		#else
+		munmap((void *)map->image, map->size);
+		#endif
+	}
+	#endif
+	map->image = map->exe = NULL;
+	map->size = 0;
+	map->file = 0;
+}
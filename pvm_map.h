@@ -0,0 +1,75 @@
+#ifndef PVM_PVM_MAP_H
+#define PVM_PVM_MAP_H
+
+#include "pvm.h"
+
+// hosts with an operating system may map executables straight from files
+#if !defined(PVM_MAP_FILE) && !defined(PVM_NO_MAP_FILE) && (defined(_WIN32) || defined(__unix__) || defined(__APPLE__))
+#define PVM_MAP_FILE
+#endif
+
+/// \brief Represents a PVM executable executed in place from memory-mapped storage.
+///
+/// \details The image is checked in place and never copied, so any number of PVM instances may share it read-only,
+/// along with its prepared code. Until the verifier has proven the image safe, or the host vouches for it by
+/// `pvm_exe_map_trust()`, the map refuses to hand it out as an executable.
+typedef struct pvm_exe_map {
+	/// \brief The mapped image, its header is checked but its code is not trusted yet.
+	const pvm_exe_t *image;
+	/// \brief The size of the mapped image in bytes.
+	size_t size;
+	/// \brief The executable to load by `pvm_image_init()`, NULL until the image is trusted.
+	const pvm_exe_t *exe;
+	/// \brief The flag that the image was mapped from a file and has to be unmapped.
+	uint8_t file;
+} pvm_exe_map_t;
+
+/// \brief Maps an executable stored in addressable memory, e.g. a flash partition of the MCU.
+///
+/// \param[out] map The map to initialize.
+/// \param[in] image The first byte of the executable, which must stay in place while the map is used.
+/// \param[in] size The size of the storage in bytes, it may exceed the executable, e.g. a whole partition.
+///
+/// \return PVM_EXE_OK if the header fits the storage, otherwise the reason it does not.
+///
+/// \details The header is checked in place: the version, the size and the sections laid out within the storage. The
+/// executable is not available before `pvm_exe_map_verify()` or `pvm_exe_map_trust()`.
+enum pvm_exe_check_result pvm_exe_map(pvm_exe_map_t *map, const void *image, size_t size);
+
+#ifdef PVM_MAP_FILE
+/// \brief Maps an executable file read-only into memory, `mmap()` on POSIX and a file mapping on Windows.
+///
+/// \param[out] map The map to initialize.
+/// \param[in] path The path of the executable file.
+///
+/// \return PVM_EXE_IO if the file cannot be mapped, otherwise the result of `pvm_exe_map()`.
+///
+/// \details Pages of the image are loaded on demand and shared with every other process mapping the same file.
+enum pvm_exe_check_result pvm_exe_map_file(pvm_exe_map_t *map, const char *path);
+#endif
+
+/// \brief Verifies the mapped image and makes the executable available when it passes.
+///
+/// \param[in,out] map The map.
+/// \param[in] scratch The memory used by the verifier, see `pvm_exe_verify_size()` of `map->image`.
+/// \param[in] scratch_size The size of the scratch memory in bytes.
+/// \param[in,out] verify The optional verification results.
+///
+/// \return The result of `pvm_exe_verify()`.
+enum pvm_exe_check_result pvm_exe_map_verify(pvm_exe_map_t *map, void *scratch, size_t scratch_size, pvm_verify_t *verify);
+
+/// \brief Makes the executable of the mapped image available without verification.
+///
+/// \param[in,out] map The map.
+///
+/// \return The executable, which runs fully checked by the engines.
+///
+/// \details Intended for images the host has authenticated by other means, e.g. a signature of the partition.
+const pvm_exe_t *pvm_exe_map_trust(pvm_exe_map_t *map);
+
+/// \brief Releases the mapped image, PVM instances must not run the executable anymore.
+///
+/// \param[in,out] map The map, which is cleared.
+void pvm_exe_unmap(pvm_exe_map_t *map);
+
+#endif
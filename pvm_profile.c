@@ -0,0 +1,51 @@
+#include "pvm.h"
+
+#ifdef PVM_PROFILE
+
+#ifndef section_pvm_profile
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_profile __attribute__((section(".pvm_profile")))
+#else
+#define section_pvm_profile
+#endif
+#endif
+
+/// \brief Clears all counters of the profile keeping its arrays.
+///
+/// \param[in,out] profile The profile.
+void section_pvm_profile pvm_profile_reset(pvm_profile_t *profile) {
+	profile->instructions = 0;
+	for (int i = 0; i < 256; ++i) {
+		profile->opcodes[i] = 0;
+	}
+	for (size_t i = 0; i < profile->pcs_size; ++i) {
+		profile->pcs[i] = 0;
+	}
+	for (size_t i = 0; i < profile->functions_size; ++i) {
+		profile->functions[i] = (pvm_profile_function_t){ 0, 0, 0 };
+	}
+}
+
+/// \brief Copies the counters of the profile into a snapshot.
+///
+/// \param[in] profile The profile.
+/// \param[in,out] snapshot The snapshot with its own arrays, the counters fitting into them are copied.
+///
+/// \details The snapshot is consistent when taken while no instance counting into the profile is running.
+void section_pvm_profile pvm_profile_snapshot(const pvm_profile_t *profile, pvm_profile_t *snapshot) {
+	snapshot->clock = profile->clock;
+	snapshot->instructions = profile->instructions;
+	for (int i = 0; i < 256; ++i) {
+		snapshot->opcodes[i] = profile->opcodes[i];
+	}
+	if (snapshot->pcs_size > profile->pcs_size) snapshot->pcs_size = profile->pcs_size;
+	for (size_t i = 0; i < snapshot->pcs_size; ++i) {
+		snapshot->pcs[i] = profile->pcs[i];
+	}
+	if (snapshot->functions_size > profile->functions_size) snapshot->functions_size = profile->functions_size;
+	for (size_t i = 0; i < snapshot->functions_size; ++i) {
+		snapshot->functions[i] = profile->functions[i];
+	}
+}
+
+#endif
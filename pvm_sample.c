@@ -0,0 +1,97 @@
+#include "pvm_internal.h"
+
+#ifndef section_pvm_sample
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_sample __attribute__((section(".pvm_sample")))
+#else
+#define section_pvm_sample
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+/// \brief Orders the reads of a ring index before the accesses to the samples it guards.
+#define pvm_sample_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+/// \brief Orders the accesses to the samples before the write of a ring index publishing them.
+#define pvm_sample_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+// other compilers, e.g. MSVC, give volatile accesses acquire and release semantics on their own
+#define pvm_sample_acquire() ((void)0)
+#define pvm_sample_release() ((void)0)
+#endif
+
+/// \brief Records the call stack of a PVM instance into a sampler.
+///
+/// \param[in,out] sampler The sampler.
+/// \param[in] vm The PVM instance, possibly running at the moment.
+///
+/// \return Non-zero if the sample is recorded, zero if the ring is full.
+///
+/// \details The function may interrupt the engine at any instruction. It reads the call stack of the instance, which
+/// every engine keeps up to date in memory, so the functions of a sample are exact up to a call or a return executed
+/// meanwhile. The program counter is cached by the running engine, so it is exact for instances outside the engines
+/// only, and tells the address the run, the latest call or return started from otherwise. Lockstep lanes are sampled
+/// as they were upon joining their group.
+int section_pvm_sample pvm_sample(pvm_sampler_t *sampler, const pvm_t *vm) {
+	const uint32_t head = sampler->head;
+	const uint32_t next = head + 1 >= sampler->size ? 0 : head + 1;
+	if (next == sampler->tail) {
+		++sampler->dropped;
+		return 0;
+	}
+	pvm_sample_acquire();
+
+	// the instance changes under the sampler, so every field is read once and bounded on its own
+	const volatile pvm_t *const v = vm;
+	pvm_sample_t *const sample = &sampler->samples[head];
+	pvm_call_stack_t depth = v->call_top;
+	if (depth > pvm_call_stack_size(v)) depth = pvm_call_stack_size(v);
+	sample->pc = v->pc;
+	sample->depth = depth;
+	sample->binding = v->persist.binding;
+	const pvm_call_stack_t first = depth > PVM_SAMPLE_DEPTH ? depth - PVM_SAMPLE_DEPTH : 0;
+	for (pvm_call_stack_t i = first; i < depth; ++i) {
+		sample->functions[i - first] = v->call_stack[i].function_index;
+	}
+
+	pvm_sample_release();
+	sampler->head = next;
+	return 1;
+}
+
+/// \brief Takes the recorded samples out of a sampler.
+///
+/// \param[in,out] sampler The sampler.
+/// \param[out] buffer The buffer receiving the samples, the oldest ones fitting into it are drained.
+/// \param[in] size The size of the buffer in bytes.
+///
+/// \return The size of the drained samples in bytes.
+///
+/// \details Every sample takes `PVM_SAMPLE_RECORD_SIZE` bytes in little-endian order whatever the host: the binding
+/// and the depth in a byte each, the program counter in two bytes and the indices of `PVM_SAMPLE_DEPTH` functions in
+/// two bytes each, so the samples may be sent as they are to the `pvm-fold` tool.
+size_t section_pvm_sample pvm_sampler_drain(pvm_sampler_t *sampler, uint8_t *buffer, const size_t size) {
+	const uint32_t head = sampler->head;
+	pvm_sample_acquire();
+	uint32_t tail = sampler->tail;
+	size_t drained = 0;
+	while (tail != head && size - drained >= PVM_SAMPLE_RECORD_SIZE) {
+		const pvm_sample_t *const sample = &sampler->samples[tail];
+		const pvm_call_stack_t frames = sample->depth < PVM_SAMPLE_DEPTH ? sample->depth : PVM_SAMPLE_DEPTH;
+		buffer[0] = sample->binding;
+		buffer[1] = sample->depth;
+		buffer[2] = (uint8_t)sample->pc;
+		buffer[3] = (uint8_t)(sample->pc >> 8);
+		for (pvm_call_stack_t i = 0; i < PVM_SAMPLE_DEPTH; ++i) {
+			// the slots past the depth of the sample are left over from earlier ones
+			const pvm_function_index_t function = i < frames ? sample->functions[i] : 0;
+			buffer[4 + 2 * i] = (uint8_t)function;
+			buffer[5 + 2 * i] = (uint8_t)(function >> 8);
+		}
+		buffer += PVM_SAMPLE_RECORD_SIZE;
+		drained += PVM_SAMPLE_RECORD_SIZE;
+		if (++tail >= sampler->size) tail = 0;
+	}
+	pvm_sample_release();
+	sampler->tail = tail;
+	return drained;
+}
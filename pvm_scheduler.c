@@ -0,0 +1,191 @@
+#include "pvm_scheduler.h"
+
+#ifndef section_pvm_scheduler
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_scheduler __attribute__((section(".pvm_scheduler")))
+#else
+#define section_pvm_scheduler
+#endif
+#endif
+
+#ifdef PVM_ENV
+// the time is read from the clock once per run and cached in the environment shared by the instances
+#define pvm_scheduler_clock(scheduler) pvm_env_update((scheduler)->env)
+#define pvm_scheduler_tick(scheduler) ((scheduler)->env->tick)
+#else
+#define pvm_scheduler_clock(scheduler) now_ms()
+#define pvm_scheduler_tick(scheduler) now_ms()
+#endif
+
+/// \brief Calculates the time left until a sleeping PVM instance wakes up.
+///
+/// \param[in] vm The sleeping PVM instance.
+/// \param[in] now The current time, not earlier than the moment the instance went asleep.
+///
+/// \return The number of milliseconds left, zero if the timeout has elapsed.
+///
+/// \details The time left decreases equally for every instance, so the order of the heap keyed on it holds over time.
+static inline section_pvm_scheduler uint32_t pvm_scheduler_left(const pvm_t *vm, const uint32_t now) {
+	const uint32_t d = now - vm->timer;
+	return d < vm->timeout ? vm->timeout - d : 0;
+}
+
+/// \brief Checks if one heap entry wakes up before another one.
+static inline section_pvm_scheduler int pvm_scheduler_before(const pvm_scheduler_t *scheduler, const pvm_scheduler_index_t a, const pvm_scheduler_index_t b, const uint32_t now) {
+	return pvm_scheduler_left(&scheduler->vms[a], now) < pvm_scheduler_left(&scheduler->vms[b], now);
+}
+
+/// \brief Inserts a sleeping PVM instance into the timer heap.
+///
+/// \param[in,out] scheduler The scheduler.
+/// \param[in] index The index of the sleeping instance.
+///
+/// \details The current time is read after the instance went asleep, so the times left of all entries are consistent.
+/// Without `PVM_ENV` this reads `now_ms()` again, as `SLP` stamps the timer with a time later than the start of the run.
+static section_pvm_scheduler void pvm_scheduler_sleep(pvm_scheduler_t *scheduler, const pvm_scheduler_index_t index) {
+	const uint32_t now = pvm_scheduler_tick(scheduler);
+	pvm_scheduler_index_t *const heap = scheduler->heap;
+	pvm_scheduler_index_t i = scheduler->sleeping++;
+	// sift up
+	while (i) {
+		const pvm_scheduler_index_t parent = (i - 1) / 2;
+		if (!pvm_scheduler_before(scheduler, index, heap[parent], now)) break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = index;
+}
+
+/// \brief Removes the first PVM instance to wake up from the timer heap.
+///
+/// \param[in,out] scheduler The scheduler, which should have sleeping instances.
+/// \param[in] now The current time.
+///
+/// \return The index of the removed instance.
+static section_pvm_scheduler pvm_scheduler_index_t pvm_scheduler_wake(pvm_scheduler_t *scheduler, const uint32_t now) {
+	pvm_scheduler_index_t *const heap = scheduler->heap;
+	const pvm_scheduler_index_t first = heap[0];
+	const pvm_scheduler_index_t last = heap[--scheduler->sleeping];
+	const pvm_scheduler_index_t size = scheduler->sleeping;
+	pvm_scheduler_index_t i = 0;
+	// sift the last entry down from the root
+	for (;;) {
+		size_t child = 2u * i + 1;
+		if (child >= size) break;
+		if (child + 1 < size && pvm_scheduler_before(scheduler, heap[child + 1], heap[child], now)) ++child;
+		if (!pvm_scheduler_before(scheduler, heap[child], last, now)) break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	if (size) heap[i] = last;
+	return first;
+}
+
+/// \brief Schedules a PVM instance according to its state, waiting instances are parked out of the scheduler.
+static section_pvm_scheduler void pvm_scheduler_add(pvm_scheduler_t *scheduler, const pvm_scheduler_index_t index) {
+	if (scheduler->vms[index].waiting) return;
+	if (scheduler->vms[index].timer) pvm_scheduler_sleep(scheduler, index);
+	else scheduler->queue[scheduler->runnable++] = index;
+}
+
+/// \brief Initializes the scheduler with an array of PVM instances.
+///
+/// \param[out] scheduler The scheduler to initialize.
+/// \param[in] vms The array of PVM instances, all of them should be reset with their executables assigned.
+/// \param[in] count The number of PVM instances.
+/// \param[in] indices The memory of `PVM_SCHEDULER_INDICES(count)` indices used by the scheduler.
+///
+/// \details Every instance starts runnable, unless it is already asleep or parked waiting. The `stopped` function is cleared.
+void section_pvm_scheduler pvm_scheduler_init(pvm_scheduler_t *scheduler, pvm_t *vms, const pvm_scheduler_index_t count, pvm_scheduler_index_t *indices) {
+	scheduler->vms = vms;
+	scheduler->queue = indices;
+	scheduler->heap = indices + count;
+	scheduler->stopped = NULL;
+	#ifdef PVM_ENV
+	scheduler->env = count ? vms[0].persist.env : NULL;
+	#endif
+	scheduler->count = count;
+	scheduler->runnable = 0;
+	scheduler->sleeping = 0;
+	for (pvm_scheduler_index_t i = 0; i < count; ++i) {
+		pvm_scheduler_add(scheduler, i);
+	}
+}
+
+/// \brief Runs every runnable PVM instance once.
+///
+/// \param[in,out] scheduler The scheduler.
+/// \param[in] budget The maximum number of instructions, or cycles with `PVM_CYCLES`, each instance executes, see `pvm_run()`.
+///
+/// \return Zero if some instances are still runnable, otherwise the number of milliseconds until the first sleeping
+/// instance wakes up or PVM_SCHEDULER_IDLE if no instance is left.
+///
+/// \details Sleeping instances whose timeout has elapsed are woken up first. Then every runnable instance is executed
+/// for the budget by `pvm_run()`. Instances which went asleep are moved to the timer heap, instances waiting for a
+/// built-in function are parked until `pvm_scheduler_resume()` and instances stopped by an error are dropped and reported
+/// to the `stopped` function.
+///
+/// \note A host with nothing to run may sleep for the returned time, as long as it does not resume instances meanwhile.
+uint32_t section_pvm_scheduler pvm_scheduler_run(pvm_scheduler_t *scheduler, const uint32_t budget) {
+	// with an environment, instances going asleep during the run take the time read here
+	const uint32_t now = pvm_scheduler_clock(scheduler);
+	while (scheduler->sleeping && !pvm_scheduler_left(&scheduler->vms[scheduler->heap[0]], now)) {
+		const pvm_scheduler_index_t index = pvm_scheduler_wake(scheduler, now);
+		// the timeout has elapsed, so pvm_run() need not poll the time again
+		scheduler->vms[index].timer = 0;
+		scheduler->queue[scheduler->runnable++] = index;
+	}
+	// instances leaving the queue are replaced by the last one, which has not run yet
+	for (pvm_scheduler_index_t i = 0; i < scheduler->runnable;) {
+		const pvm_scheduler_index_t index = scheduler->queue[i];
+		pvm_t *const vm = &scheduler->vms[index];
+		const pvm_errno_t error = pvm_run(vm, budget);
+		if (!error && !vm->timer && !vm->waiting) {
+			++i;
+			continue;
+		}
+		scheduler->queue[i] = scheduler->queue[--scheduler->runnable];
+		if (!error) pvm_scheduler_add(scheduler, index);
+		else if (scheduler->stopped) scheduler->stopped(scheduler, index, error);
+	}
+	if (scheduler->runnable) return 0;
+	if (!scheduler->sleeping) return PVM_SCHEDULER_IDLE;
+	return pvm_scheduler_left(&scheduler->vms[scheduler->heap[0]], pvm_scheduler_clock(scheduler));
+}
+
+#ifdef PVM_CYCLES
+/// \brief Calculates the worst-case cycles of a single `pvm_scheduler_run()`.
+///
+/// \param[in] scheduler The scheduler.
+/// \param[in] budget The budget passed to `pvm_scheduler_run()` in cycles.
+/// \param[in] op_cycles The worst-case cycles of a single instruction of the scheduled executables, see `pvm_verify_t`.
+///
+/// \return The number of cycles saturated at PVM_CYCLES_UNBOUNDED.
+///
+/// \details Every instance overruns the budget by less than its last instruction, so the bound is the jitter a run may
+/// cause to the host loop. Built-in functions are not included beyond the cycles of CAL, the host bounds them itself.
+uint32_t section_pvm_scheduler pvm_scheduler_bound(const pvm_scheduler_t *scheduler, const uint32_t budget, const uint32_t op_cycles) {
+	if (!budget) return 0;
+	// woken instances run within the same call, so all of them count
+	const uint64_t bound = (uint64_t)scheduler->count * (budget - 1u + (uint64_t)op_cycles);
+	return bound > PVM_CYCLES_UNBOUNDED ? PVM_CYCLES_UNBOUNDED : (uint32_t)bound;
+}
+#endif
+
+/// \brief Returns a stopped PVM instance to the scheduler.
+///
+/// \param[in,out] scheduler The scheduler.
+/// \param[in] index The index of the instance, usually reset or completed by `pvm_complete()` beforehand.
+///
+/// \details The instance becomes runnable or sleeping according to its state, an instance still waiting stays parked.
+/// Instances which are already scheduled and indices out of bounds are ignored.
+void section_pvm_scheduler pvm_scheduler_resume(pvm_scheduler_t *scheduler, const pvm_scheduler_index_t index) {
+	if (index >= scheduler->count) return;
+	for (pvm_scheduler_index_t i = 0; i < scheduler->runnable; ++i) {
+		if (scheduler->queue[i] == index) return;
+	}
+	for (pvm_scheduler_index_t i = 0; i < scheduler->sleeping; ++i) {
+		if (scheduler->heap[i] == index) return;
+	}
+	pvm_scheduler_add(scheduler, index);
+}
@@ -0,0 +1,104 @@
+#ifndef PVM_PVM_SCHEDULER_H
+#define PVM_PVM_SCHEDULER_H
+
+#include "pvm.h"
+
+/// \brief The index of a PVM instance within the scheduler, which limits the scheduler to 255 instances.
+typedef uint8_t pvm_scheduler_index_t;
+
+/// \brief The number of indices the scheduler needs to schedule a given number of PVM instances.
+#define PVM_SCHEDULER_INDICES(count) (2 * (count))
+
+/// \brief Returned by `pvm_scheduler_run()` when no PVM instance is runnable or sleeping.
+#define PVM_SCHEDULER_IDLE UINT32_MAX
+
+/// \brief Represents a cooperative scheduler of PVM instances.
+///
+/// \details Runnable instances are kept in a queue and executed in turns. Instances put asleep by `SLP` are moved to a
+/// timer min-heap ordered by the time left until they wake up, so checking which ones wake up reads `now_ms()` once
+/// per run rather than once per sleeping instance. The clock is still read for every instance going asleep during the
+/// run, as `SLP` stamps its timer with the time of its own, and once more for the time returned when no instance is
+/// runnable. With `PVM_ENV` the scheduler refreshes the tick of its environment instead, and the instances going
+/// asleep take the tick of the run.
+/// Instances waiting for a built-in function, see `pvm_wait()`, and instances stopped by an error leave the scheduler
+/// until `pvm_scheduler_resume()`.
+///
+/// \note All fields are maintained by the scheduler functions, the structure is only exposed to be allocated statically.
+typedef struct pvm_scheduler {
+	/// \brief The array of the scheduled PVM instances.
+	pvm_t *vms;
+	/// \brief The runnable instances, in the order they are executed.
+	pvm_scheduler_index_t *queue;
+	/// \brief The sleeping instances, as a binary min-heap keyed on the time left until they wake up.
+	pvm_scheduler_index_t *heap;
+	/// \brief Optional function called when an instance stops with an error, including PVM_MAIN_RETURN.
+	///
+	/// \details The instance is already out of the scheduler when the function is called, so the function may reset it
+	/// and call `pvm_scheduler_resume()`.
+	void (*stopped)(struct pvm_scheduler *scheduler, pvm_scheduler_index_t index, pvm_errno_t error);
+	#ifdef PVM_ENV
+	/// \brief The environment providing the clock of the scheduler.
+	///
+	/// \details The scheduler refreshes the cached time of the environment at the start of every run, and once more for
+	/// the time it returns when no instance is runnable, so the instances sharing it never call the clock themselves. It
+	/// is taken from the first instance upon init.
+	pvm_env_t *env;
+	#endif
+	/// \brief The number of scheduled PVM instances.
+	pvm_scheduler_index_t count;
+	/// \brief The number of runnable instances.
+	pvm_scheduler_index_t runnable;
+	/// \brief The number of sleeping instances.
+	pvm_scheduler_index_t sleeping;
+} pvm_scheduler_t;
+
+/// \brief Initializes the scheduler with an array of PVM instances.
+///
+/// \param[out] scheduler The scheduler to initialize.
+/// \param[in] vms The array of PVM instances, all of them should be reset with their executables assigned.
+/// \param[in] count The number of PVM instances.
+/// \param[in] indices The memory of `PVM_SCHEDULER_INDICES(count)` indices used by the scheduler.
+///
+/// \details Every instance starts runnable, unless it is already asleep or parked waiting. The `stopped` function is cleared.
+void pvm_scheduler_init(pvm_scheduler_t *scheduler, pvm_t *vms, pvm_scheduler_index_t count, pvm_scheduler_index_t *indices);
+
+/// \brief Runs every runnable PVM instance once.
+///
+/// \param[in,out] scheduler The scheduler.
+/// \param[in] budget The maximum number of instructions, or cycles with `PVM_CYCLES`, each instance executes, see `pvm_run()`.
+///
+/// \return Zero if some instances are still runnable, otherwise the number of milliseconds until the first sleeping
+/// instance wakes up or PVM_SCHEDULER_IDLE if no instance is left.
+///
+/// \details Sleeping instances whose timeout has elapsed are woken up first. Then every runnable instance is executed
+/// for the budget by `pvm_run()`. Instances which went asleep are moved to the timer heap, instances waiting for a
+/// built-in function are parked until `pvm_scheduler_resume()` and instances stopped by an error are dropped and reported
+/// to the `stopped` function.
+///
+/// \note A host with nothing to run may sleep for the returned time, as long as it does not resume instances meanwhile.
+uint32_t pvm_scheduler_run(pvm_scheduler_t *scheduler, uint32_t budget);
+
+#ifdef PVM_CYCLES
+/// \brief Calculates the worst-case cycles of a single `pvm_scheduler_run()`.
+///
+/// \param[in] scheduler The scheduler.
+/// \param[in] budget The budget passed to `pvm_scheduler_run()` in cycles.
+/// \param[in] op_cycles The worst-case cycles of a single instruction of the scheduled executables, see `pvm_verify_t`.
+///
+/// \return The number of cycles saturated at PVM_CYCLES_UNBOUNDED.
+///
+/// \details Every instance overruns the budget by less than its last instruction, so the bound is the jitter a run may
+/// cause to the host loop. Built-in functions are not included beyond the cycles of CAL, the host bounds them itself.
+uint32_t pvm_scheduler_bound(const pvm_scheduler_t *scheduler, uint32_t budget, uint32_t op_cycles);
+#endif
+
+/// \brief Returns a stopped PVM instance to the scheduler.
+///
+/// \param[in,out] scheduler The scheduler.
+/// \param[in] index The index of the instance, usually reset or completed by `pvm_complete()` beforehand.
+///
+/// \details The instance becomes runnable or sleeping according to its state, an instance still waiting stays parked.
+/// Instances which are already scheduled and indices out of bounds are ignored.
+void pvm_scheduler_resume(pvm_scheduler_t *scheduler, pvm_scheduler_index_t index);
+
+#endif
@@ -0,0 +1,214 @@
+#include "pvm_internal.h"
+
+#ifndef section_pvm_snapshot
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_snapshot __attribute__((section(".pvm_snapshot")))
+#else
+#define section_pvm_snapshot
+#endif
+#endif
+
+#define PVM_FNV_OFFSET 2166136261u
+#define PVM_FNV_PRIME 16777619u
+
+/// \brief The instance was asleep when the snapshot was taken, the time it had left follows.
+#define PVM_SNAPSHOT_SLEEPING 0x01
+/// \brief The instance was waiting for a built-in function when the snapshot was taken, its `waiting` field follows.
+#define PVM_SNAPSHOT_WAITING 0x02
+
+/// \brief Continues the FNV-1a hash over a block of memory.
+static section_pvm_snapshot uint32_t pvm_fnv(uint32_t hash, const uint8_t *data, const size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * PVM_FNV_PRIME;
+	}
+	return hash;
+}
+
+/// \brief Represents the position within the snapshot being written or read.
+typedef struct pvm_snapshot_cursor {
+	uint8_t *data;
+	const uint8_t *end;
+	/// \brief Set once the position went past the end, further accesses are dropped.
+	int overrun;
+} pvm_snapshot_cursor_t;
+
+static section_pvm_snapshot void pvm_put(pvm_snapshot_cursor_t *c, const uint8_t byte) {
+	if (c->data >= c->end) {
+		c->overrun = 1;
+		return;
+	}
+	*c->data++ = byte;
+}
+
+static section_pvm_snapshot uint8_t pvm_get(pvm_snapshot_cursor_t *c) {
+	if (c->data >= c->end) {
+		c->overrun = 1;
+		return 0;
+	}
+	return *c->data++;
+}
+
+/// \brief Writes an unsigned integer of the given number of bytes in little-endian order.
+static section_pvm_snapshot void pvm_put_fixed(pvm_snapshot_cursor_t *c, const uint32_t value, const int bytes) {
+	for (int i = 0; i < bytes; ++i) {
+		pvm_put(c, (uint8_t)(value >> 8 * i));
+	}
+}
+
+static section_pvm_snapshot uint32_t pvm_get_fixed(pvm_snapshot_cursor_t *c, const int bytes) {
+	uint32_t value = 0;
+	for (int i = 0; i < bytes; ++i) {
+		value |= (uint32_t)pvm_get(c) << 8 * i;
+	}
+	return value;
+}
+
+/// \brief Writes an unsigned integer in 7-bit groups, least significant first, keeping small values in a single byte.
+static section_pvm_snapshot void pvm_put_varint(pvm_snapshot_cursor_t *c, uint32_t value) {
+	while (value >= 0x80) {
+		pvm_put(c, (uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	pvm_put(c, (uint8_t)value);
+}
+
+static section_pvm_snapshot uint32_t pvm_get_varint(pvm_snapshot_cursor_t *c) {
+	uint32_t value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		const uint8_t byte = pvm_get(c);
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) break;
+	}
+	return value;
+}
+
+/// \brief Calculates the hash identifying a PVM executable.
+///
+/// \param[in] exe The PVM executable, it should pass `pvm_exe_check()` first.
+///
+/// \return The 32-bit FNV-1a hash of the whole executable including its header.
+uint32_t section_pvm_snapshot pvm_exe_hash(const pvm_exe_t *exe) {
+	const uint8_t *const data = (const uint8_t *)exe;
+	return pvm_fnv(PVM_FNV_OFFSET, data, pvm_exe_header_size(exe) + pvm_exe_size(exe));
+}
+
+/// \brief Serializes the live state of a PVM instance.
+///
+/// \param[in] vm The PVM instance, not running at the moment.
+/// \param[out] buffer The memory receiving the snapshot.
+/// \param[in] size The size of the memory in bytes, `PVM_SNAPSHOT_MAX_SIZE` is always enough.
+///
+/// \return The size of the snapshot in bytes or zero if it does not fit into the memory.
+///
+/// \details Only the data stack up to `data_top` and the call stack up to `call_top` are written, the values as
+/// variable-length integers, along with the program counter and the time left to sleep. The snapshot is bound to the
+/// hash of the executable and protected by a checksum, so it may be kept in flash across power cycles or sent to another
+/// node running the same executable.
+size_t section_pvm_snapshot pvm_snapshot(const pvm_t *vm, void *buffer, const size_t size) {
+	pvm_snapshot_cursor_t c = { (uint8_t *)buffer, (const uint8_t *)buffer + size, 0 };
+	const pvm_data_stack_t data_top = vm->data_top <= pvm_data_stack_size(vm) ? vm->data_top : pvm_data_stack_size(vm);
+	const pvm_call_stack_t call_top = vm->call_top <= pvm_call_stack_size(vm) ? vm->call_top : pvm_call_stack_size(vm);
+
+	pvm_put(&c, PVM_SNAPSHOT_FORMAT);
+	pvm_put(&c, PVM_VERSION);
+	pvm_put_fixed(&c, pvm_exe_hash(vm->persist.image->exe), 4);
+	pvm_put_fixed(&c, vm->pc, 2);
+	pvm_put(&c, data_top);
+	pvm_put(&c, call_top);
+	pvm_put(&c, (vm->timer ? PVM_SNAPSHOT_SLEEPING : 0) | (vm->waiting ? PVM_SNAPSHOT_WAITING : 0));
+	if (vm->waiting) pvm_put(&c, vm->waiting);
+	if (vm->timer) {
+		// the time left is relative, so the snapshot does not depend on the clock of this node
+		const uint32_t elapsed = pvm_now(vm) - vm->timer;
+		pvm_put_varint(&c, elapsed < vm->timeout ? vm->timeout - elapsed : 0);
+	}
+	for (pvm_call_stack_t i = 0; i < call_top; ++i) {
+		const struct pvm_call_stack *const call = &vm->call_stack[i];
+		pvm_put_fixed(&c, call->return_address, 2);
+		pvm_put(&c, call->variables_start);
+		pvm_put(&c, call->arguments_count);
+		pvm_put_fixed(&c, call->function_index, 2);
+	}
+	for (pvm_data_stack_t i = 0; i < data_top; ++i) {
+		// zigzag keeps small negative values short as well
+		const int32_t value = vm->data_stack[i];
+		pvm_put_varint(&c, (uint32_t)value << 1 ^ (uint32_t)(value >> 31));
+	}
+	if (c.overrun) return 0;
+	pvm_put_fixed(&c, pvm_fnv(PVM_FNV_OFFSET, (const uint8_t *)buffer, c.data - (uint8_t *)buffer), 4);
+	if (c.overrun) return 0;
+	return c.data - (uint8_t *)buffer;
+}
+
+/// \brief Reads the state of a PVM instance from a snapshot into the reset instance.
+static section_pvm_snapshot enum pvm_snapshot_result pvm_restore_state(pvm_t *vm, const uint8_t *buffer, const size_t size) {
+	const pvm_image_t *const image = vm->persist.image;
+	const size_t code_size = image->code_size;
+	// the checksum is verified first, so the rest is read from an intact snapshot
+	if (size < 4) return PVM_SNAPSHOT_SIZE;
+	pvm_snapshot_cursor_t c = { (uint8_t *)buffer + size - 4, buffer + size, 0 };
+	if (pvm_get_fixed(&c, 4) != pvm_fnv(PVM_FNV_OFFSET, buffer, size - 4)) return PVM_SNAPSHOT_CORRUPT;
+
+	c = (pvm_snapshot_cursor_t){ (uint8_t *)buffer, buffer + size - 4, 0 };
+	if (pvm_get(&c) != PVM_SNAPSHOT_FORMAT || pvm_get(&c) != PVM_VERSION) return PVM_SNAPSHOT_VERSION;
+	if (pvm_get_fixed(&c, 4) != pvm_exe_hash(image->exe)) return PVM_SNAPSHOT_EXE;
+	const pvm_address_t pc = (pvm_address_t)pvm_get_fixed(&c, 2);
+	const pvm_data_stack_t data_top = pvm_get(&c);
+	const pvm_call_stack_t call_top = pvm_get(&c);
+	const uint8_t flags = pvm_get(&c);
+	if (c.overrun) return PVM_SNAPSHOT_SIZE;
+	if (pc >= code_size || data_top > pvm_data_stack_size(vm) || data_top < image->main_variables_count || call_top > pvm_call_stack_size(vm)) return PVM_SNAPSHOT_STATE;
+
+	if (flags & PVM_SNAPSHOT_WAITING) {
+		// the host completes the restored call as it would have completed the original one
+		vm->waiting = pvm_get(&c);
+		if (!(vm->waiting & PVM_WAITING) || (vm->waiting & ~PVM_WAITING) > data_top) return PVM_SNAPSHOT_STATE;
+	}
+	if (flags & PVM_SNAPSHOT_SLEEPING) {
+		vm->timeout = pvm_get_varint(&c);
+		vm->timer = pvm_now(vm);
+	}
+	for (pvm_call_stack_t i = 0; i < call_top; ++i) {
+		struct pvm_call_stack *const call = &vm->call_stack[i];
+		call->return_address = (pvm_address_t)pvm_get_fixed(&c, 2);
+		call->variables_start = pvm_get(&c);
+		call->arguments_count = pvm_get(&c);
+		call->function_index = (pvm_function_index_t)pvm_get_fixed(&c, 2);
+		if (c.overrun) return PVM_SNAPSHOT_SIZE;
+		// every frame must belong to a user function and lay within the data stack
+		if (call->function_index >= image->functions_count || call->return_address >= code_size) return PVM_SNAPSHOT_STATE;
+		const pvm_function_t *const fun = &image->functions[call->function_index];
+		if (fun->is_built_in || call->variables_start + call->arguments_count + fun->variables_count > data_top) return PVM_SNAPSHOT_STATE;
+		call->function = fun;
+	}
+	for (pvm_data_stack_t i = 0; i < data_top; ++i) {
+		const uint32_t value = pvm_get_varint(&c);
+		vm->data_stack[i] = (pvm_data_t)(int32_t)(value >> 1 ^ (0u - (value & 1)));
+	}
+	if (c.overrun || c.data != c.end) return PVM_SNAPSHOT_SIZE;
+	vm->pc = pc;
+	vm->data_top = data_top;
+	vm->call_top = call_top;
+	return PVM_SNAPSHOT_OK;
+}
+
+/// \brief Restores the state of a PVM instance from a snapshot.
+///
+/// \param[in,out] vm The PVM instance with its persistent data set and the executable assigned.
+/// \param[in] buffer The snapshot written by `pvm_snapshot()`.
+/// \param[in] size The size of the snapshot in bytes.
+///
+/// \return PVM_SNAPSHOT_OK if the instance is restored, otherwise the reason it is not.
+///
+/// \details A sleeping instance keeps sleeping for the time it had left when the snapshot was taken, counted from now.
+/// With `PVM_ENV` the time is taken from the environment of the instance. The restored state is checked against the
+/// stacks of the instance and the executable, but not against the verifier, so a snapshot resumed on the verified fast
+/// path should come from a trusted source.
+///
+/// \note The instance is left reset when the snapshot cannot be restored.
+enum pvm_snapshot_result section_pvm_snapshot pvm_restore(pvm_t *vm, const void *buffer, const size_t size) {
+	pvm_reset(vm);
+	const enum pvm_snapshot_result result = pvm_restore_state(vm, (const uint8_t *)buffer, size);
+	if (result) pvm_reset(vm);
+	return result;
+}
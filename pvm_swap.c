@@ -0,0 +1,92 @@
+#include "pvm_internal.h"
+
+#ifdef PVM_SWAP
+
+#ifndef section_pvm_swap
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_swap __attribute__((section(".pvm_swap")))
+#else
+#define section_pvm_swap
+#endif
+#endif
+
+/// \brief Publishes a new image to the instances sharing a swap.
+///
+/// \param[in,out] swap The swap.
+/// \param[in] image The new image.
+/// \param[in] entry The address main() of the new image resumes at, zero to run it from the start.
+/// \param[in] keep The number of the variables of main() kept, at most the variables of both images are kept.
+/// \param[in] instances The number of the instances running the current image of the swap.
+///
+/// \return Non-zero if the image is published, zero if the instances are still moving to the one published before.
+///
+/// \details The publication is atomic for the instances, each one moves as a whole at its own safe point.
+///
+/// \note The entry is not checked against the new image, it should be an address main() reaches with only its
+/// variables on the data stack. Instances resuming at an entry other than zero drop the prepared code of the swap and
+/// run checked.
+int section_pvm_swap pvm_swap_publish(pvm_swap_t *swap, const pvm_image_t *image, const pvm_address_t entry, const uint8_t keep, const uint16_t instances) {
+	if (swap->pending) return 0;
+	swap->entry = entry;
+	swap->keep = keep;
+	swap->previous = swap->image;
+	swap->image = image;
+	++swap->version;
+	swap->pending = instances;
+	if (!instances) {
+		const pvm_image_t *const previous = swap->previous;
+		swap->previous = NULL;
+		if (swap->release) swap->release(swap, previous);
+	}
+	return 1;
+}
+
+/// \brief Moves a PVM instance to the image published by its swap at once.
+///
+/// \param[in,out] vm The PVM instance.
+///
+/// \return Non-zero if the instance has moved, zero if it does not run the previous image or the variables of main()
+/// do not fit into its data stack.
+///
+/// \details The running engines move instances at their safe points. The host moves those never reaching one, such
+/// as instances stopped by an error, which then restart main() of the new image at its entry as if reset. Only the
+/// variables of main() kept by the swap are preserved.
+int section_pvm_swap pvm_swap_take(pvm_t *vm) {
+	pvm_swap_t *const swap = vm->persist.swap;
+	if (!swap || !swap->previous || vm->persist.image != swap->previous) return 0;
+	const pvm_image_t *const image = swap->image;
+	const pvm_data_stack_t variables = image->main_variables_count;
+	if (variables > pvm_data_stack_size(vm)) return 0;
+
+	// the variables past those kept start from zero as upon reset
+	pvm_data_stack_t keep = swap->keep;
+	if (keep > vm->persist.image->main_variables_count) keep = vm->persist.image->main_variables_count;
+	if (keep > variables) keep = variables;
+	for (pvm_data_stack_t i = keep; i < variables; ++i) {
+		vm->data_stack[i] = 0;
+	}
+	vm->timer = 0;
+	vm->timeout = 0;
+	vm->waiting = 0;
+	#ifdef PVM_CYCLES
+	vm->charge = 0;
+	#endif
+	vm->call_top = 0;
+	vm->data_top = variables;
+	vm->pc = swap->entry;
+	vm->persist.image = image;
+	#ifdef PVM_PREPARE
+	// the verifier has only proven the start of main() with its variables on the stack, the verified engine skips the
+	// stack checks, so an instance resuming elsewhere runs checked
+	vm->persist.prepared = swap->entry ? NULL : swap->prepared;
+	#endif
+
+	if (swap->pending && !--swap->pending) {
+		const pvm_image_t *const previous = swap->previous;
+		swap->previous = NULL;
+		if (swap->release) swap->release(swap, previous);
+	}
+	return 1;
+}
+
+#endif
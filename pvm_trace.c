@@ -0,0 +1,53 @@
+#include "pvm_internal.h"
+
+#ifdef PVM_TRACE
+
+#ifndef section_pvm_trace
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_trace __attribute__((section(".pvm_trace")))
+#else
+#define section_pvm_trace
+#endif
+#endif
+
+/// \brief Clears the trace keeping its records.
+///
+/// \param[in,out] trace The trace.
+void section_pvm_trace pvm_trace_reset(pvm_trace_t *trace) {
+	trace->head = 0;
+	trace->count = 0;
+}
+
+/// \brief Dumps the records of the trace from the oldest one on.
+///
+/// \param[in] trace The trace.
+/// \param[out] buffer The buffer receiving the records, the most recent ones fitting into it are dumped.
+/// \param[in] size The size of the buffer in bytes.
+///
+/// \return The size of the dump in bytes.
+///
+/// \details Every record takes `PVM_TRACE_RECORD_SIZE` bytes in little-endian order whatever the host: the address
+/// in two bytes, the opcode in one and the value on the top of the data stack in four, so the dump may be sent as it is
+/// to the `pvm-trace` decoder.
+size_t section_pvm_trace pvm_trace_dump(const pvm_trace_t *trace, uint8_t *buffer, const size_t size) {
+	size_t records = trace->count < trace->size ? trace->count : trace->size;
+	if (records > size / PVM_TRACE_RECORD_SIZE) records = size / PVM_TRACE_RECORD_SIZE;
+	// the oldest record dumped lays that many records behind the head
+	size_t index = trace->head + trace->size - records;
+	for (size_t i = 0; i < records; ++i, ++index) {
+		if (index >= trace->size) index -= trace->size;
+		const pvm_trace_record_t *const record = &trace->records[index];
+		const uint32_t top = (uint32_t)pvm_data_expand(record->top);
+		buffer[0] = (uint8_t)record->pc;
+		buffer[1] = (uint8_t)(record->pc >> 8);
+		buffer[2] = record->op;
+		buffer[3] = (uint8_t)top;
+		buffer[4] = (uint8_t)(top >> 8);
+		buffer[5] = (uint8_t)(top >> 16);
+		buffer[6] = (uint8_t)(top >> 24);
+		buffer += PVM_TRACE_RECORD_SIZE;
+	}
+	return records * PVM_TRACE_RECORD_SIZE;
+}
+
+#endif
@@ -0,0 +1,521 @@
+#include "pvm_internal.h"
+
+#ifndef section_pvm_verify
+#if defined(__GNUC__) || defined(__clang__)
+#define section_pvm_verify __attribute__((section(".pvm_verify")))
+#else
+#define section_pvm_verify
+#endif
+#endif
+
+// the flags of the known values and the reachability are published along with the states, see pvm_verify_state_t,
+// those below are private to the verifier
+/// \brief The instruction waits in the work list.
+#define PVM_VERIFY_QUEUED 0x08
+#ifdef PVM_CYCLES
+/// \brief The worst-case cycles from the instruction to the return of its function are known.
+#define PVM_VERIFY_TIMED 0x10
+#endif
+
+/// \brief Represents the control flow leaving an instruction.
+typedef struct pvm_verify_flow {
+	/// \brief The addresses of the following instructions.
+	pvm_address_t next[2];
+	/// \brief The number of the following instructions.
+	uint8_t count;
+	/// \brief The frame start of the user function called relative to the caller frame.
+	uint8_t base;
+	/// \brief The index of the user function called or -1.
+	int32_t callee;
+	/// \brief The depth of the data stack the instruction needs while it executes, zero if no deeper than after it.
+	uint16_t peak;
+} pvm_verify_flow_t;
+
+/// \brief Pushes a value onto the abstract data stack.
+///
+/// \param[in,out] s The abstract state.
+/// \param[in] known The flag whether the value is known.
+/// \param[in] value The value.
+///
+/// \return PVM_EXE_STACK if the data stack overflows, otherwise PVM_EXE_OK.
+static section_pvm_verify enum pvm_exe_check_result pvm_verify_push(pvm_verify_state_t *s, const int known, const int32_t value) {
+	if (s->depth >= PVM_DATA_STACK_SIZE) return PVM_EXE_STACK;
+	++s->depth;
+	s->value[1] = s->value[0];
+	// the values are known as they are loaded back from the data stack
+	s->value[0] = pvm_data_wrap(value);
+	s->flags = (s->flags & ~PVM_VERIFY_KNOWN) | (s->flags & PVM_VERIFY_TOP ? PVM_VERIFY_SECOND : 0) | (known ? PVM_VERIFY_TOP : 0);
+	return PVM_EXE_OK;
+}
+
+/// \brief Pops a value from the abstract data stack, the caller checks the depth first.
+///
+/// \param[in,out] s The abstract state.
+/// \param[out] value The value.
+///
+/// \return Non-zero if the value is known.
+static section_pvm_verify int pvm_verify_pop(pvm_verify_state_t *s, int32_t *value) {
+	const int known = s->flags & PVM_VERIFY_TOP;
+	--s->depth;
+	*value = s->value[0];
+	s->value[0] = s->value[1];
+	s->flags = (s->flags & ~PVM_VERIFY_KNOWN) | (s->flags & PVM_VERIFY_SECOND ? PVM_VERIFY_TOP : 0);
+	return known;
+}
+
+/// \brief Calculates the address a jump or a branch lands at the same way the engines do.
+///
+/// \param[in] pc The address of the jump or the branch.
+/// \param[in] offset The offset added to the address of the next instruction.
+///
+/// \return The target address.
+static inline section_pvm_verify pvm_address_t pvm_verify_target(const pvm_address_t pc, const int32_t offset) {
+	return (pvm_address_t)(pc + 1u + (uint32_t)offset + 1u);
+}
+
+/// \brief Interprets a single instruction abstractly.
+///
+/// \param[in] exe The PVM executable.
+/// \param[in] code The code section of the executable.
+/// \param[in] pc The address of the instruction.
+/// \param[in,out] s The abstract state upon entering the instruction replaced with the state upon leaving it.
+/// \param[out] flow The control flow leaving the instruction.
+///
+/// \return PVM_EXE_OK if the instruction is safe, otherwise the reason it is not.
+static section_pvm_verify enum pvm_exe_check_result pvm_verify_op(const pvm_exe_t *exe, const pvm_op_t *code, const pvm_address_t pc, pvm_verify_state_t *s, pvm_verify_flow_t *flow) {
+	const pvm_op_t op = code[pc];
+	const pvm_function_t *const owner = s->owner ? &pvm_functions(exe)[s->owner - 1] : NULL;
+	int32_t value, param;
+	int known;
+
+	flow->next[0] = pc + 1;
+	flow->count = 1;
+	flow->callee = -1;
+	flow->peak = 0;
+
+	if (op < PVM_OP_PSC) return pvm_verify_push(s, 1, op & 0x7F);
+	if (op < PVM_OP_BZE) {
+		if (!s->depth) return PVM_EXE_STACK;
+		known = pvm_verify_pop(s, &value);
+		return pvm_verify_push(s, known, (int32_t)((uint32_t)value << 5 | (op & 0x1F)));
+	}
+	if (op < PVM_OP_ADD) {
+		// the offset goes first, BZE and BNZ test a single value while the rest compare two of them
+		int pops = op < PVM_OP_BEQ ? 2 : 3;
+		if (s->depth < pops) return PVM_EXE_STACK;
+		if (!pvm_verify_pop(s, &value)) return PVM_EXE_OPERAND;
+		while (--pops) pvm_verify_pop(s, &param);
+		flow->next[1] = pvm_verify_target(pc, value);
+		flow->count = 2;
+		return PVM_EXE_OK;
+	}
+	if (op < PVM_OP_SKZ) {
+		if (s->depth < 2) return PVM_EXE_STACK;
+		pvm_verify_pop(s, &value);
+		pvm_verify_pop(s, &value);
+		return pvm_verify_push(s, 0, 0);
+	}
+	if (op < PVM_OP_SLP) {
+		// SKZ, SNZ, SKN and SNN test a single value and either follow or skip the next instruction
+		if (!s->depth) return PVM_EXE_STACK;
+		pvm_verify_pop(s, &value);
+		flow->next[1] = pc + 2;
+		flow->count = 2;
+		return PVM_EXE_OK;
+	}
+	if (op < PVM_OP_JMP) {
+		switch (op) {
+			case PVM_OP_SLP:
+				if (!s->depth) return PVM_EXE_STACK;
+				pvm_verify_pop(s, &value);
+				return PVM_EXE_OK;
+			case PVM_OP_RET:
+				flow->count = 0;
+				// RET of main() stops the executable, functions must leave exactly their frame and return values
+				if (owner && s->depth != owner->arguments_count + owner->variables_count + owner->returns_count) return PVM_EXE_STACK;
+				return PVM_EXE_OK;
+			case PVM_OP_LDC:
+				if (!s->depth) return PVM_EXE_STACK;
+				if (!pvm_verify_pop(s, &value)) return PVM_EXE_OPERAND;
+				if (value < 0 || (uint32_t)value >= pvm_constants_count(exe)) return PVM_EXE_CONSTANT;
+				return pvm_verify_push(s, 1, pvm_constant_at(pvm_constants(exe), value));
+			case PVM_OP_JMB:
+				if (!s->depth) return PVM_EXE_STACK;
+				if (!pvm_verify_pop(s, &value)) return PVM_EXE_OPERAND;
+				param = (int32_t)(0u - (uint32_t)value);
+				if (param < 0) param -= 2;
+				flow->next[0] = pvm_verify_target(pc, param);
+				return PVM_EXE_OK;
+			case PVM_OP_NEG:
+			case PVM_OP_INV:
+			case PVM_OP_INC:
+			case PVM_OP_DEC:
+				if (!s->depth) return PVM_EXE_STACK;
+				known = pvm_verify_pop(s, &value);
+				switch (op) {
+					case PVM_OP_NEG: value = (int32_t)(0u - (uint32_t)value); break;
+					case PVM_OP_INV: value = ~value; break;
+					case PVM_OP_INC: value = (int32_t)((uint32_t)value + 1u); break;
+					default: value = (int32_t)((uint32_t)value - 1u); break;
+				}
+				return pvm_verify_push(s, known, value);
+			default:
+				// POP
+				if (s->depth < (op & 3) + 1) return PVM_EXE_STACK;
+				for (int i = (op & 3) + 1; i; i--) {
+					pvm_verify_pop(s, &value);
+				}
+				return PVM_EXE_OK;
+		}
+	}
+
+	// JMP, CAL, LDV and STV share the integral operand
+	param = op & PVM_INTEGRAL_OP_MASK;
+	if (param == PVM_INTEGRAL_OP_MASK) {
+		if (!s->depth) return PVM_EXE_STACK;
+		if (!pvm_verify_pop(s, &param)) return PVM_EXE_OPERAND;
+		if (param > 0) param += PVM_INTEGRAL_OP_MASK;
+	}
+	switch (op & 0xF0) {
+		case PVM_OP_JMP:
+			if (param < 0) param -= 2;
+			flow->next[0] = pvm_verify_target(pc, param);
+			return PVM_EXE_OK;
+		case PVM_OP_CAL: {
+			if (param < 0 || (uint32_t)param >= pvm_functions_count(exe)) return PVM_EXE_FUNCTION;
+			const pvm_function_t *const fun = &pvm_functions(exe)[param];
+			int args_size = fun->arguments_count;
+			if (fun->is_variadic) {
+				// variadic user functions have no static frame layout
+				if (!fun->is_built_in) return PVM_EXE_FUNCTION;
+				if (!s->depth) return PVM_EXE_STACK;
+				if (!pvm_verify_pop(s, &value)) return PVM_EXE_OPERAND;
+				if (value < 0 || (args_size += value) > 0xFF) return PVM_EXE_FUNCTION;
+			}
+			// arguments must belong to the caller frame
+			if (s->depth < args_size) return PVM_EXE_STACK;
+			if (fun->is_built_in) {
+				// the built-in table of an environment is only known at run time, where the call checks it
+				#ifndef PVM_ENV
+				if (fun->address >= pvm_builtins_size) return PVM_EXE_FUNCTION;
+				#endif
+				// the call checks the room for the returns above the arguments before it takes them
+				flow->peak = s->depth + fun->returns_count;
+				if (flow->peak > PVM_DATA_STACK_SIZE) return PVM_EXE_STACK;
+			}
+			else {
+				flow->callee = param;
+			}
+			s->depth -= args_size;
+			flow->base = s->depth;
+			s->flags &= ~PVM_VERIFY_KNOWN;
+			for (int i = fun->returns_count; i; i--) {
+				if (pvm_verify_push(s, 0, 0)) return PVM_EXE_STACK;
+			}
+			return PVM_EXE_OK;
+		}
+		default: {
+			// LDV and STV
+			const int scope = owner ? owner->arguments_count + owner->variables_count : pvm_main_variables_count(exe);
+			if (param < 0 || param >= scope) return PVM_EXE_VARIABLE;
+			if ((op & 0xF0) == PVM_OP_LDV) return pvm_verify_push(s, 0, 0);
+			if (!s->depth) return PVM_EXE_STACK;
+			pvm_verify_pop(s, &value);
+			return PVM_EXE_OK;
+		}
+	}
+}
+
+#ifdef PVM_CYCLES
+/// \brief Adds cycles saturating at PVM_CYCLES_UNBOUNDED.
+static inline section_pvm_verify uint32_t pvm_verify_add(const uint32_t a, const uint32_t b) {
+	return a > PVM_CYCLES_UNBOUNDED - b ? PVM_CYCLES_UNBOUNDED : a + b;
+}
+
+/// \brief Calculates the cycles of a verified instruction on its own.
+///
+/// \param[in] exe The PVM executable.
+/// \param[in] code The code section of the executable.
+/// \param[in] pc The address of the instruction.
+/// \param[in] state The abstract state upon entering the instruction.
+/// \param[out] flow The control flow leaving the instruction.
+///
+/// \return The cycles of the instruction including the slots CAL and RET charge but not the function called.
+static section_pvm_verify uint32_t pvm_verify_cycles(const pvm_exe_t *exe, const pvm_op_t *code, const pvm_address_t pc, const pvm_verify_state_t *state, pvm_verify_flow_t *flow) {
+	pvm_verify_state_t s = *state;
+	pvm_verify_op(exe, code, pc, &s, flow);
+	uint32_t cycles = pvm_op_cycles(code[pc]);
+	if (flow->callee >= 0) cycles += pvm_functions(exe)[flow->callee].variables_count * PVM_CYCLES_SLOT;
+	else if (code[pc] == PVM_OP_RET && state->owner) cycles += pvm_functions(exe)[state->owner - 1].returns_count * PVM_CYCLES_SLOT;
+	return cycles;
+}
+
+/// \brief Finds the longest path from an entry to the returns of its function weighted by the instruction cycles.
+///
+/// \param[in] exe The PVM executable.
+/// \param[in] code The code section of the executable.
+/// \param[in,out] states The abstract states of all instructions.
+/// \param[in,out] cycles The worst-case cycles from every timed instruction to the return of its function.
+/// \param[in] wcet The worst-case cycles of main() and every function, those this function calls must be known.
+/// \param[out] path The room for the addresses of the path being followed, one for every instruction.
+/// \param[in] entry The address of the function entry.
+///
+/// \return The worst-case cycles of the function or PVM_CYCLES_UNBOUNDED if its code loops.
+///
+/// \details The depth-first search keeps the path from the entry marked as queued, reaching a queued instruction
+/// again means a loop.
+static section_pvm_verify uint32_t pvm_verify_longest(const pvm_exe_t *exe, const pvm_op_t *code, pvm_verify_state_t *states, uint32_t *cycles, const uint32_t *wcet, pvm_address_t *path, const pvm_address_t entry) {
+	pvm_verify_flow_t flow;
+	size_t depth = 0;
+	if (!(states[entry].flags & PVM_VERIFY_TIMED)) {
+		states[entry].flags |= PVM_VERIFY_QUEUED;
+		path[depth++] = entry;
+	}
+	while (depth) {
+		const pvm_address_t pc = path[depth - 1];
+		const uint32_t own = pvm_verify_cycles(exe, code, pc, &states[pc], &flow);
+		uint32_t longest = 0;
+		int i;
+		// descend into the first instruction that follows and is not timed yet
+		for (i = 0; i < flow.count; ++i) {
+			pvm_verify_state_t *const next = &states[flow.next[i]];
+			if (next->flags & PVM_VERIFY_TIMED) {
+				if (cycles[flow.next[i]] > longest) longest = cycles[flow.next[i]];
+				continue;
+			}
+			if (next->flags & PVM_VERIFY_QUEUED) {
+				while (depth) {
+					states[path[--depth]].flags &= ~PVM_VERIFY_QUEUED;
+				}
+				return PVM_CYCLES_UNBOUNDED;
+			}
+			next->flags |= PVM_VERIFY_QUEUED;
+			path[depth++] = flow.next[i];
+			break;
+		}
+		if (i < flow.count) continue;
+		cycles[pc] = pvm_verify_add(pvm_verify_add(own, flow.callee < 0 ? 0 : wcet[flow.callee + 1]), longest);
+		states[pc].flags = (states[pc].flags & ~PVM_VERIFY_QUEUED) | PVM_VERIFY_TIMED;
+		--depth;
+	}
+	return cycles[entry];
+}
+#endif
+
+/// \brief Merges the abstract state into the state of an instruction queuing the instruction when its state changes.
+///
+/// \param[in,out] states The abstract states of all instructions.
+/// \param[in,out] worklist The addresses of the queued instructions.
+/// \param[in,out] queued The number of the queued instructions.
+/// \param[in] pc The address of the instruction.
+/// \param[in] s The incoming abstract state.
+///
+/// \return PVM_EXE_TARGET if the instruction belongs to another function, PVM_EXE_STACK if the depths do not match,
+/// otherwise PVM_EXE_OK.
+static section_pvm_verify enum pvm_exe_check_result pvm_verify_merge(pvm_verify_state_t *states, pvm_address_t *worklist, size_t *queued, const pvm_address_t pc, const pvm_verify_state_t *s) {
+	pvm_verify_state_t *const t = &states[pc];
+	if (!(t->flags & PVM_VERIFY_VISITED)) {
+		*t = *s;
+		t->flags = (s->flags & PVM_VERIFY_KNOWN) | PVM_VERIFY_VISITED | PVM_VERIFY_QUEUED;
+		worklist[(*queued)++] = pc;
+		return PVM_EXE_OK;
+	}
+	if (t->owner != s->owner) return PVM_EXE_TARGET;
+	if (t->depth != s->depth) return PVM_EXE_STACK;
+	// a value stays known only when it is the same along all the paths
+	uint8_t known = t->flags & s->flags & PVM_VERIFY_KNOWN;
+	if (t->value[0] != s->value[0]) known &= ~PVM_VERIFY_TOP;
+	if (t->value[1] != s->value[1]) known &= ~PVM_VERIFY_SECOND;
+	if (known != (t->flags & PVM_VERIFY_KNOWN)) {
+		t->flags = (t->flags & ~PVM_VERIFY_KNOWN) | known;
+		if (!(t->flags & PVM_VERIFY_QUEUED)) {
+			t->flags |= PVM_VERIFY_QUEUED;
+			worklist[(*queued)++] = pc;
+		}
+	}
+	return PVM_EXE_OK;
+}
+
+/// \brief Calculates the size of the scratch memory needed to verify a PVM executable.
+///
+/// \param[in] exe The PVM executable to verify.
+///
+/// \return The size of the scratch memory in bytes.
+///
+/// \note The size includes the room to align the scratch memory.
+size_t section_pvm_verify pvm_exe_verify_size(const pvm_exe_t *exe) {
+	// abstract states and the work list for every instruction, frame depths plus two generations of the stack and call
+	// depths for main() and every function, and the room to align the scratch
+	size_t size = pvm_code_size(exe) * (sizeof(pvm_verify_state_t) + sizeof(pvm_address_t)) + 5 * (pvm_functions_count(exe) + 1) * sizeof(uint16_t) + sizeof(int32_t) - 1;
+	#ifdef PVM_CYCLES
+	// the worst-case cycles of every instruction and of main() and every function
+	size += (pvm_code_size(exe) + pvm_functions_count(exe) + 1) * sizeof(uint32_t);
+	#endif
+	return size;
+}
+
+/// \brief Verifies the code of a PVM executable.
+///
+/// \param[in] exe The PVM executable to verify, it should pass `pvm_exe_check()` first.
+/// \param[in] scratch The memory used by the verifier.
+/// \param[in] scratch_size The size of the scratch memory in bytes.
+/// \param[in,out] verify The optional verification results.
+///
+/// \return PVM_EXE_OK if the code is proven to be safe, otherwise the reason it is not.
+///
+/// \details The frames of main() and of every user function are interpreted first one by one from their entries
+/// following all the paths, then the stack and call depths are combined over the call graph level by level up to
+/// `PVM_CALL_STACK_SIZE` nested calls.
+///
+/// \details With `PVM_CYCLES` the functions are timed in the order of the call graph, every function once those it
+/// calls are, by the longest path through its code where every call adds the worst-case cycles of the callee.
+enum pvm_exe_check_result section_pvm_verify pvm_exe_verify(const pvm_exe_t *exe, void *scratch, size_t scratch_size, pvm_verify_t *verify) {
+	enum pvm_exe_check_result result;
+	if (scratch_size < pvm_exe_verify_size(exe)) return PVM_EXE_SCRATCH;
+
+	const pvm_op_t *const code = pvm_code(exe);
+	const size_t code_size = pvm_code_size(exe);
+	const size_t owners = pvm_functions_count(exe) + 1;
+	pvm_verify_state_t *const states = (pvm_verify_state_t *)(((uintptr_t)scratch + sizeof(int32_t) - 1) & ~(uintptr_t)(sizeof(int32_t) - 1));
+	#ifdef PVM_CYCLES
+	uint32_t *const cycles = (uint32_t *)&states[code_size];
+	uint32_t *const wcet = &cycles[code_size];
+	pvm_address_t *const worklist = (pvm_address_t *)&wcet[owners];
+	#else
+	pvm_address_t *const worklist = (pvm_address_t *)&states[code_size];
+	#endif
+	uint16_t *const frames = (uint16_t *)&worklist[code_size];
+	uint16_t *stack_depth = frames + owners, *next_stack_depth = stack_depth + owners;
+	uint16_t *call_depth = next_stack_depth + owners, *next_call_depth = call_depth + owners;
+	pvm_verify_flow_t flow;
+
+	for (size_t pc = 0; pc < code_size; ++pc) {
+		states[pc].flags = 0;
+	}
+
+	// interpret every frame on its own
+	for (size_t owner = 0; owner < owners; ++owner) {
+		pvm_verify_state_t s = { { 0, 0 }, owner, 0, 0 };
+		pvm_address_t address = 0;
+		int depth = pvm_main_variables_count(exe);
+		frames[owner] = 0;
+		if (owner) {
+			const pvm_function_t *const fun = &pvm_functions(exe)[owner - 1];
+			if (fun->is_built_in) continue;
+			if (fun->is_variadic) return PVM_EXE_FUNCTION;
+			address = fun->address;
+			depth = fun->arguments_count + fun->variables_count;
+		}
+		if (depth > PVM_DATA_STACK_SIZE) return PVM_EXE_STACK;
+		if (address >= code_size) return PVM_EXE_TARGET;
+		s.depth = frames[owner] = depth;
+
+		size_t queued = 0;
+		if ((result = pvm_verify_merge(states, worklist, &queued, address, &s))) return result;
+		while (queued) {
+			const pvm_address_t pc = worklist[--queued];
+			states[pc].flags &= ~PVM_VERIFY_QUEUED;
+			s = states[pc];
+			if ((result = pvm_verify_op(exe, code, pc, &s, &flow))) return result;
+			if (s.depth > frames[owner]) frames[owner] = s.depth;
+			if (flow.peak > frames[owner]) frames[owner] = flow.peak;
+			for (int i = 0; i < flow.count; ++i) {
+				if (flow.next[i] >= code_size) return PVM_EXE_TARGET;
+				if ((result = pvm_verify_merge(states, worklist, &queued, flow.next[i], &s))) return result;
+			}
+		}
+	}
+
+	// combine the frames over the call graph, every level allows one more nested call
+	for (size_t owner = 0; owner < owners; ++owner) {
+		stack_depth[owner] = frames[owner];
+		call_depth[owner] = 0;
+	}
+	for (int level = 0; level < PVM_CALL_STACK_SIZE; ++level) {
+		for (size_t owner = 0; owner < owners; ++owner) {
+			next_stack_depth[owner] = frames[owner];
+			next_call_depth[owner] = 0;
+		}
+		for (size_t pc = 0; pc < code_size; ++pc) {
+			if (!(states[pc].flags & PVM_VERIFY_VISITED) || (code[pc] & 0xF0) != PVM_OP_CAL) continue;
+			pvm_verify_state_t s = states[pc];
+			pvm_verify_op(exe, code, pc, &s, &flow);
+			if (flow.callee < 0) {
+				// built-in functions take no frame, but their call needs the room for one
+				if (!next_call_depth[s.owner]) next_call_depth[s.owner] = 1;
+				continue;
+			}
+			const size_t callee = flow.callee + 1;
+			if (flow.base + stack_depth[callee] > next_stack_depth[s.owner]) next_stack_depth[s.owner] = flow.base + stack_depth[callee];
+			if (call_depth[callee] + 1 > next_call_depth[s.owner]) next_call_depth[s.owner] = call_depth[callee] + 1;
+		}
+		uint16_t *swap = stack_depth;
+		stack_depth = next_stack_depth;
+		next_stack_depth = swap;
+		swap = call_depth;
+		call_depth = next_call_depth;
+		next_call_depth = swap;
+	}
+
+	#ifdef PVM_CYCLES
+	// time every function once the functions it calls are timed, both remaining generations mark the functions done
+	// and ready, and functions that are never ready recurse
+	uint16_t *const done = next_stack_depth, *const ready = next_call_depth;
+	uint32_t op_cycles = 0;
+	for (size_t owner = 0; owner < owners; ++owner) {
+		done[owner] = owner && pvm_functions(exe)[owner - 1].is_built_in;
+		wcet[owner] = 0;
+	}
+	for (size_t pc = 0; pc < code_size; ++pc) {
+		if (!(states[pc].flags & PVM_VERIFY_VISITED)) continue;
+		const uint32_t own = pvm_verify_cycles(exe, code, pc, &states[pc], &flow);
+		if (own > op_cycles) op_cycles = own;
+	}
+	for (int progress = 1; progress;) {
+		progress = 0;
+		for (size_t owner = 0; owner < owners; ++owner) {
+			ready[owner] = !done[owner];
+		}
+		for (size_t pc = 0; pc < code_size; ++pc) {
+			if (!(states[pc].flags & PVM_VERIFY_VISITED) || (code[pc] & 0xF0) != PVM_OP_CAL) continue;
+			pvm_verify_state_t s = states[pc];
+			pvm_verify_op(exe, code, pc, &s, &flow);
+			if (flow.callee >= 0 && !done[flow.callee + 1]) ready[s.owner] = 0;
+		}
+		for (size_t owner = 0; owner < owners; ++owner) {
+			if (!ready[owner]) continue;
+			wcet[owner] = pvm_verify_longest(exe, code, states, cycles, wcet, worklist, owner ? pvm_functions(exe)[owner - 1].address : 0);
+			done[owner] = progress = 1;
+		}
+	}
+	for (size_t owner = 0; owner < owners; ++owner) {
+		if (!done[owner]) wcet[owner] = PVM_CYCLES_UNBOUNDED;
+	}
+	#endif
+
+	if (verify) {
+		#ifdef PVM_CYCLES
+		verify->main_cycles = wcet[0];
+		verify->op_cycles = op_cycles;
+		if (verify->cycles) {
+			for (size_t owner = 1; owner < owners; ++owner) {
+				verify->cycles[owner - 1] = wcet[owner];
+			}
+		}
+		#endif
+		if (verify->states) {
+			for (size_t pc = 0; pc < code_size; ++pc) {
+				verify->states[pc] = states[pc];
+				verify->states[pc].flags &= PVM_VERIFY_KNOWN | PVM_VERIFY_VISITED;
+			}
+		}
+		verify->stack_depth = stack_depth[0];
+		verify->call_depth = call_depth[0];
+		if (verify->frames) {
+			for (size_t owner = 1; owner < owners; ++owner) {
+				verify->frames[owner - 1] = frames[owner];
+			}
+		}
+	}
+	return PVM_EXE_OK;
+}
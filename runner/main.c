@@ -0,0 +1,210 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "pvm_lockstep.h"
+#include "pvm_map.h"
+#include "pvm_runner.h"
+
+/// \brief Maps a PVM executable in place, the image is shared read-only by all instances.
+///
+/// \details `verified` receives the results of the verification, it is cleared if the verifier rejects the code.
+static const pvm_exe_t *load_exe(pvm_exe_map_t *map, const char *filename, pvm_verify_t **verified) {
+	const enum pvm_exe_check_result check = pvm_exe_map_file(map, filename);
+	if (check) {
+		fprintf(stderr, check == PVM_EXE_IO ? "Failed to map file\n" : "Invalid exe\n");
+		return NULL;
+	}
+
+	const size_t scratch_size = pvm_exe_verify_size(map->image);
+	void *scratch = malloc(scratch_size);
+	const enum pvm_exe_check_result verify = scratch ? pvm_exe_map_verify(map, scratch, scratch_size, *verified) : PVM_EXE_SCRATCH;
+	free(scratch);
+	if (verify) {
+		fprintf(stderr, "Exe not verified (%d), running checked\n", verify);
+		*verified = NULL;
+		return pvm_exe_map_trust(map);
+	}
+
+	return map->exe;
+}
+
+#ifdef PVM_ENV
+static uint32_t env_clock(pvm_env_t *env) {
+	(void)env;
+	return now_ms();
+}
+#endif
+
+static void usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-n instances] [-t threads] [-b budget] [-d duration_ms] [-l] [-v] <filename>\n", name);
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/// \brief Runs the instances in lockstep groups on the calling thread until every lane has left its group.
+///
+/// \return Zero on success, otherwise the `errno` code of the failed allocation.
+///
+/// \details The lanes leaving their groups are left to the runner, those stopped by an error are marked as such. The
+/// instructions of a turn are counted for every lane which started it.
+static int run_lockstep(pvm_runner_vm_t *vms, const uint32_t count, const uint32_t budget, const uint32_t duration_ms, uint64_t *elapsed_ns) {
+	const uint32_t groups_count = (count + PVM_LOCKSTEP_LANES - 1) / PVM_LOCKSTEP_LANES;
+	pvm_lockstep_t *const groups = malloc(groups_count * sizeof(pvm_lockstep_t));
+	if (!groups) return ENOMEM;
+	for (uint32_t g = 0; g < groups_count; ++g) {
+		pvm_t *lanes[PVM_LOCKSTEP_LANES];
+		const uint32_t first = g * PVM_LOCKSTEP_LANES;
+		const uint32_t size = count - first < PVM_LOCKSTEP_LANES ? count - first : PVM_LOCKSTEP_LANES;
+		for (uint32_t l = 0; l < size; ++l) lanes[l] = &vms[first + l].vm;
+		pvm_lockstep_init(&groups[g], lanes, (uint8_t)size);
+	}
+	const uint64_t start = now_ns(), deadline = start + (uint64_t)duration_ms * 1000000u;
+	for (uint32_t running = groups_count; running && (!duration_ms || now_ns() < deadline);) {
+		int progressed = 0;
+		running = 0;
+		for (uint32_t g = 0; g < groups_count; ++g) {
+			pvm_lockstep_t *const group = &groups[g];
+			if (!group->active) continue;
+			pvm_runner_vm_t *const lanes = &vms[g * PVM_LOCKSTEP_LANES];
+			const uint32_t active = group->active;
+			#ifdef PVM_ENV
+			for (uint8_t l = 0; l < group->count; ++l) pvm_env_update(lanes[l].vm.persist.env);
+			#endif
+			uint32_t left = budget;
+			const uint32_t split = pvm_lockstep_run(group, &left);
+			for (uint8_t l = 0; l < group->count; ++l) {
+				if (active >> l & 1) lanes[l].retired += budget - left;
+				if (split >> l & 1) lanes[l].error = group->errors[l];
+			}
+			if (left != budget) progressed = 1;
+			if (group->active) ++running;
+		}
+		if (running && !progressed) {
+			// all groups are asleep
+			const struct timespec backoff = { 0, 1000000 };
+			nanosleep(&backoff, NULL);
+		}
+	}
+	// the groups still running when the duration elapses hand their lanes over as they are
+	for (uint32_t g = 0; g < groups_count; ++g) {
+		pvm_lockstep_split(&groups[g], groups[g].active);
+	}
+	free(groups);
+	*elapsed_ns = now_ns() - start;
+	return 0;
+}
+
+int main(const int argc, char *const argv[]) {
+	uint32_t count = 1000, budget = 1000, duration_ms = 0;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int verbose = 0, lockstep = 0, option;
+	while ((option = getopt(argc, argv, "n:t:b:d:lv")) != -1) {
+		switch (option) {
+			case 'n': count = strtoul(optarg, NULL, 0); break;
+			case 't': threads = strtol(optarg, NULL, 0); break;
+			case 'b': budget = strtoul(optarg, NULL, 0); break;
+			case 'd': duration_ms = strtoul(optarg, NULL, 0); break;
+			case 'l': lockstep = 1; break;
+			case 'v': verbose = 1; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1 || !count) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	pvm_exe_map_t map;
+	pvm_verify_t depths = { NULL }, *verified = &depths;
+	const pvm_exe_t *exe = load_exe(&map, argv[optind], &verified);
+	if (!exe) return 1;
+	pvm_image_t image;
+	pvm_image_init(&image, exe);
+
+	#ifdef PVM_PREPARE
+	// the prepared code is only read while running, so one copy serves all instances
+	void *arena = malloc(pvm_prepare_size(exe));
+	const pvm_prepared_t *prepared = arena ? pvm_prepare(exe, arena, pvm_prepare_size(exe)) : NULL;
+	#endif
+
+	pvm_runner_vm_t *vms = calloc(count, sizeof(pvm_runner_vm_t));
+	if (!vms) {
+		perror("Failed to allocate instances");
+		return 1;
+	}
+	#ifdef PVM_ARENA
+	// the stacks of all instances are laid out back to back, each one as deep as the executable needs
+	const size_t stacks_size = pvm_arena_size(verified);
+	uint8_t *const stacks = malloc(count * stacks_size);
+	if (!stacks) {
+		perror("Failed to allocate stacks");
+		return 1;
+	}
+	#endif
+	for (uint32_t i = 0; i < count; ++i) {
+		vms[i].vm.persist.binding = (uint8_t)i;
+		vms[i].vm.persist.image = &image;
+		#ifdef PVM_ENV
+		vms[i].env.clock = env_clock;
+		vms[i].env.builtins = pvm_builtins;
+		vms[i].env.builtins_size = pvm_builtins_size;
+		vms[i].vm.persist.env = &vms[i].env;
+		#endif
+		#ifdef PVM_PREPARE
+		vms[i].vm.persist.prepared = prepared;
+		#endif
+		#ifdef PVM_ARENA
+		pvm_init(&vms[i].vm, &image, verified, stacks + i * stacks_size, stacks_size);
+		#else
+		pvm_reset(&vms[i].vm);
+		#endif
+	}
+
+	// lockstep groups run first, the runner continues the lanes which have left them within the rest of the duration
+	uint64_t lockstep_ns = 0;
+	if (lockstep && run_lockstep(vms, count, budget ? budget : 1, duration_ms, &lockstep_ns)) {
+		perror("Failed to allocate lockstep groups");
+		return 1;
+	}
+	const uint64_t lockstep_ms = lockstep_ns / 1000000u;
+	const int expired = duration_ms && lockstep_ms >= duration_ms;
+
+	pvm_runner_t runner;
+	int err = pvm_runner_init(&runner, vms, count, (uint32_t)threads, budget);
+	if (!err && !expired) err = pvm_runner_run(&runner, duration_ms ? duration_ms - (uint32_t)lockstep_ms : 0);
+	if (err) {
+		fprintf(stderr, "Failed to run: error %d\n", err);
+		return 1;
+	}
+
+	const double seconds = (lockstep_ns + runner.elapsed_ns) / 1e9;
+	if (verbose) {
+		for (uint32_t i = 0; i < count; ++i) {
+			printf("VM %u: %llu ops, %.0f ops/sec, error %d\n", i, (unsigned long long)vms[i].retired,
+				seconds > 0 ? vms[i].retired / seconds : 0, vms[i].error);
+		}
+	}
+	const uint64_t retired = pvm_runner_retired(&runner);
+	printf("TOTAL: %u instances, %u threads, %llu ops in %.3f s, %.0f ops/sec\n", count, runner.threads,
+		(unsigned long long)retired, seconds, seconds > 0 ? retired / seconds : 0);
+
+	pvm_runner_free(&runner);
+	free(vms);
+	#ifdef PVM_ARENA
+	free(stacks);
+	#endif
+	#ifdef PVM_PREPARE
+	free(arena);
+	#endif
+	pvm_exe_unmap(&map);
+	return 0;
+}
@@ -0,0 +1,217 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pvm_runner.h"
+
+/// \brief Represents the arguments of a worker thread.
+typedef struct pvm_runner_worker {
+	/// \brief The runner the worker belongs to.
+	pvm_runner_t *runner;
+	/// \brief The index of the worker queue.
+	uint32_t id;
+} pvm_runner_worker_t;
+
+/// \brief Gets the monotonic time in nanoseconds.
+static uint64_t pvm_runner_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/// \brief Appends an instance to the tail of a queue.
+///
+/// \return The number of instances in the queue.
+static uint32_t pvm_runner_put(pvm_runner_queue_t *queue, const uint32_t count, const uint32_t index) {
+	pthread_mutex_lock(&queue->lock);
+	queue->items[(queue->head + queue->size++) % count] = index;
+	const uint32_t size = queue->size;
+	pthread_mutex_unlock(&queue->lock);
+	return size;
+}
+
+/// \brief Takes an instance from a queue.
+///
+/// \param[in,out] queue The queue.
+/// \param[in] count The capacity of the queue.
+/// \param[in] steal Nonzero to take the instance from the tail rather than from the head.
+/// \param[out] index The index of the instance taken.
+///
+/// \return Nonzero if an instance was taken, zero if the queue is empty.
+static int pvm_runner_take(pvm_runner_queue_t *queue, const uint32_t count, const int steal, uint32_t *index) {
+	int taken = 0;
+	pthread_mutex_lock(&queue->lock);
+	if (queue->size) {
+		if (steal) {
+			*index = queue->items[(queue->head + --queue->size) % count];
+		}
+		else {
+			*index = queue->items[queue->head];
+			queue->head = (queue->head + 1) % count;
+			--queue->size;
+		}
+		taken = 1;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return taken;
+}
+
+/// \brief Runs the instances of a worker queue stealing from the other queues when it is empty.
+static void *pvm_runner_work(void *argument) {
+	const pvm_runner_worker_t *const worker = argument;
+	pvm_runner_t *const runner = worker->runner;
+	pvm_runner_queue_t *const own = &runner->queues[worker->id];
+	// the number of turns in a row which executed nothing as the instances were asleep
+	uint32_t idle = 0;
+	while (!atomic_load_explicit(&runner->stop, memory_order_relaxed)) {
+		uint32_t index;
+		if (!pvm_runner_take(own, runner->count, 0, &index)) {
+			int stolen = 0;
+			for (uint32_t i = 1; i < runner->threads && !stolen; ++i) {
+				stolen = pvm_runner_take(&runner->queues[(worker->id + i) % runner->threads], runner->count, 1, &index);
+			}
+			if (!stolen) {
+				// nothing to steal either, the work is over once all instances have stopped
+				if (atomic_load(&runner->stopped) == runner->count) break;
+				sched_yield();
+				continue;
+			}
+		}
+		pvm_runner_vm_t *const vm = &runner->vms[index];
+		uint32_t left = runner->budget;
+		#ifdef PVM_ENV
+		pvm_env_update(vm->vm.persist.env);
+		#endif
+		const pvm_errno_t error = pvm_run_budget(&vm->vm, &left);
+		vm->retired += runner->budget - left;
+		if (error) {
+			vm->error = error;
+			atomic_fetch_add(&runner->stopped, 1);
+			continue;
+		}
+		const uint32_t queued = pvm_runner_put(own, runner->count, index);
+		if (left != runner->budget) idle = 0;
+		else if (++idle >= queued) {
+			// all instances of the queue are asleep, so back off instead of polling their timers
+			const struct timespec backoff = { 0, 1000000 };
+			nanosleep(&backoff, NULL);
+			idle = 0;
+		}
+	}
+	return NULL;
+}
+
+/// \brief Initializes the runner.
+///
+/// \param[out] runner The runner to initialize.
+/// \param[in] vms The array of PVM instances.
+/// \param[in] count The number of PVM instances.
+/// \param[in] threads The number of worker threads, at least one.
+/// \param[in] budget The maximum number of instructions an instance executes in a turn.
+///
+/// \return Zero on success, otherwise an `errno` code of the failed allocation.
+int pvm_runner_init(pvm_runner_t *runner, pvm_runner_vm_t *vms, const uint32_t count, const uint32_t threads, const uint32_t budget) {
+	runner->vms = vms;
+	runner->count = count;
+	runner->threads = threads ? threads : 1;
+	runner->budget = budget ? budget : 1;
+	runner->elapsed_ns = 0;
+	atomic_init(&runner->stopped, 0);
+	atomic_init(&runner->stop, 0);
+	runner->queues = calloc(runner->threads, sizeof(pvm_runner_queue_t));
+	if (!runner->queues) return ENOMEM;
+	for (uint32_t i = 0; i < runner->threads; ++i) {
+		pthread_mutex_init(&runner->queues[i].lock, NULL);
+	}
+	for (uint32_t i = 0; i < runner->threads; ++i) {
+		pvm_runner_queue_t *const queue = &runner->queues[i];
+		queue->items = malloc((count ? count : 1) * sizeof(uint32_t));
+		if (!queue->items) {
+			pvm_runner_free(runner);
+			return ENOMEM;
+		}
+	}
+	return 0;
+}
+
+/// \brief Runs the PVM instances until all of them stop or the duration elapses.
+///
+/// \param[in,out] runner The runner.
+/// \param[in] duration_ms The maximum duration of the run in milliseconds, zero to run until all instances stop.
+///
+/// \return Zero on success, otherwise an `errno` code of the failed thread creation.
+///
+/// \details Instances stopped by an error, including PVM_MAIN_RETURN, are not run anymore. Sleeping instances are
+/// polled in turns as `pvm_run()` does, a worker finding all its instances asleep backs off for a millisecond.
+int pvm_runner_run(pvm_runner_t *runner, const uint32_t duration_ms) {
+	int result = 0;
+	uint32_t stopped = 0;
+	// shard the instances still running across the workers
+	for (uint32_t i = 0; i < runner->threads; ++i) {
+		runner->queues[i].head = 0;
+		runner->queues[i].size = 0;
+	}
+	for (uint32_t i = 0; i < runner->count; ++i) {
+		if (runner->vms[i].error) ++stopped;
+		else pvm_runner_put(&runner->queues[i % runner->threads], runner->count, i);
+	}
+	atomic_store(&runner->stopped, stopped);
+	atomic_store(&runner->stop, 0);
+
+	pthread_t *const threads = malloc(runner->threads * sizeof(pthread_t));
+	pvm_runner_worker_t *const workers = malloc(runner->threads * sizeof(pvm_runner_worker_t));
+	if (!threads || !workers) {
+		free(threads);
+		free(workers);
+		return ENOMEM;
+	}
+	const uint64_t start = pvm_runner_now_ns();
+	uint32_t started = 0;
+	for (; started < runner->threads; ++started) {
+		workers[started].runner = runner;
+		workers[started].id = started;
+		if ((result = pthread_create(&threads[started], NULL, pvm_runner_work, &workers[started]))) break;
+	}
+	if (result) atomic_store(&runner->stop, 1);
+	else if (duration_ms) {
+		const uint64_t deadline = start + (uint64_t)duration_ms * 1000000u;
+		const struct timespec tick = { 0, 1000000 };
+		while (pvm_runner_now_ns() < deadline && atomic_load(&runner->stopped) < runner->count) {
+			nanosleep(&tick, NULL);
+		}
+		atomic_store(&runner->stop, 1);
+	}
+	for (uint32_t i = 0; i < started; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	runner->elapsed_ns = pvm_runner_now_ns() - start;
+	free(threads);
+	free(workers);
+	return result;
+}
+
+/// \brief Calculates the total number of instructions executed by all PVM instances.
+///
+/// \param[in] runner The runner.
+///
+/// \return The total number of instructions.
+uint64_t pvm_runner_retired(const pvm_runner_t *runner) {
+	uint64_t retired = 0;
+	for (uint32_t i = 0; i < runner->count; ++i) {
+		retired += runner->vms[i].retired;
+	}
+	return retired;
+}
+
+/// \brief Releases the resources of the runner, the PVM instances stay intact.
+///
+/// \param[in,out] runner The runner.
+void pvm_runner_free(pvm_runner_t *runner) {
+	if (!runner->queues) return;
+	for (uint32_t i = 0; i < runner->threads; ++i) {
+		pthread_mutex_destroy(&runner->queues[i].lock);
+		free(runner->queues[i].items);
+	}
+	free(runner->queues);
+	runner->queues = NULL;
+}
@@ -0,0 +1,97 @@
+#ifndef PVM_PVM_RUNNER_H
+#define PVM_PVM_RUNNER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pvm.h"
+
+/// \brief Represents a PVM instance run by the host runner along with its statistics.
+typedef struct pvm_runner_vm {
+	/// \brief The PVM instance, it should be reset with its executable assigned before the run.
+	pvm_t vm;
+	/// \brief The number of instructions the instance has executed, cycles with `PVM_CYCLES`, see `pvm_run_budget()`.
+	uint64_t retired;
+	/// \brief The error which stopped the instance, PVM_NO_ERROR while it is running.
+	pvm_errno_t error;
+	#ifdef PVM_ENV
+	/// \brief The environment of the instance, `vm.persist.env` should point here.
+	///
+	/// \details Instances migrate between workers, so each of them gets its own environment which cached time the
+	/// worker running it refreshes before every turn.
+	pvm_env_t env;
+	#endif
+} pvm_runner_vm_t;
+
+/// \brief Represents the queue of PVM instances owned by a worker thread.
+///
+/// \details The owner takes instances from the head and returns them to the tail, idle workers steal from the tail.
+typedef struct pvm_runner_queue {
+	/// \brief The lock of the queue.
+	pthread_mutex_t lock;
+	/// \brief The ring of instance indices, it has room for all instances of the runner.
+	uint32_t *items;
+	/// \brief The position of the first index in the ring.
+	uint32_t head;
+	/// \brief The number of indices in the ring.
+	uint32_t size;
+} pvm_runner_queue_t;
+
+/// \brief Represents a pool of worker threads running many PVM instances.
+///
+/// \details The instances are sharded across the workers upfront. Every worker executes the instances of its own queue
+/// in turns for an instruction budget each, and an idle worker steals instances from the queues of the other workers.
+/// The instances may share a single executable and its prepared code, as both are only read while running.
+typedef struct pvm_runner {
+	/// \brief The array of the run PVM instances.
+	pvm_runner_vm_t *vms;
+	/// \brief The number of PVM instances.
+	uint32_t count;
+	/// \brief The number of worker threads.
+	uint32_t threads;
+	/// \brief The maximum number of instructions, or cycles with `PVM_CYCLES`, an instance executes in a turn.
+	uint32_t budget;
+	/// \brief The duration of the last run in nanoseconds.
+	uint64_t elapsed_ns;
+	/// \brief The queues of the workers.
+	pvm_runner_queue_t *queues;
+	/// \brief The number of instances stopped by an error.
+	atomic_uint_fast32_t stopped;
+	/// \brief Set to stop the workers.
+	atomic_bool stop;
+} pvm_runner_t;
+
+/// \brief Initializes the runner.
+///
+/// \param[out] runner The runner to initialize.
+/// \param[in] vms The array of PVM instances.
+/// \param[in] count The number of PVM instances.
+/// \param[in] threads The number of worker threads, at least one.
+/// \param[in] budget The maximum number of instructions an instance executes in a turn.
+///
+/// \return Zero on success, otherwise an `errno` code of the failed allocation.
+int pvm_runner_init(pvm_runner_t *runner, pvm_runner_vm_t *vms, uint32_t count, uint32_t threads, uint32_t budget);
+
+/// \brief Runs the PVM instances until all of them stop or the duration elapses.
+///
+/// \param[in,out] runner The runner.
+/// \param[in] duration_ms The maximum duration of the run in milliseconds, zero to run until all instances stop.
+///
+/// \return Zero on success, otherwise an `errno` code of the failed thread creation.
+///
+/// \details Instances stopped by an error, including PVM_MAIN_RETURN, are not run anymore. Sleeping instances are
+/// polled in turns as `pvm_run()` does, a worker finding all its instances asleep backs off for a millisecond.
+int pvm_runner_run(pvm_runner_t *runner, uint32_t duration_ms);
+
+/// \brief Calculates the total number of instructions executed by all PVM instances.
+///
+/// \param[in] runner The runner.
+///
+/// \return The total number of instructions.
+uint64_t pvm_runner_retired(const pvm_runner_t *runner);
+
+/// \brief Releases the resources of the runner, the PVM instances stay intact.
+///
+/// \param[in,out] runner The runner.
+void pvm_runner_free(pvm_runner_t *runner);
+
+#endif
@@ -1,15 +1,9 @@
 #include <stdio.h>
 #include <time.h>
-#include "pvm.h"
+#include "builtins.h"
 
-#if PVM_DATA_SIGN > 0x80000000
-int32_t expand(pvm_data_t value) {
-	if (value & PVM_DATA_SIGN) return (int32_t)value | (int32_t)PVM_DATA_SIGN;
-	return value;
-}
-#else
-#define expand(x) (int32_t)x
-#endif
+// pvm_data_t is a signed integer of the configured width, so the conversion extends its sign
+#define expand(x) ((int32_t)(x))
 
 #ifdef PVM_DEBUG
 // don't terminate strings when opcode debug is printed
@@ -62,20 +56,17 @@ void section_pvm_builtins pvm_output(pvm_t *vm, pvm_data_t arguments[], pvm_data
 	printf("OUTPUT: %d" ENDL, expand(arguments[0]));
 }
 
-void pvm_get_tick(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
-	arguments[0] = (int32_t)now_ms();
-}
-
-void pvm_get_time(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+pvm_data_t pvm_get_time(pvm_t *vm, const pvm_data_t arguments[]) {
 	struct timespec ts;
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	arguments[0] = (int32_t)ts.tv_sec;
+	return (int32_t)ts.tv_sec;
 }
 
 void pvm_get_realtime(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
     time_t t;
 	time(&t);
-	const struct tm *tm = localtime(&t);
+	struct tm tm_buf;
+	const struct tm *tm = localtime_r(&t, &tm_buf);
 
     arguments[0] = tm->tm_hour;
     arguments[1] = tm->tm_min;
@@ -85,45 +76,45 @@ void pvm_get_realtime(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_s
 void pvm_get_date(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
 	time_t t;
 	time(&t);
-	const struct tm *tm = localtime(&t);
+	struct tm tm_buf;
+	const struct tm *tm = localtime_r(&t, &tm_buf);
 
 	arguments[0] = tm->tm_year + 1900; // year
 	arguments[1] = tm->tm_mon + 1; // month
 	arguments[2] = tm->tm_mday; // date
 }
 
-void pvm_get_weekday(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+pvm_data_t pvm_get_weekday(pvm_t *vm, const pvm_data_t arguments[]) {
 	time_t t;
 	time(&t);
-	const struct tm *tm = localtime(&t);
+	struct tm tm_buf;
+	const struct tm *tm = localtime_r(&t, &tm_buf);
+
+	return tm->tm_wday; // weekday
+}
 
-	arguments[0] = tm->tm_wday; // weekday
+pvm_data_t section_pvm_builtins pvm_sh_section_state(pvm_t *vm, const pvm_data_t arguments[]) {
+	return 2;
 }
 
-void section_pvm_builtins pvm_sh_section_state(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
-	arguments[0] = 2;
+pvm_data_t section_pvm_builtins pvm_sh_get_entry_timer(pvm_t *vm, const pvm_data_t arguments[]) {
+	return 0;
 }
 
-void section_pvm_builtins pvm_sh_get_entry_timer(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
-	arguments[0] = 0;
+pvm_data_t section_pvm_builtins pvm_sh_get_exit_timer(pvm_t *vm, const pvm_data_t arguments[]) {
+	return 0;
 }
 
-void section_pvm_builtins pvm_sh_get_exit_timer(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
-	arguments[0] = 0;
+/// \brief Waits until the state of the section changes, the host completes the call with the new state.
+void section_pvm_builtins pvm_sh_wait_section_state(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+	pvm_wait(vm);
 }
 
+// the table serves the PVM built without the list and the environments
+PVM_BUILTIN_ADAPTERS(PVM_BUILTIN_LIST)
 
 const packed_struct pvm_builtins pvm_builtins[] = {
-{ pvm_builtin_print },
-{ pvm_output },
-{ pvm_get_tick },
-{ pvm_get_time },
-{ pvm_get_realtime },
-{ pvm_get_date },
-{ pvm_get_weekday },
-{ pvm_sh_get_entry_timer },
-{ pvm_sh_get_exit_timer },
-{ pvm_sh_section_state },
+PVM_BUILTIN_TABLE(PVM_BUILTIN_LIST)
 };
 
 const size_t pvm_builtins_size = sizeof(pvm_builtins) / sizeof(pvm_builtins[0]);
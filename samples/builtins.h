@@ -0,0 +1,32 @@
+#ifndef PVM_SAMPLES_BUILTINS_H
+#define PVM_SAMPLES_BUILTINS_H
+
+#include "pvm.h"
+
+// The built-in functions of the sample in the order of their indices. The PVM built with PVM_BUILTINS pointing here
+// dispatches them directly and inlines those defined below, the rest of the hosts take them from the pvm_builtins[]
+// table generated from the same list.
+#define PVM_BUILTIN_LIST(call, value) \
+	call(pvm_builtin_print) \
+	call(pvm_output) \
+	value(pvm_get_tick) \
+	value(pvm_get_time) \
+	call(pvm_get_realtime) \
+	call(pvm_get_date) \
+	value(pvm_get_weekday) \
+	value(pvm_sh_get_entry_timer) \
+	value(pvm_sh_get_exit_timer) \
+	value(pvm_sh_section_state) \
+	call(pvm_sh_wait_section_state)
+
+PVM_BUILTIN_ENUM(PVM_BUILTIN_LIST)
+
+pvm_builtin_f pvm_builtin_print, pvm_output, pvm_get_realtime, pvm_get_date, pvm_sh_wait_section_state;
+pvm_builtin_value_f pvm_get_time, pvm_get_weekday, pvm_sh_get_entry_timer, pvm_sh_get_exit_timer, pvm_sh_section_state;
+
+/// \brief Gets the tick in milliseconds, scripts polling it in their loops get it without a call.
+static inline pvm_data_t pvm_get_tick(pvm_t *vm, const pvm_data_t arguments[]) {
+	return (pvm_data_t)now_ms();
+}
+
+#endif
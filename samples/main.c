@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <malloc.h>
-#include "pvm.h"
+#include "pvm_map.h"
 
 const char *pvm_errno_strings[] = {
 "No error",
@@ -21,46 +21,74 @@ const char *pvm_errno_strings[] = {
 "Variadic size"
 };
 
-uint8_t *read_exe(const char *filename) {
-	FILE *file;
-	long file_size;
-
-	file = fopen(filename, "rb");
-	if (!file) {
-		perror("Failed to open file");
-		return NULL;
-	}
-
-	fseek(file, 0, SEEK_END);
-	file_size = ftell(file);
-	fseek(file, 0, SEEK_SET);
-
-	uint8_t *data = (uint8_t *)malloc(file_size);
-	if (!data) {
-		perror("Failed to allocate memory");
-		fclose(file);
+/// \brief Maps a PVM executable in place, code the verifier cannot prove safe still runs on the checked engine.
+///
+/// \details `verified` receives the results of the verification, it is cleared if the verifier rejects the code.
+const pvm_exe_t *load_exe(pvm_exe_map_t *map, const char *filename, pvm_verify_t **verified) {
+	const enum pvm_exe_check_result check = pvm_exe_map_file(map, filename);
+	if (check) {
+		fprintf(stderr, check == PVM_EXE_IO ? "Failed to map file\n" : "Invalid exe\n");
 		return NULL;
 	}
 
-	if (fread(data, 1, file_size, file) != file_size) {
-		perror("Failed to read file");
-		free(data);
-		fclose(file);
-		return NULL;
+	const size_t scratch_size = pvm_exe_verify_size(map->image);
+	void *scratch = malloc(scratch_size);
+	const enum pvm_exe_check_result verify = scratch ? pvm_exe_map_verify(map, scratch, scratch_size, *verified) : PVM_EXE_SCRATCH;
+	free(scratch);
+	if (verify) {
+		fprintf(stderr, "Exe not verified (%d), running checked\n", verify);
+		*verified = NULL;
+		return pvm_exe_map_trust(map);
 	}
 
-	fclose(file);
+	return map->exe;
+}
 
-	if (pvm_exe_check((const pvm_exe_t *)data, file_size)) {
-		free(data);
-		fprintf(stderr, "Invalid exe\n");
-		return NULL;
-	}
+pvm_t pvm[1];
 
-	return data;
+#ifdef PVM_ENV
+static uint32_t env_clock(pvm_env_t *env) {
+	(void)env;
+	return now_ms();
 }
 
-pvm_t pvm[1];
+pvm_env_t env = { .clock = env_clock };
+#endif
+
+#ifdef PVM_PROFILE
+pvm_profile_t profile;
+
+void print_profile(const pvm_profile_t *profile) {
+	printf("\nPROFILE: %u instructions\n", profile->instructions);
+	for (int i = 0; i < 256; ++i) {
+		if (profile->opcodes[i]) printf("OPCODE 0x%02X: %u\n", i, profile->opcodes[i]);
+	}
+	for (size_t i = 0; i < profile->pcs_size; ++i) {
+		if (profile->pcs[i]) printf("PC %zu: %u\n", i, profile->pcs[i]);
+	}
+	for (size_t i = 0; i < profile->functions_size; ++i) {
+		const pvm_profile_function_t *const fun = &profile->functions[i];
+		if (!i) printf("MAIN: %u instructions\n", fun->instructions);
+		else if (fun->calls) printf("FUNCTION %zu: %u calls, %u instructions\n", i - 1, fun->calls, fun->instructions);
+	}
+}
+#endif
+
+#ifdef PVM_TRACE
+#define TRACE_SIZE 256
+pvm_trace_record_t trace_records[TRACE_SIZE];
+pvm_trace_t trace = { .records = trace_records, .size = TRACE_SIZE };
+
+/// \brief Dumps the last instructions for the `pvm-trace` decoder.
+void dump_trace(const pvm_trace_t *trace, const char *filename) {
+	static uint8_t dump[TRACE_SIZE * PVM_TRACE_RECORD_SIZE];
+	const size_t size = pvm_trace_dump(trace, dump, sizeof(dump));
+	FILE *const file = fopen(filename, "wb");
+	if (!file || fwrite(dump, 1, size, file) != size) perror("Failed to dump trace");
+	else printf("\nTRACE: last %zu instructions dumped to %s\n", size / PVM_TRACE_RECORD_SIZE, filename);
+	if (file) fclose(file);
+}
+#endif
 
 int main(const int argc, const char *argv[]) {
 	if (argc != 2) {
@@ -69,27 +97,79 @@ int main(const int argc, const char *argv[]) {
 	}
 
 	pvm_t *vm = &pvm[0];
-	vm->persist.exe = (const pvm_exe_t *)read_exe(argv[1]);
-	if (!vm->persist.exe) return 1;
+	pvm_exe_map_t map;
+	pvm_verify_t depths = { NULL }, *verified = &depths;
+	const pvm_exe_t *const exe = load_exe(&map, argv[1], &verified);
+	if (!exe) return 1;
+	pvm_image_t image;
+	pvm_image_init(&image, exe);
+	vm->persist.image = &image;
+	#ifdef PVM_ENV
+	env.builtins = pvm_builtins;
+	env.builtins_size = pvm_builtins_size;
+	vm->persist.env = &env;
+	pvm_env_update(&env);
+	#endif
+	#ifdef PVM_PROFILE
+	profile.pcs_size = image.code_size;
+	profile.pcs = calloc(profile.pcs_size, sizeof(uint32_t));
+	profile.functions_size = image.functions_count + 1u;
+	profile.functions = calloc(profile.functions_size, sizeof(pvm_profile_function_t));
+	if (profile.pcs && profile.functions) vm->persist.profile = &profile;
+	#endif
+	#ifdef PVM_TRACE
+	vm->persist.trace = &trace;
+	#endif
+	#ifdef PVM_ARENA
+	// the stacks take what the verifier has proven the executable needs, unverified code takes the largest ones
+	const size_t arena_size = pvm_arena_size(verified);
+	void *const arena = malloc(arena_size);
+	if (!arena || pvm_init(vm, &image, verified, arena, arena_size)) {
+		fprintf(stderr, "Failed to allocate stacks\n");
+		return 1;
+	}
+	printf("STACKS: %u values, %u frames\n", vm->data_size, vm->call_size);
+	#else
 	pvm_reset(vm);
+	#endif
 
-	printf("MIN_VM_VERSION: %u\nFUNCTIONS: %u\nCONSTANTS:%u\n", vm->persist.exe->vm_version, vm->persist.exe->functions_count, vm->persist.exe->constants_count);
+	printf("MIN_VM_VERSION: %u\nFUNCTIONS: %u\nCONSTANTS:%u\n", exe->vm_version, image.functions_count, image.constants_count);
 
 	int err = 0;
-	while (!(err = pvm_op(vm))) {
+	while (!(err = pvm_run(vm, 100))) {
 		// emulate MCU speed
-		usleep(10);
+		usleep(1000);
+		// emulate the section state changing while waiting for it
+		if (vm->waiting) {
+			const pvm_data_t state = 2;
+			pvm_complete(vm, &state, 1);
+		}
+		#ifdef PVM_ENV
+		// the PVM reads the time cached once per slice
+		pvm_env_update(&env);
+		#endif
 	}
 
-	free((void *)vm->persist.exe);
+	#ifdef PVM_PROFILE
+	if (vm->persist.profile) print_profile(vm->persist.profile);
+	free(profile.pcs);
+	free(profile.functions);
+	#endif
 
 	if (PVM_MAIN_RETURN == err) {
 		printf("\nEND\n");
-		return 0;
 	}
 	else {
 		printf("\nERROR: %s PC=%u\n", pvm_errno_strings[err], vm->pc - 1);
+		#ifdef PVM_TRACE
+		dump_trace(&trace, "pvm.trace");
+		#endif
 		pvm_reset(vm);
-		return 1;
 	}
+	// the instance is reset above, so the image is released last
+	#ifdef PVM_ARENA
+	free(arena);
+	#endif
+	pvm_exe_unmap(&map);
+	return PVM_MAIN_RETURN == err ? 0 : 1;
 }
@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pvm.h"
+
+// the engine this binary is built with, see test/CMakeLists.txt
+#if defined(PVM_PREPARE)
+#define DIFF_ENGINE "prepared"
+#elif defined(PVM_DISPATCH_THREADED)
+#define DIFF_ENGINE "threaded"
+#else
+#define DIFF_ENGINE "tree"
+#endif
+
+// the budget every program runs for and the batch pvm_run() is called with, an odd one ends batches anywhere
+#define DIFF_BUDGET 2000
+#define DIFF_BATCH 7
+#define DIFF_CODE_SIZE 64
+
+// opcodes the generator picks from, DIV and SLP are left out as they trap and depend on the clock respectively
+#define PSH(n) (n)
+#define PSC(n) (0x80 | (n))
+#define BZE 0xA0
+#define BNZ 0xA1
+#define ADD 0xA8
+#define SKZ 0xB0
+#define RET 0xB5
+#define LDC 0xB6
+#define JMB 0xB7
+#define NEG 0xB8
+#define INC 0xBA
+#define POP(n) (0xBC | (n))
+#define JMP(i) (0xC0 | (i))
+#define CAL(i) (0xD0 | (i))
+#define LDV(i) (0xE0 | (i))
+#define STV(i) (0xF0 | (i))
+
+uint32_t now_ms(void) {
+	return 0;
+}
+
+/// \brief Takes a single argument and returns three values, so it reads two slots above its argument.
+static void diff_mix(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+	(void)vm;
+	for (int i = 0; i < 3; ++i) {
+		arguments[i] = (pvm_data_t)((uint32_t)arguments[i] * 31u + i + args_size);
+	}
+}
+
+/// \brief Sums its variadic arguments into its single return value, which is above them when there are none.
+static void diff_sum(pvm_t *vm, pvm_data_t arguments[], pvm_data_stack_t args_size) {
+	(void)vm;
+	uint32_t sum = (uint32_t)arguments[0] ^ 0x55u;
+	for (int i = 1; i < args_size; ++i) {
+		sum += (uint32_t)arguments[i];
+	}
+	arguments[0] = (pvm_data_t)sum;
+}
+
+const packed_struct pvm_builtins pvm_builtins[] = {
+	{ diff_mix },
+	{ diff_sum },
+};
+
+const size_t pvm_builtins_size = sizeof(pvm_builtins) / sizeof(pvm_builtins[0]);
+
+/// \brief Generates the next pseudo-random number, the programs are the same on every engine for the same seed.
+static uint32_t diff_random(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/// \brief Picks a random opcode, the operands mostly stay in range so programs run a while before they fail.
+static uint8_t diff_op(uint32_t *state) {
+	const uint32_t r = diff_random(state);
+	const uint8_t operand = r >> 8 & 0x0F;
+	switch (r % 16) {
+		case 0:
+		case 1:
+		case 2: return PSH(r >> 8 & 1 ? operand : r >> 12 & 0x7F);
+		case 3: return PSC(r >> 8 & 0x1F);
+		case 4: return BZE + (r >> 8 & 7);
+		case 5: {
+			// ADD to XOR without DIV
+			const uint8_t op = ADD + (r >> 8 & 7);
+			return op == ADD + 3 ? ADD : op;
+		}
+		case 6: return SKZ + (r >> 8 & 3);
+		case 7: return r >> 8 & 3 ? LDC : RET;
+		case 8: return r >> 8 & 1 ? JMB : NEG + (r >> 9 & 3);
+		case 9: return POP(r >> 8 & 3);
+		case 10: return JMP(operand);
+		case 11: return CAL(operand % 4 == 3 ? 15 : operand % 4);
+		case 12:
+		case 13: return LDV(operand % 5 == 4 ? 15 : operand % 5);
+		default: return STV(operand % 5 == 4 ? 15 : operand % 5);
+	}
+}
+
+/// \brief Emits one of the sequences the prepared engine fuses into a superinstruction.
+///
+/// \return The number of opcodes emitted, at most four.
+static size_t diff_sequence(uint32_t *state, uint8_t *code) {
+	const uint32_t r = diff_random(state);
+	const uint8_t a = r >> 8 & 3, b = r >> 10 & 3, c = r >> 12 & 3;
+	switch (r % 3) {
+		case 0:
+			// LDV a; LDV b; ADD or SUB; STV c
+			code[0] = LDV(a);
+			code[1] = LDV(b);
+			code[2] = ADD + (r >> 14 & 1);
+			code[3] = STV(c);
+			return 4;
+		case 1:
+			// LDV a; INC or DEC; STV a
+			code[0] = LDV(a);
+			code[1] = NEG + 2 + (r >> 14 & 1);
+			code[2] = STV(a);
+			return 3;
+		default:
+			// PSH n; LDV a; PSH offset; one of BEQ to BLE
+			code[0] = PSH(r >> 16 & 0x1F);
+			code[1] = LDV(a);
+			code[2] = PSH(r >> 21 & 7);
+			code[3] = BZE + 2 + (r >> 24 & 7) % 6;
+			return 4;
+	}
+}
+
+/// \brief Assembles a random `PVM_EXE_V1` executable: a user function, a built-in one returning more values than it
+/// takes, a variadic built-in one and a few constants.
+///
+/// \return The size of the executable.
+static size_t diff_assemble(uint32_t *state, uint8_t *buffer) {
+	const size_t code_size = 16 + diff_random(state) % (DIFF_CODE_SIZE - 16);
+	const size_t total = 6 + 3 * 5 + 4 * 4 + code_size;
+	uint8_t *p = buffer;
+	*p++ = PVM_EXE_V1;
+	*p++ = (total - 6) & 0xFF;
+	*p++ = (total - 6) >> 8;
+	*p++ = 3;
+	*p++ = 4;
+	*p++ = diff_random(state) % 4;
+	// user function 0 within the code, its frame and returns are random as well
+	const uint32_t r = diff_random(state);
+	const pvm_address_t address = r % code_size;
+	const uint8_t functions[] = {
+		address & 0xFF, address >> 8, (r >> 16 & 3) % 3, (r >> 18 & 3) % 3, (r >> 20 & 3) % 3,
+		// built-in function 0 taking one argument and returning three values
+		0, 0, 1, 0, 0x80 | 3,
+		// variadic built-in function 1 returning a single value
+		1, 0, 0, 0, 0xC0 | 1
+	};
+	memcpy(p, functions, sizeof(functions));
+	p += sizeof(functions);
+	for (int i = 0; i < 4; ++i) {
+		const uint32_t constant = diff_random(state) >> (i * 8);
+		for (int b = 0; b < 4; ++b) {
+			*p++ = (uint8_t)(constant >> (8 * b));
+		}
+	}
+	for (size_t i = 0; i < code_size;) {
+		if (code_size - i >= 4 && diff_random(state) % 8 == 0) i += diff_sequence(state, &p[i]);
+		else p[i++] = diff_op(state);
+	}
+	return total;
+}
+
+/// \brief Loads the executable into an instance reset to its initial state.
+static void diff_load(pvm_t *vm, pvm_image_t *image, const uint8_t *exe, void *arena, const size_t arena_size) {
+	memset(vm, 0, sizeof(*vm));
+	pvm_image_init(image, (const pvm_exe_t *)exe);
+	vm->persist.image = image;
+	#ifdef PVM_PREPARE
+	vm->persist.prepared = pvm_prepare(image->exe, arena, arena_size);
+	#else
+	(void)arena;
+	(void)arena_size;
+	#endif
+	pvm_reset(vm);
+}
+
+/// \brief Formats the observable state of an instance: the registers, the whole data stack including the slots above
+/// its top, which built-in functions and variables may read, and the frames of the call stack.
+///
+/// \details The state of a program still running is not formatted, as the engines spend their budgets differently.
+static void diff_state(char *buffer, size_t size, const uint32_t n, const pvm_t *vm, const pvm_errno_t errno) {
+	int length = snprintf(buffer, size, "%u ", n);
+	if (!errno) {
+		snprintf(buffer + length, size - length, "running\n");
+		return;
+	}
+	length += snprintf(buffer + length, size - length, "error %d pc %u top %u calls %u data", errno, vm->pc, vm->data_top, vm->call_top);
+	for (size_t i = 0; i < PVM_DATA_STACK_SIZE; ++i) {
+		length += snprintf(buffer + length, size - length, " %ld", (long)vm->data_stack[i]);
+	}
+	length += snprintf(buffer + length, size - length, " frames");
+	for (pvm_call_stack_t i = 0; i < vm->call_top; ++i) {
+		const struct pvm_call_stack *const call = &vm->call_stack[i];
+		length += snprintf(buffer + length, size - length, " %u:%u:%u:%u", call->return_address, call->variables_start, call->arguments_count, call->function_index);
+	}
+	snprintf(buffer + length, size - length, "\n");
+}
+
+/// \brief Checks if two instances are in the same state, see `diff_state()`.
+static int diff_same(const pvm_t *a, const pvm_t *b) {
+	if (a->pc != b->pc || a->data_top != b->data_top || a->call_top != b->call_top) return 0;
+	if (memcmp(a->data_stack, b->data_stack, sizeof(a->data_stack))) return 0;
+	return !memcmp(a->call_stack, b->call_stack, a->call_top * sizeof(a->call_stack[0]));
+}
+
+/// \brief Compares the state a program stops in with the one the reference engine has printed for it.
+///
+/// \param[in] line The line of the reference output.
+/// \param[in] state The line this engine prints.
+///
+/// \return Non-zero if the states are the same. A program still running in the reference is not compared, as the
+/// prepared engine spends a single budget unit on a whole fused instruction and gets further with the same budget.
+static int diff_expected(const char *line, const char *state) {
+	const char *const rest = strchr(line, ' ');
+	if (rest && !strcmp(rest + 1, "running\n")) return 1;
+	return !strcmp(line, state);
+}
+
+/// \brief Runs a looping program while the move to an image with more variables of main() than the data stack holds
+/// is pending, so every backward jump of main() is a swap point refusing the move.
+///
+/// \return Non-zero if the instance stays on its image and stops in the same state as one without a swap.
+static int diff_swap(const uint8_t *code, const size_t code_size) {
+	uint8_t exe[6 + 16];
+	const uint8_t big[] = { PVM_EXE_V1, 1, 0, 0, 0, 0xFF, RET };
+	static uint8_t arena[2][4096];
+	static pvm_t swapping, plain;
+	static char line[4096];
+	pvm_image_t swapping_image, plain_image, big_image;
+	exe[0] = PVM_EXE_V1;
+	exe[1] = (uint8_t)code_size;
+	exe[2] = 0;
+	exe[3] = 0;
+	exe[4] = 0;
+	exe[5] = 1;
+	memcpy(&exe[6], code, code_size);
+	diff_load(&swapping, &swapping_image, exe, arena[0], sizeof(arena[0]));
+	diff_load(&plain, &plain_image, exe, arena[1], sizeof(arena[1]));
+	pvm_image_init(&big_image, (const pvm_exe_t *)big);
+	pvm_swap_t swap = { .image = &swapping_image };
+	swapping.persist.swap = &swap;
+	pvm_swap_publish(&swap, &big_image, 0, 1, 1);
+
+	pvm_errno_t swapping_errno = PVM_NO_ERROR, plain_errno = PVM_NO_ERROR;
+	for (uint32_t left = DIFF_BUDGET; left && !swapping_errno;) {
+		uint32_t budget = left < DIFF_BATCH ? left : DIFF_BATCH;
+		const uint32_t spent = budget;
+		swapping_errno = pvm_run_budget(&swapping, &budget);
+		left -= spent - budget;
+	}
+	for (uint32_t left = DIFF_BUDGET; left && !plain_errno;) {
+		uint32_t budget = left < DIFF_BATCH ? left : DIFF_BATCH;
+		const uint32_t spent = budget;
+		plain_errno = pvm_run_budget(&plain, &budget);
+		left -= spent - budget;
+	}
+	if (swapping.persist.image == &swapping_image && swap.pending == 1 && swapping_errno == plain_errno && diff_same(&swapping, &plain)) return 1;
+	fprintf(stderr, "%s engine moves or diverges when the swap is refused\n", DIFF_ENGINE);
+	diff_state(line, sizeof(line), 0, &swapping, swapping_errno);
+	fprintf(stderr, "  swapping %s", line);
+	diff_state(line, sizeof(line), 0, &plain, plain_errno);
+	fprintf(stderr, "  plain    %s", line);
+	return 0;
+}
+
+int main(const int argc, const char *argv[]) {
+	uint32_t seed = 0x5EED1234u, count = 12000;
+	const char *output = NULL, *reference = NULL;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--count") && i + 1 < argc) count = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "--output") && i + 1 < argc) output = argv[++i];
+		else if (!strcmp(argv[i], "--reference") && i + 1 < argc) reference = argv[++i];
+		else {
+			fprintf(stderr, "Usage: %s [--seed n] [--count n] [--output file] [--reference file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!seed) seed = 1;
+
+	FILE *const out = output ? fopen(output, "w") : NULL;
+	FILE *const expected = reference ? fopen(reference, "r") : NULL;
+	if ((output && !out) || (reference && !expected)) {
+		perror("Failed to open");
+		return 1;
+	}
+
+	static uint8_t exe[6 + 3 * 5 + 4 * 4 + DIFF_CODE_SIZE];
+	static uint8_t arena[2][16384];
+	static pvm_t stepped, batched;
+	static char state[4096], line[4096];
+	pvm_image_t stepped_image, batched_image;
+	uint32_t random = seed, diverged = 0;
+
+	for (uint32_t n = 0; n < count; ++n) {
+		const size_t size = diff_assemble(&random, exe);
+		if (pvm_exe_check((const pvm_exe_t *)exe, size)) {
+			fprintf(stderr, "%u: invalid executable\n", n);
+			return 1;
+		}
+		diff_load(&stepped, &stepped_image, exe, arena[0], sizeof(arena[0]));
+		diff_load(&batched, &batched_image, exe, arena[1], sizeof(arena[1]));
+
+		// the same budget spent instruction by instruction and in batches must leave the same state behind
+		pvm_errno_t stepped_errno = PVM_NO_ERROR, batched_errno = PVM_NO_ERROR;
+		for (uint32_t i = 0; i < DIFF_BUDGET && !stepped_errno; ++i) {
+			stepped_errno = pvm_op(&stepped);
+		}
+		for (uint32_t left = DIFF_BUDGET; left && !batched_errno;) {
+			uint32_t budget = left < DIFF_BATCH ? left : DIFF_BATCH;
+			const uint32_t spent = budget;
+			batched_errno = pvm_run_budget(&batched, &budget);
+			left -= spent - budget;
+		}
+		diff_state(state, sizeof(state), n, &stepped, stepped_errno);
+		if (stepped_errno != batched_errno || !diff_same(&stepped, &batched)) {
+			fprintf(stderr, "%s engine diverges between pvm_op() and pvm_run()\n  stepped %s", DIFF_ENGINE, state);
+			diff_state(line, sizeof(line), n, &batched, batched_errno);
+			fprintf(stderr, "  batched %s", line);
+			++diverged;
+		}
+
+		// the engines must stop every program in the same state
+		if (out) fputs(state, out);
+		if (expected) {
+			if (!fgets(line, sizeof(line), expected)) {
+				fprintf(stderr, "%s: the reference ends at program %u\n", reference, n);
+				return 1;
+			}
+			if (!diff_expected(line, state)) {
+				fprintf(stderr, "%s engine diverges from the reference\n  expected %s  actual   %s", DIFF_ENGINE, line, state);
+				++diverged;
+			}
+		}
+	}
+
+	// backward jumps of main() fused with their literal offsets: JMB and BNZ with an offset of -12 built by PSC
+	const uint8_t jump_back[] = { LDV(0), INC, STV(0), PSH(4), JMB };
+	const uint8_t branch_back[] = { LDV(0), INC, STV(0), LDV(0), PSH(0x7F), PSC(31), PSC(31), PSC(31), PSC(31), PSC(0x14), BNZ };
+	if (!diff_swap(jump_back, sizeof(jump_back))) ++diverged;
+	if (!diff_swap(branch_back, sizeof(branch_back))) ++diverged;
+
+	if (out && fclose(out)) {
+		perror("Failed to write output");
+		return 1;
+	}
+	if (expected) fclose(expected);
+	printf("%s: %u programs of seed 0x%08X, %u diverged\n", DIFF_ENGINE, count, seed, diverged);
+	return diverged ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pvm_map.h"
+
+static const char *const mnemonics[] = {
+	"BZE", "BNZ", "BEQ", "BNE", "BGT", "BLT", "BGE", "BLE", "ADD", "SUB", "MUL", "DIV", "PWR", "AND", "IOR", "XOR",
+	"SKZ", "SNZ", "SKN", "SNN", "SLP", "RET", "LDC", "JMB", "NEG", "INV", "INC", "DEC", "POP", "POP", "POP", "POP"
+};
+
+static const char *const integral_mnemonics[] = { "JMP", "CAL", "LDV", "STV" };
+
+/// \brief Calculates the target of a jump or a branch the same way the engines do.
+static long target(const unsigned pc, const int32_t offset) {
+	return (long)(pvm_address_t)(pc + 1u + (uint32_t)offset + 1u);
+}
+
+/// \brief Prints a record as a listing line, the operands taken from the stack are resolved by the value on its top.
+///
+/// \param[in] image The executable the trace was recorded from.
+/// \param[in] states The states proven by the verifier telling the function of every address, NULL if not verified.
+/// \param[in] pc The address of the instruction.
+/// \param[in] op The opcode of the instruction.
+/// \param[in] top The value on the top of the data stack upon entering the instruction.
+static void print_record(const pvm_image_t *image, const pvm_verify_state_t *states, const unsigned pc, const pvm_op_t op, const int32_t top) {
+	char owner[8] = "-";
+	if (states && pc < image->code_size && (states[pc].flags & PVM_VERIFY_VISITED)) {
+		if (states[pc].owner) snprintf(owner, sizeof(owner), "f%u", states[pc].owner - 1u);
+		else snprintf(owner, sizeof(owner), "main");
+	}
+	printf("%5u  %-5s  %02X  ", pc, owner, op);
+
+	if (op < PVM_OP_PSC) printf("PSH %u", op);
+	else if (op < PVM_OP_BZE) printf("PSC %u", op & 0x1F);
+	else if (op < PVM_OP_ADD) printf("%s -> %ld", mnemonics[op - PVM_OP_BZE], target(pc, top));
+	else if (op == PVM_OP_JMB) {
+		int32_t param = (int32_t)(0u - (uint32_t)top);
+		if (param < 0) param -= 2;
+		printf("JMB -> %ld", target(pc, param));
+	}
+	else if (op == PVM_OP_LDC) {
+		printf("LDC [%ld]", (long)top);
+		if (top >= 0 && top < image->constants_count) printf(" %ld", (long)image->constants[top]);
+	}
+	else if (op < PVM_OP_JMP) printf("%s", mnemonics[op - PVM_OP_BZE]);
+	else {
+		// the operand nibble 0xF takes the operand from the stack
+		int32_t param = op & 0x0F;
+		if (param == 0x0F) {
+			param = top;
+			if (param > 0) param += 0x0F;
+		}
+		printf("%s ", integral_mnemonics[(op >> 4) - (PVM_OP_JMP >> 4)]);
+		switch (op & 0xF0) {
+			case PVM_OP_JMP:
+				printf("%ld -> %ld", (long)param, target(pc, param < 0 ? param - 2 : param));
+				break;
+			case PVM_OP_CAL:
+				printf("f%ld", (long)param);
+				if (param >= 0 && param < image->functions_count && image->functions[param].is_built_in) printf(" (built-in)");
+				break;
+			default:
+				printf("[%ld]", (long)param);
+				break;
+		}
+	}
+	printf("\t; top %ld\n", (long)top);
+}
+
+int main(const int argc, const char *argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <executable> <trace>\n", argv[0]);
+		return 1;
+	}
+
+	pvm_exe_map_t map;
+	const enum pvm_exe_check_result check = pvm_exe_map_file(&map, argv[1]);
+	if (check) {
+		fprintf(stderr, check == PVM_EXE_IO ? "Failed to map file\n" : "Invalid exe\n");
+		return 1;
+	}
+	pvm_image_t image;
+	pvm_image_init(&image, map.image);
+
+	// the functions of the addresses are told by the verifier, executables it rejects are listed without them
+	const size_t scratch_size = pvm_exe_verify_size(map.image);
+	void *const scratch = malloc(scratch_size);
+	pvm_verify_state_t *states = malloc(image.code_size * sizeof(pvm_verify_state_t) + 1);
+	if (!scratch || !states) {
+		perror("Failed to allocate");
+		return 1;
+	}
+	pvm_verify_t verify = { .states = states };
+	if (pvm_exe_verify(map.image, scratch, scratch_size, &verify) != PVM_EXE_OK) {
+		fprintf(stderr, "Exe not verified, functions are not told\n");
+		free(states);
+		states = NULL;
+	}
+	free(scratch);
+
+	FILE *const file = fopen(argv[2], "rb");
+	if (!file) {
+		perror("Failed to open trace");
+		return 1;
+	}
+	uint8_t record[PVM_TRACE_RECORD_SIZE];
+	while (fread(record, sizeof(record), 1, file) == 1) {
+		const unsigned pc = record[0] | record[1] << 8;
+		const uint32_t top = record[3] | record[4] << 8 | record[5] << 16 | (uint32_t)record[6] << 24;
+		print_record(&image, states, pc, record[2], (int32_t)top);
+	}
+	const int failed = ferror(file);
+	if (failed) perror("Failed to read trace");
+
+	fclose(file);
+	free(states);
+	pvm_exe_unmap(&map);
+	return failed ? 1 : 0;
+}